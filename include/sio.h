@@ -23,8 +23,11 @@
 #include <sio/buf.h>
 
 #include <sio/stream.h>
+#include <sio/context.h>
+#include <sio/runtime.h>
 
 #include <sio/aux/addr.h>
+#include <sio/aux/hist.h>
 
 SIO_EXPORT sio_error_t sio_initialize(long flags);
 SIO_EXPORT void sio_cleanup();
@@ -0,0 +1,98 @@
+/**
+* @file sio/aux/hist.h
+* @brief Simple I/O (SIO) - Log-linear latency histograms
+*
+* A fixed size HDR-style histogram: values are grouped by power of two and
+* every power of two is split into SIO_HIST_SUB_COUNT linear sub-buckets, so a
+* recorded value is off by at most 1/SIO_HIST_SUB_COUNT (about 3%) at any
+* magnitude. Recording is an index computation and an increment, the histogram
+* never allocates, and two histograms merge by adding their buckets, which is
+* how the histograms of several contexts or threads are combined.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#ifndef SIO_AUX_HIST_H
+#define SIO_AUX_HIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sio/platform.h>
+#include <stdint.h>
+
+#define SIO_HIST_SUB_BITS 5                             /**< log2 of the sub-buckets per power of two */
+#define SIO_HIST_SUB_COUNT (1u << SIO_HIST_SUB_BITS)    /**< Sub-buckets per power of two */
+#define SIO_HIST_MAX_BITS 36                            /**< Values from 2^36 (about 68 seconds in ns) share the last bucket */
+#define SIO_HIST_BUCKETS ((SIO_HIST_MAX_BITS - SIO_HIST_SUB_BITS + 1) * SIO_HIST_SUB_COUNT) /**< Number of buckets */
+
+/**
+* @brief Histogram of non-negative integer values (typically nanoseconds)
+*/
+typedef struct sio_hist {
+  uint64_t count;                       /**< Number of recorded values */
+  uint64_t sum;                         /**< Sum of the recorded values */
+  uint64_t min;                         /**< Smallest recorded value (UINT64_MAX if empty) */
+  uint64_t max;                         /**< Largest recorded value, exact even past the last bucket */
+  uint64_t buckets[SIO_HIST_BUCKETS];   /**< Value counts per bucket */
+} sio_hist_t;
+
+/**
+* @brief Initialize or reset a histogram to empty
+*
+* @param hist Histogram to initialize
+*/
+SIO_EXPORT void sio_hist_init(sio_hist_t *hist);
+
+/**
+* @brief Record a value
+*
+* @param hist Histogram to record into
+* @param value Value to record
+*/
+SIO_EXPORT void sio_hist_record(sio_hist_t *hist, uint64_t value);
+
+/**
+* @brief Add the values of one histogram to another
+*
+* @param dst Histogram that receives the values
+* @param src Histogram to add
+*/
+SIO_EXPORT void sio_hist_merge(sio_hist_t *dst, const sio_hist_t *src);
+
+/**
+* @brief Get the value at a percentile
+*
+* Returns the highest value that falls into the same bucket as the value at the
+* given percentile, capped at the recorded maximum, so the result never
+* understates the latency.
+*
+* @param hist Histogram to query
+* @param percentile Percentile between 0 and 100 (e.g. 99.9)
+* @return uint64_t Value at the percentile (0 if the histogram is empty)
+*/
+SIO_EXPORT uint64_t sio_hist_percentile(const sio_hist_t *hist, double percentile);
+
+/**
+* @brief Get the bucket a value is counted in
+*
+* @param value Value
+* @return uint32_t Bucket index, below SIO_HIST_BUCKETS
+*/
+SIO_EXPORT uint32_t sio_hist_bucket(uint64_t value);
+
+/**
+* @brief Get the highest value counted in a bucket
+*
+* @param bucket Bucket index
+* @return uint64_t Highest value of the bucket (UINT64_MAX for the last one)
+*/
+SIO_EXPORT uint64_t sio_hist_bucket_max(uint32_t bucket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIO_AUX_HIST_H */
@@ -23,6 +23,8 @@ extern "C" {
 #include <sio/platform.h>
 #include <sio/err.h>
 #include <sio/stream.h>
+#include <sio/aux/hist.h>
+#include <sio/aux/fs.h>
 
 /**
 * @brief I/O Context backend types
@@ -42,7 +44,7 @@ typedef enum sio_context_backend {
   
   /* Fallback backends */
   SIO_CONTEXT_POLL,          /**< POSIX poll() */
-  SIO_CONTEXT_SELECT         /**< POSIX select() */
+  SIO_CONTEXT_SELECT         /**< POSIX select() (descriptors below FD_SETSIZE only) */
 } sio_context_backend_t;
 
 /**
@@ -51,11 +53,39 @@ typedef enum sio_context_backend {
 typedef enum sio_context_flags {
   SIO_CTX_NONE       = 0,          /**< No flags */
   SIO_CTX_NONBLOCK   = (1 << 0),   /**< Non-blocking operations */
-  SIO_CTX_THREAD_SAFE = (1 << 1)   /**< Thread-safe context */
+  SIO_CTX_THREAD_SAFE = (1 << 1),  /**< Other threads may call sio_context_post and sio_context_wakeup */
+  SIO_CTX_LATENCY    = (1 << 2),   /**< Record submit to completion latency per operation type (sio_context_get_latency) */
+  SIO_CTX_TRACE      = (1 << 3)    /**< Record operation events in a trace ring (sio_context_trace_dump) */
 } sio_context_flags_t;
 
 /**
 * @brief I/O operation types
+*
+* The meaning of sio_op_t.buffer and sio_op_t.size depends on the type:
+* - SIO_OP_READ / SIO_OP_WRITE: data buffer and its length
+* - SIO_OP_READ_AT / SIO_OP_WRITE_AT: as SIO_OP_READ / SIO_OP_WRITE, at the file
+*   offset in sio_op_t.offset instead of the file position, which is left as is
+* - SIO_OP_READV_AT / SIO_OP_WRITEV_AT: an array of sio_iovec_t and its number
+*   of entries (at most SIO_OP_IOV_MAX), at sio_op_t.offset
+* - SIO_OP_FSYNC / SIO_OP_FDATASYNC: unused
+* - SIO_OP_SYNC_RANGE: size is the length of the range at sio_op_t.offset to
+*   write out and wait for (0 = to the end of the file)
+* - SIO_OP_OPEN: a sio_open_request_t, whose stream receives the opened file
+* - SIO_OP_STAT: a sio_stat_request_t, whose info receives the file information
+* - SIO_OP_UNLINK: the path of the file to remove
+* - SIO_OP_RENAME: a sio_rename_request_t
+* - SIO_OP_ACCEPT: a sio_accept_result_t receiving the client stream and address
+* - SIO_OP_ACCEPT_MULTISHOT: as SIO_OP_ACCEPT, refilled for every accepted client.
+*   A size of offsetof(sio_accept_result_t, addr) receives only the stream; the
+*   io_uring backend fills the address with one getpeername call per client
+* - SIO_OP_CONNECT: a sio_addr_t to connect to, or NULL to wait for a connect
+*   already started by sio_stream_open_socket on a non-blocking socket
+* - SIO_OP_CLOSE / SIO_OP_CUSTOM: unused
+* - SIO_OP_RECV_MULTISHOT: unused on submit; each completion points buffer at the
+*   provided buffer the data landed in (see sio_context_register_buffer_ring)
+* - SIO_OP_TIMER: no stream or buffer; size is the expiry in milliseconds from
+*   submission, and with SIO_OP_FLAG_REPEAT the period. result is the number of
+*   expirations the completion stands for
 */
 typedef enum sio_op_type {
   SIO_OP_READ,               /**< Read operation */
@@ -63,9 +93,62 @@ typedef enum sio_op_type {
   SIO_OP_ACCEPT,             /**< Accept connection operation */
   SIO_OP_CONNECT,            /**< Connect operation */
   SIO_OP_CLOSE,              /**< Close operation */
-  SIO_OP_CUSTOM              /**< Custom user-defined operation */
+  SIO_OP_CUSTOM,             /**< Custom user-defined operation (completes on the next wait) */
+  SIO_OP_RECV_MULTISHOT,     /**< Repeating receive into provided buffers until error, EOF or cancel */
+  SIO_OP_ACCEPT_MULTISHOT,   /**< Repeating accept, one completion per client until error or cancel */
+  SIO_OP_TIMER,              /**< One-shot or periodic timer without a descriptor */
+  SIO_OP_READ_AT,            /**< Read at a file offset */
+  SIO_OP_WRITE_AT,           /**< Write at a file offset */
+  SIO_OP_READV_AT,           /**< Vectored read at a file offset */
+  SIO_OP_WRITEV_AT,          /**< Vectored write at a file offset */
+  SIO_OP_FSYNC,              /**< Flush file data and metadata to storage */
+  SIO_OP_FDATASYNC,          /**< Flush file data and the metadata needed to read it back */
+  SIO_OP_SYNC_RANGE,         /**< Write out a byte range of a file, without metadata (sync_file_range) */
+  SIO_OP_OPEN,               /**< Open a file into a stream (openat) */
+  SIO_OP_STAT,               /**< Get information about a file (statx) */
+  SIO_OP_UNLINK,             /**< Remove a file (unlinkat) */
+  SIO_OP_RENAME              /**< Rename a file (renameat) */
 } sio_op_type_t;
 
+/**
+* @brief Number of operation types, the size of the per-type statistics
+*/
+#define SIO_OP_TYPE_COUNT (SIO_OP_RENAME + 1)
+
+/**
+* @brief Maximum number of sio_iovec_t entries of a vectored operation
+*/
+#define SIO_OP_IOV_MAX 1024
+
+/**
+* @brief Smallest SIO_OP_FLAG_ZEROCOPY write that is sent without copying
+*
+* Pinning the pages and waiting for their release costs more than copying a
+* few pages, so shorter writes are copied as usual.
+*/
+#define SIO_OP_ZEROCOPY_MIN (16 * 1024)
+
+/**
+* @brief Operation flags
+*/
+typedef enum sio_op_flags {
+  SIO_OP_FLAG_LINK = (1 << 0),     /**< Set by the user: the next operation of the batch runs only if this one succeeds */
+  SIO_OP_FLAG_REPEAT = (1 << 1),   /**< Set by the user: SIO_OP_TIMER fires every size milliseconds until cancelled */
+  SIO_OP_FLAG_ZEROCOPY = (1 << 2), /**< Set by the user: SIO_OP_WRITE to a socket sends from the buffer without copying it */
+  SIO_OP_FLAG_MORE = (1 << 30)     /**< Set by the context: completion of a multishot or zero-copy operation that stays pending */
+} sio_op_flags_t;
+
+/**
+* @brief Operation priority classes for sio_op_t.priority
+*
+* Larger values map to SIO_OP_PRIORITY_HIGH and smaller ones to SIO_OP_PRIORITY_LOW.
+*/
+typedef enum sio_op_priority {
+  SIO_OP_PRIORITY_LOW = -1,        /**< Bulk traffic, dispatched after the other classes */
+  SIO_OP_PRIORITY_NORMAL = 0,      /**< Default class */
+  SIO_OP_PRIORITY_HIGH = 1         /**< Latency sensitive traffic (control plane, health checks) */
+} sio_op_priority_t;
+
 /**
 * @brief I/O operation status
 */
@@ -87,16 +170,53 @@ typedef struct sio_op {
   sio_stream_t *stream;      /**< Stream associated with operation */
   void *buffer;              /**< Buffer for data transfer */
   size_t size;               /**< Buffer size */
+  uint64_t offset;           /**< File offset of positional operations (SIO_OP_READ_AT and friends) */
   size_t result;             /**< Bytes transferred or operation-specific result */
   void *user_data;           /**< User-defined data associated with operation */
-  uint64_t timeout_ms;       /**< Timeout in milliseconds (0 = no timeout) */
-  int priority;              /**< Operation priority (implementation-defined) */
+  uint64_t timeout_ms;       /**< Deadline in milliseconds from submission (0 = no deadline) */
+  int priority;              /**< Priority class (sio_op_priority_t), SIO_OP_PRIORITY_NORMAL by default */
   uint32_t flags;            /**< Operation-specific flags */
+  int32_t buffer_id;         /**< Provided buffer that holds the result (-1 if none) */
   
   /* Internal fields - do not modify directly */
   void *internal;            /**< Internal implementation data */
+  struct sio_op *post_next;  /**< Link in the queue of a context the operation was posted to (owned by the library) */
 } sio_op_t;
 
+/**
+* @brief Result storage for SIO_OP_ACCEPT operations
+*/
+typedef struct sio_accept_result {
+  sio_stream_t stream;       /**< Accepted client stream (non-blocking, close-on-exec) */
+  sio_addr_t addr;           /**< Client address */
+} sio_accept_result_t;
+
+/**
+* @brief Request of SIO_OP_OPEN operations
+*/
+typedef struct sio_open_request {
+  const char *path;          /**< Path of the file, relative paths start at the working directory */
+  sio_stream_flags_t opt;    /**< Combination of SIO_STREAM_* flags, as for sio_stream_open_file */
+  int mode;                  /**< Permissions of a created file (0 = 0666), less the umask */
+  sio_stream_t stream;       /**< Receives the opened file stream (close-on-exec) */
+} sio_open_request_t;
+
+/**
+* @brief Request of SIO_OP_STAT operations
+*/
+typedef struct sio_stat_request {
+  const char *path;          /**< Path of the file, symbolic links are followed */
+  sio_file_info_t info;      /**< Receives the file information */
+} sio_stat_request_t;
+
+/**
+* @brief Request of SIO_OP_RENAME operations
+*/
+typedef struct sio_rename_request {
+  const char *old_path;      /**< Current path */
+  const char *new_path;      /**< New path, replaced if it exists */
+} sio_rename_request_t;
+
 /**
 * @brief I/O context structure (opaque)
 */
@@ -127,9 +247,13 @@ typedef struct sio_context_config {
   sio_context_backend_t backend;  /**< Backend to use */
   uint32_t flags;                 /**< Context flags */
   uint32_t max_events;            /**< Maximum number of events (hint) */
-  uint32_t queue_depth;           /**< Queue depth for operations (hint) */
+  uint32_t queue_depth;           /**< Queue depth for operations, also the number of operation states allocated up front */
+  uint32_t spin_us;               /**< Busy-poll budget of a wait before it sleeps, in microseconds (0 = never spin) */
+  uint32_t trace_events;          /**< Trace ring size with SIO_CTX_TRACE, rounded up to a power of two (0 = 4096) */
   sio_completion_fn completion_fn; /**< Completion callback function */
   void *user_data;                /**< User data for completion callback */
+  const void *backend_config;     /**< Backend-specific configuration (e.g. sio_io_uring_config_t, can be NULL) */
+  size_t backend_config_size;     /**< Size of backend_config */
 } sio_context_config_t;
 
 /**
@@ -142,6 +266,10 @@ SIO_EXPORT void sio_context_config_init(sio_context_config_t *config);
 /**
 * @brief Create a new I/O context
 * 
+* SIO_CONTEXT_AUTO tries io_uring, epoll and poll() in that order and uses the
+* first one that can be created, so a kernel or seccomp profile without
+* io_uring degrades to the next backend.
+* 
 * @param context Pointer to receive the new context
 * @param config Configuration options (NULL for defaults)
 * @return sio_error_t SIO_SUCCESS or error code
@@ -167,6 +295,13 @@ SIO_EXPORT sio_context_backend_t sio_context_get_backend(const sio_context_t *co
 /**
 * @brief Register a stream with a context
 * 
+* Readiness based backends (epoll) switch the underlying descriptor to non-blocking
+* mode and add it to the kernel interest set once; streams that are submitted to
+* without being registered are registered implicitly. On io_uring the descriptor
+* is placed in the ring's fixed file table, which saves a file reference
+* acquire/release on every operation. Streams must be unregistered
+* (or closed with SIO_OP_CLOSE) before they are closed directly.
+* 
 * @param context Context to register with
 * @param stream Stream to register
 * @param user_data User data to associate with this stream
@@ -183,6 +318,65 @@ SIO_EXPORT sio_error_t sio_context_register(sio_context_t *context, sio_stream_t
 */
 SIO_EXPORT sio_error_t sio_context_unregister(sio_context_t *context, sio_stream_t *stream);
 
+/**
+* @brief Register the buffers of a pool with a context
+* 
+* On io_uring the buffers are registered with the kernel once (pinned), and
+* SIO_OP_READ / SIO_OP_WRITE operations whose buffer lies entirely within a pool
+* buffer automatically use the fixed-buffer variants. Other backends accept the
+* registration without effect. Only one pool can be registered at a time, and
+* it must not be resized or destroyed while registered.
+* 
+* @param context Context to register with
+* @param pool Buffer pool to register
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_context_register_buffers(sio_context_t *context, sio_buffer_pool_t *pool);
+
+/**
+* @brief Unregister the buffer pool registered with a context
+* 
+* @param context Context to unregister from
+* @return sio_error_t SIO_SUCCESS, SIO_ERROR_NOTFOUND if no pool is registered,
+*         or SIO_ERROR_BUSY while operations are pending
+*/
+SIO_EXPORT sio_error_t sio_context_unregister_buffers(sio_context_t *context);
+
+/**
+* @brief Register a provided buffer ring fed from a buffer pool
+* 
+* Every free buffer of the pool is handed to the context, which lends them to
+* SIO_OP_RECV_MULTISHOT operations as data arrives (an io_uring provided buffer
+* ring, emulated on other backends). Memory then scales with active traffic
+* rather than with the number of pending receives. A completion carries the
+* buffer in op->buffer / op->buffer_id; pass the id to sio_context_release_buffer
+* once the data has been consumed. On unregister the buffers still held by the
+* context go back to the pool. Only one ring can be registered per context.
+* 
+* @param context Context to register with
+* @param pool Buffer pool feeding the ring (at most 32768 buffers)
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_context_register_buffer_ring(sio_context_t *context, sio_buffer_pool_t *pool);
+
+/**
+* @brief Unregister the provided buffer ring of a context
+* 
+* @param context Context to unregister from
+* @return sio_error_t SIO_SUCCESS, SIO_ERROR_NOTFOUND if no ring is registered,
+*         or SIO_ERROR_BUSY while operations are pending
+*/
+SIO_EXPORT sio_error_t sio_context_unregister_buffer_ring(sio_context_t *context);
+
+/**
+* @brief Hand a provided buffer back to the ring after its data was consumed
+* 
+* @param context Context owning the ring
+* @param buffer_id Buffer id from a completed operation (op->buffer_id)
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_context_release_buffer(sio_context_t *context, int32_t buffer_id);
+
 /**
 * @brief Initialize an operation structure for submission
 * 
@@ -199,6 +393,36 @@ SIO_EXPORT sio_error_t sio_op_init(sio_op_t *op, sio_op_type_t type, sio_stream_
 /**
 * @brief Submit an operation to a context
 * 
+* Positional operations (SIO_OP_READ_AT and friends) do not use or move the file
+* position, so any number of them can be in flight on one descriptor. io_uring
+* runs them concurrently in the kernel; the other backends issue pread, pwrite,
+* preadv or pwritev once the descriptor is ready, which for a regular file is
+* right away.
+* 
+* Sync operations complete once the data is durable. Linked behind a write
+* (sio_context_submit_batch) they only run if the write went through in full,
+* which is how a group commit is driven from the loop. Where sync_file_range
+* does not exist, SIO_OP_SYNC_RANGE syncs the whole file's data instead.
+* 
+* File system operations (SIO_OP_OPEN, SIO_OP_STAT, SIO_OP_UNLINK, SIO_OP_RENAME)
+* take no stream; their paths and requests must stay valid until completion.
+* io_uring runs them and the sync operations in the kernel. Other backends hand
+* both to a few helper threads, started with the first such operation, so a
+* cold open or a slow flush never stalls the loop. Operations handed to a helper
+* thread cannot be cancelled and complete with their result.
+* 
+* A socket write with SIO_OP_FLAG_ZEROCOPY of at least SIO_OP_ZEROCOPY_MIN bytes
+* lets the kernel send from the buffer itself (IORING_OP_SEND_ZC on io_uring,
+* MSG_ZEROCOPY on epoll and poll()). Such a write completes twice: first with
+* SIO_OP_FLAG_MORE set once the data is queued, result being the bytes sent,
+* then finally, with the same result, once the kernel let go of the buffer. The
+* buffer must not change before the final completion. Shorter writes, streams
+* that are not registered, sockets that do not support it (such as Unix domain
+* sockets) and the select() backend copy the data and complete once, so the
+* final completion is always the one that hands the buffer back. Unregistering
+* the stream ends the wait for the release early. Zero-copy writes cannot be
+* linked.
+* 
 * @param context Context to submit to
 * @param op Operation to submit
 * @return sio_error_t SIO_SUCCESS or error code
@@ -208,6 +432,20 @@ SIO_EXPORT sio_error_t sio_context_submit(sio_context_t *context, sio_op_t *op);
 /**
 * @brief Submit multiple operations to a context
 * 
+* All operations are queued first and handed to the kernel in a single pass
+* (one io_uring_enter on io_uring; on epoll one epoll_ctl per newly seen stream
+* followed by an immediate non-blocking attempt). If an operation fails to
+* validate, the ones before it remain submitted.
+* 
+* An operation with SIO_OP_FLAG_LINK is chained to the one after it in the
+* array: the successor is only started once the operation succeeded, and is
+* cancelled (SIO_OP_CANCELLED) otherwise, together with the rest of the chain.
+* Success means SIO_OP_COMPLETE and, for reads and writes, a full transfer; a
+* linked write is issued with the size given at submission. io_uring runs the
+* chain in the kernel (IOSQE_IO_LINK, linked socket transfers use MSG_WAITALL),
+* other backends start each successor from the completion of its predecessor.
+* Close, custom, multishot, timer and zero-copy operations cannot be linked.
+* 
 * @param context Context to submit to
 * @param ops Array of operations to submit
 * @param count Number of operations in array
@@ -215,9 +453,58 @@ SIO_EXPORT sio_error_t sio_context_submit(sio_context_t *context, sio_op_t *op);
 */
 SIO_EXPORT sio_error_t sio_context_submit_batch(sio_context_t *context, sio_op_t **ops, size_t count);
 
+/**
+* @brief Submit multiple operations and wait for completions in one step
+* 
+* Submission is folded into the wait, so on io_uring the batch is submitted and
+* waited for with a single io_uring_enter.
+* 
+* @param context Context to submit to
+* @param ops Array of operations to submit
+* @param count Number of operations in array
+* @param timeout_ms Timeout in milliseconds (SIO_WAIT_FOREVER for no timeout)
+* @param max_events Maximum number of events to process
+* @return sio_wait_result_t Wait result (SIO_WAIT_ERROR if an operation was rejected)
+*/
+SIO_EXPORT sio_wait_result_t sio_context_submit_and_wait(sio_context_t *context, sio_op_t **ops, size_t count, uint64_t timeout_ms, uint32_t max_events);
+
 /**
 * @brief Wait for operations to complete on a context
 * 
+* With spin_us set in the configuration the wait busy-polls for completions
+* before it sleeps. The budget adapts: it halves after every spin that found
+* nothing and grows back to spin_us once spinning pays off again.
+* 
+* Completions are dispatched by priority class, highest first. A class that was
+* passed over 8 times in a row while it had completions waiting goes next, so
+* bulk traffic is delayed but never starved. When the backend cannot take more
+* submissions (a full io_uring SQ) operations are held back by the context and
+* handed over highest class first as room frees up.
+* 
+* Operations submitted with timeout_ms set are cancelled once their deadline
+* passes and complete with SIO_OP_TIMEOUT (SIO_ERROR_TIMEOUT), unless their
+* result arrived first. Deadlines are kept in a timer wheel with millisecond
+* resolution, checked while waiting: the wait sleeps no longer than the nearest
+* deadline, and an expired operation is reported by the wait that notices it
+* (on io_uring by the one that reaps the cancelled operation).
+* 
+* SIO_OP_TIMER operations take no descriptor: io_uring arms an IORING_OP_TIMEOUT
+* against CLOCK_MONOTONIC, the other backends keep them in the same timer wheel
+* as the deadlines, so an expiry costs neither a descriptor nor a system call of
+* its own. A periodic timer (SIO_OP_FLAG_REPEAT) completes like a multishot
+* operation, once per period with SIO_OP_FLAG_MORE set, and is re-armed on an
+* absolute schedule that does not drift; periods missed while the loop was busy
+* are folded into one completion whose result counts them. It ends when it is
+* cancelled. Timers cannot have a deadline of their own (timeout_ms).
+* 
+* Completions of multishot operations are delivered with SIO_OP_FLAG_MORE set in
+* op->flags while the operation stays pending; the final completion clears it.
+* Such completions run the callback during the wait, and op->buffer / op->buffer_id
+* are only valid inside that callback. For SIO_OP_ACCEPT_MULTISHOT the callback
+* takes ownership of the accepted stream in the sio_accept_result_t; the io_uring
+* backend needs Linux 5.19 for it and fails the operation with SIO_ERROR_PARAM on
+* older kernels.
+* 
 * @param context Context to wait on
 * @param timeout_ms Timeout in milliseconds (SIO_WAIT_FOREVER for no timeout)
 * @param max_events Maximum number of events to process
@@ -225,18 +512,98 @@ SIO_EXPORT sio_error_t sio_context_submit_batch(sio_context_t *context, sio_op_t
 */
 SIO_EXPORT sio_wait_result_t sio_context_wait(sio_context_t *context, uint64_t timeout_ms, uint32_t max_events);
 
+/**
+* @brief Wait for operations to complete and collect them into an array
+* 
+* Behaves like sio_context_wait, including priority order and deadlines, but
+* completed operations are stored in ops instead of being passed to the
+* completion callback. Completions of multishot operations that stay pending are
+* still delivered through the callback.
+* 
+* @param context Context to wait on
+* @param ops Array receiving completed operations
+* @param count Size of the array
+* @param reaped Receives the number of operations stored in ops
+* @param timeout_ms Timeout in milliseconds (SIO_WAIT_FOREVER for no timeout)
+* @return sio_wait_result_t Wait result
+*/
+SIO_EXPORT sio_wait_result_t sio_context_reap(sio_context_t *context, sio_op_t **ops, uint32_t count, uint32_t *reaped, uint64_t timeout_ms);
+
+/**
+* @brief Collect operations that have already completed, without waiting
+* 
+* Never blocks: only completions the context has already seen are returned,
+* plus on io_uring the entries sitting in the mapped CQ ring. Handling those
+* entries can still make system calls: getsockopt for a connect that waited
+* for writability, getpeername for the client address of a multishot accept,
+* and io_uring_enter when a periodic timer is re-armed into a full submission
+* queue. Other re-armed requests, such as the wakeup read, are only queued.
+* Submissions are not flushed and deadlines are not checked, call
+* sio_context_reap or sio_context_wait for that.
+* 
+* @param context Context to poll
+* @param ops Array receiving completed operations
+* @param count Size of the array
+* @return uint32_t Number of operations stored in ops
+*/
+SIO_EXPORT uint32_t sio_context_peek(sio_context_t *context, sio_op_t **ops, uint32_t count);
+
+/**
+* @brief Hand an operation to the thread that owns a context
+* 
+* May be called from any thread for contexts created with SIO_CTX_THREAD_SAFE.
+* The operation is pushed on a lock-free queue and dispatched as a completion by
+* the owner's next wait (or reap / peek), in priority order like any other. A
+* status of SIO_OP_PENDING becomes SIO_OP_COMPLETE, error and result are passed
+* through as set by the caller, so a SIO_OP_CUSTOM operation can carry work or a
+* finished result. Only the first post into an empty queue wakes the owner, so a
+* burst of posts costs one wakeup. The operation must not be in flight and must
+* not be touched until it is dispatched.
+* 
+* @param context Context to post to
+* @param op Operation to deliver
+* @return sio_error_t SIO_SUCCESS or error code (SIO_ERROR_UNSUPPORTED if the
+*         context is not thread safe, SIO_ERROR_BUSY if the operation is in flight)
+*/
+SIO_EXPORT sio_error_t sio_context_post(sio_context_t *context, sio_op_t *op);
+
+/**
+* @brief Make a blocked or the next wait of a context return
+* 
+* May be called from any thread for contexts created with SIO_CTX_THREAD_SAFE.
+* A wait that is woken without completions returns SIO_WAIT_INTERRUPTED. The
+* wakeup is an eventfd write on Linux (a pipe elsewhere) that io_uring keeps a
+* read pending on and the readiness backends poll.
+* 
+* @param context Context to wake
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_context_wakeup(sio_context_t *context);
+
 /**
 * @brief Cancel a pending operation
 * 
+* The readiness backends run file system and sync operations on helper threads;
+* one that a helper thread has already started cannot be cancelled and
+* completes with its own result.
+* 
 * @param context Context that the operation was submitted to
 * @param op Operation to cancel
-* @return sio_error_t SIO_SUCCESS or error code
+* @return sio_error_t SIO_SUCCESS or error code (SIO_ERROR_BUSY if a helper
+*         thread is already running the operation)
 */
 SIO_EXPORT sio_error_t sio_context_cancel(sio_context_t *context, sio_op_t *op);
 
 /**
 * @brief Cancel all pending operations on a stream
 * 
+* Every registered stream (explicitly or by its first operation) keeps a list of
+* its outstanding operations, so the cost depends on the stream's operations
+* only. io_uring cancels everything the kernel holds for the descriptor with a
+* single IORING_ASYNC_CANCEL_FD request on Linux 6.0 and later. Operations on a
+* stream that was never registered are found by walking all pending operations.
+* Operations a helper thread is already running are left to complete.
+* 
 * @param context Context that contains the operations
 * @param stream Stream whose operations should be cancelled
 * @return sio_error_t SIO_SUCCESS or error code
@@ -251,9 +618,141 @@ SIO_EXPORT sio_error_t sio_context_cancel_stream(sio_context_t *context, sio_str
 */
 SIO_EXPORT int sio_context_has_pending(const sio_context_t *context);
 
+/**
+* @brief Context statistics
+*/
+typedef struct sio_context_stats {
+  uint64_t submitted[SIO_OP_TYPE_COUNT]; /**< Operations accepted by submit or post, per sio_op_type_t */
+  uint64_t completed[SIO_OP_TYPE_COUNT]; /**< Completions delivered, per sio_op_type_t (multishot: every one) */
+  uint64_t syscalls;         /**< Kernel entries: waits and submissions, plus every I/O attempt on readiness backends */
+  uint64_t batches;          /**< Waits, reaps and peeks that dispatched at least one completion */
+  uint64_t batch_completions; /**< Completions those dispatched, divided by batches gives the average batch */
+  uint64_t batch_max;        /**< Largest number of completions one of them dispatched */
+  uint64_t wait_ns;          /**< Time blocked in the backend waiting for events */
+  uint64_t callback_ns;      /**< Time spent in the completion callback */
+  uint64_t sq_full;          /**< Submissions that found the io_uring SQ full */
+  uint64_t cq_overflows;     /**< Waits that found completions backed up in the kernel (io_uring CQ overflow) */
+  uint64_t state_hits;       /**< Operation states served from the context's cache */
+  uint64_t state_misses;     /**< Operation states that made the cache grow by another queue_depth states */
+  size_t state_capacity;     /**< Operation states the cache holds */
+} sio_context_stats_t;
+
+/**
+* @brief Get the statistics of a context
+* 
+* The counters are plain per-context integers updated by the thread that owns
+* the context, so they cost an increment each; the two timings take a clock
+* read around blocking waits and around each batch of callbacks. Read them from
+* the owning thread. Counters are cumulative since the context was created.
+* 
+* Every submitted operation needs an internal state. They come from a cache
+* sized by sio_context_config_t.queue_depth that grows when more operations are
+* in flight at once; misses that keep rising mean queue_depth is too small.
+* 
+* @param context Context to query
+* @param stats Receives the statistics
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_context_get_stats(const sio_context_t *context, sio_context_stats_t *stats);
+
+/**
+* @brief Get the latency histogram of an operation type
+* 
+* With SIO_CTX_LATENCY every operation is stamped when it is submitted (or
+* taken off the post queue) and recorded in nanoseconds when its completion is
+* dispatched, so the latency includes the time spent waiting for the wait that
+* reaps it. One clock read covers a whole batch of completions. The clock is the
+* invariant TSC on x86-64, calibrated against CLOCK_MONOTONIC once per process
+* (about a millisecond, when the first such context is created), and
+* CLOCK_MONOTONIC elsewhere. Completions delivered in place by multishot
+* operations are not recorded, their final completion is.
+* 
+* The histograms are allocated when the context is created and never grow.
+* Read them from the owning thread; snapshots of several contexts, such as the
+* shards of a runtime, combine with sio_hist_merge.
+* 
+* @param context Context to query
+* @param type Operation type
+* @param hist Receives a copy of the histogram
+* @return sio_error_t SIO_SUCCESS, SIO_ERROR_UNSUPPORTED without SIO_CTX_LATENCY or error code
+*/
+SIO_EXPORT sio_error_t sio_context_get_latency(const sio_context_t *context, sio_op_type_t type, sio_hist_t *hist);
+
+/**
+* @brief Kinds of trace events
+*/
+typedef enum sio_trace_kind {
+  SIO_TRACE_SUBMIT = 1,      /**< Operation accepted by submit or post, result is op->size */
+  SIO_TRACE_ENTER,           /**< Backend about to enter the kernel to wait or submit, result is the number of submissions handed over */
+  SIO_TRACE_COMPLETE,        /**< Operation finished (or a multishot delivered one), result is op->result or the sio_error_t */
+  SIO_TRACE_CANCEL,          /**< Cancellation requested, the completion follows */
+  SIO_TRACE_TIMEOUT          /**< Deadline passed, the operation is being cancelled */
+} sio_trace_kind_t;
+
+/**
+* @brief A trace event, 32 bytes
+*/
+typedef struct sio_trace_event {
+  uint64_t time;             /**< Nanoseconds of the latency clock (see sio_context_get_latency) */
+  uint64_t op;               /**< Address of the sio_op_t (0 for SIO_TRACE_ENTER) */
+  int64_t result;            /**< Depends on the kind, see sio_trace_kind_t */
+  int32_t fd;                /**< Descriptor of the operation, or of the backend for SIO_TRACE_ENTER (-1 if none) */
+  uint8_t kind;              /**< sio_trace_kind_t */
+  uint8_t op_type;           /**< sio_op_type_t */
+  uint8_t status;            /**< sio_op_status_t at the time of the event */
+  uint8_t reserved;          /**< Zero */
+} sio_trace_event_t;
+
+#define SIO_TRACE_MAGIC "SIOTRACE"
+#define SIO_TRACE_VERSION 1
+
+/**
+* @brief Header written by sio_context_trace_dump, followed by count events
+*/
+typedef struct sio_trace_header {
+  char magic[8];             /**< SIO_TRACE_MAGIC, not NUL terminated */
+  uint32_t version;          /**< SIO_TRACE_VERSION */
+  uint32_t event_size;       /**< sizeof(sio_trace_event_t) */
+  uint64_t count;            /**< Events that follow, oldest first */
+  uint64_t dropped;          /**< Older events that were overwritten */
+} sio_trace_header_t;
+
+/**
+* @brief Copy the newest trace events
+* 
+* With SIO_CTX_TRACE the context records submissions, kernel entries,
+* completions, cancellations and expired deadlines in a ring of
+* sio_context_config_t.trace_events entries that overwrites its oldest events.
+* Only the owning thread writes the ring, so recording takes no lock and no
+* atomic: a clock read and a 32 byte store. Call this from the owning thread,
+* for example from the completion callback that saw an outlier.
+* 
+* @param context Context to query
+* @param events Receives up to max events, oldest first
+* @param max Capacity of events
+* @param count Receives the number of events copied
+* @return sio_error_t SIO_SUCCESS, SIO_ERROR_UNSUPPORTED without SIO_CTX_TRACE or error code
+*/
+SIO_EXPORT sio_error_t sio_context_trace_copy(const sio_context_t *context, sio_trace_event_t *events, size_t max, size_t *count);
+
+/**
+* @brief Write the trace ring to a stream
+* 
+* Writes a sio_trace_header_t and then every event still in the ring, oldest
+* first, in native byte order. Meant for a file opened with sio_stream_open_file;
+* the write is synchronous and must run on the owning thread.
+* 
+* @param context Context to dump
+* @param stream Stream to write to
+* @return sio_error_t SIO_SUCCESS, SIO_ERROR_UNSUPPORTED without SIO_CTX_TRACE or error code
+*/
+SIO_EXPORT sio_error_t sio_context_trace_dump(const sio_context_t *context, sio_stream_t *stream);
+
 /**
 * @brief Get the number of pending operations on a context
 * 
+* Kept as a counter, this does not walk the operations.
+* 
 * @param context Context to query
 * @return size_t Number of pending operations
 */
@@ -263,11 +762,24 @@ SIO_EXPORT size_t sio_context_pending_count(const sio_context_t *context);
 
 /**
 * @brief io_uring specific configuration
+*
+* Zero fields select the defaults: sq_entries from the context queue depth,
+* cq_entries twice the submission queue size and fixed_files 4096 slots (capped
+* by RLIMIT_NOFILE). Streams registered once the table is full keep working
+* through their plain descriptor.
+*
+* With IORING_SETUP_SQPOLL a kernel thread picks up submissions without any
+* system call; it sleeps after sq_thread_idle milliseconds without work and is
+* woken by the next submission. Add IORING_SETUP_SQ_AFF to pin it to
+* sq_thread_cpu. Kernels before 5.11 require CAP_SYS_NICE for SQPOLL.
 */
 typedef struct sio_io_uring_config {
   uint32_t flags;        /**< IORING_SETUP_* flags */
   uint32_t sq_entries;   /**< Submission queue entries */
   uint32_t cq_entries;   /**< Completion queue entries */
+  uint32_t fixed_files;  /**< Fixed file table slots for registered streams (0 = default) */
+  uint32_t sq_thread_cpu;  /**< CPU of the SQPOLL thread (with IORING_SETUP_SQ_AFF) */
+  uint32_t sq_thread_idle; /**< SQPOLL thread idle time in milliseconds before it sleeps (0 = kernel default) */
   /* Other io_uring specific options */
 } sio_io_uring_config_t;
 
@@ -282,6 +794,12 @@ typedef struct sio_iocp_config {
 /**
 * @brief Set backend-specific configuration
 * 
+* Backends that need to rebuild kernel state (io_uring) only accept a new
+* configuration while the context has no pending operations. A configuration
+* that cannot be built leaves the previous one in place; if that cannot be
+* rebuilt either, operations fail with the returned error and waits with
+* SIO_WAIT_ERROR until a later configuration builds.
+* 
 * @param context Context to configure
 * @param backend Backend to configure
 * @param config Backend-specific configuration structure
@@ -0,0 +1,169 @@
+/**
+* @file sio/runtime.h
+* @brief Simple I/O (SIO) - Sharded multi-reactor runtime
+*
+* Runs one I/O context per shard, each on its own thread and optionally pinned
+* to its own CPU. Shards share no mutable state: every shard owns its context,
+* its listener and whatever it allocates, and other threads only reach it
+* through sio_runtime_post. With a listen address every shard gets its own
+* SO_REUSEPORT listener on that address, so the kernel spreads incoming
+* connections across the shards instead of one accept loop feeding the others.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#ifndef SIO_RUNTIME_H
+#define SIO_RUNTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sio/platform.h>
+#include <sio/err.h>
+#include <sio/stream.h>
+#include <sio/context.h>
+#include <sio/aux/thread.h>
+
+typedef struct sio_runtime sio_runtime_t;
+
+/**
+* @brief Runtime flags
+*/
+typedef enum sio_runtime_flags {
+  SIO_RUNTIME_NONE  = 0,        /**< No flags */
+  SIO_RUNTIME_PIN   = (1 << 0), /**< Pin shard i to CPU i (modulo the hardware threads) */
+  SIO_RUNTIME_STEER = (1 << 1)  /**< Hand connections to the listener of the shard on the CPU that received them (Linux) */
+} sio_runtime_flags_t;
+
+/**
+* @brief A shard of the runtime
+*
+* Everything in here belongs to the shard thread once the runtime is running.
+*/
+typedef struct sio_runtime_shard {
+  sio_runtime_t *runtime;        /**< Runtime the shard belongs to */
+  uint32_t index;                /**< Shard index */
+  int cpu;                       /**< CPU the shard thread is pinned to (-1 if not pinned) */
+  sio_context_t *context;        /**< Context of the shard, created on the shard thread */
+  sio_stream_t listener;         /**< Listener of the shard (valid if has_listener is set) */
+  int has_listener;              /**< Whether the shard has a listener */
+  void *user_data;               /**< Shard private data, starts out as the config user_data */
+
+  /* Internal */
+  sio_thread_t thread;           /**< Shard thread */
+  int32_t stop;                  /**< Set to make the shard loop return */
+  sio_error_t error;             /**< Why the shard failed to start or its loop ended */
+} sio_runtime_shard_t;
+
+/**
+* @brief Shard start callback, runs on the shard thread before its loop
+*
+* Typically submits an accept on the listener. A failure aborts sio_runtime_create.
+*/
+typedef sio_error_t (*sio_runtime_start_fn)(sio_runtime_shard_t *shard);
+
+/**
+* @brief Shard stop callback, runs on the shard thread after its loop before the context is destroyed
+*/
+typedef void (*sio_runtime_stop_fn)(sio_runtime_shard_t *shard);
+
+/**
+* @brief Runtime configuration
+*/
+typedef struct sio_runtime_config {
+  uint32_t shards;                /**< Number of shards (0 = one per hardware thread) */
+  uint32_t flags;                 /**< Runtime flags (sio_runtime_flags_t) */
+  sio_context_config_t context;   /**< Configuration of every shard context (SIO_CTX_THREAD_SAFE is always added) */
+  sio_addr_t *listen_addr;        /**< Address every shard listens on (NULL = no listeners, port 0 = one port picked for all) */
+  sio_stream_flags_t listen_flags; /**< Flags for the listeners, SIO_STREAM_SERVER and SIO_STREAM_REUSEPORT are added */
+  uint32_t max_events;            /**< Completions dispatched per wait (0 = context default) */
+  sio_runtime_start_fn start;     /**< Called on every shard thread before its loop (can be NULL) */
+  sio_runtime_stop_fn stop;       /**< Called on every shard thread after its loop (can be NULL) */
+  void *user_data;                /**< Initial user_data of every shard */
+} sio_runtime_config_t;
+
+/**
+* @brief Initialize a runtime configuration with default values
+*
+* @param config Configuration to initialize
+*/
+SIO_EXPORT void sio_runtime_config_init(sio_runtime_config_t *config);
+
+/**
+* @brief Create a runtime and start its shards
+*
+* Listeners are opened here, in shard order, so their position in the
+* SO_REUSEPORT group matches the shard index. With SIO_RUNTIME_STEER a classic
+* BPF program returning the receiving CPU modulo the shard count is attached to
+* the group; together with SIO_RUNTIME_PIN and one shard per CPU a connection is
+* accepted and served on the CPU whose softirq received it. Each shard thread
+* then pins itself, creates its context (so its memory is first touched there),
+* runs the start callback and waits on the context until stopped. The context's
+* completion callback receives the sio_runtime_shard_t as its user_data. This
+* returns once every shard is running, or after tearing everything down again if
+* one failed.
+*
+* @param runtime Pointer to store the runtime
+* @param config Runtime configuration
+* @return sio_error_t SIO_SUCCESS or error code (SIO_ERROR_UNSUPPORTED for
+*         listeners or steering where the platform has no SO_REUSEPORT)
+*/
+SIO_EXPORT sio_error_t sio_runtime_create(sio_runtime_t **runtime, const sio_runtime_config_t *config);
+
+/**
+* @brief Ask every shard to leave its loop
+*
+* May be called from any thread, including a shard's own callbacks.
+*
+* @param runtime Runtime to stop
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_runtime_stop(sio_runtime_t *runtime);
+
+/**
+* @brief Stop the shards, wait for their threads and release the runtime
+*
+* Must not be called from a shard thread.
+*
+* @param runtime Runtime to destroy
+* @return sio_error_t SIO_SUCCESS or the first error a shard loop ended with
+*/
+SIO_EXPORT sio_error_t sio_runtime_destroy(sio_runtime_t *runtime);
+
+/**
+* @brief Get the number of shards
+*
+* @param runtime Runtime to query
+* @return uint32_t Number of shards
+*/
+SIO_EXPORT uint32_t sio_runtime_shard_count(const sio_runtime_t *runtime);
+
+/**
+* @brief Get a shard
+*
+* @param runtime Runtime to query
+* @param index Shard index
+* @return sio_runtime_shard_t* Shard or NULL if index is out of range
+*/
+SIO_EXPORT sio_runtime_shard_t *sio_runtime_get_shard(sio_runtime_t *runtime, uint32_t index);
+
+/**
+* @brief Hand an operation to a shard
+*
+* Delivers op as a completion on the shard thread (see sio_context_post), the
+* only way for other threads to reach a shard's state.
+*
+* @param runtime Runtime
+* @param index Shard index
+* @param op Operation to deliver
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+SIO_EXPORT sio_error_t sio_runtime_post(sio_runtime_t *runtime, uint32_t index, sio_op_t *op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIO_RUNTIME_H */
@@ -82,7 +82,8 @@ enum sio_stream_flags {
   SIO_STREAM_MMAP       = (1 << 12),  /**< Use memory mapping if possible */
   SIO_STREAM_DIRECT     = (1 << 13),  /**< Direct I/O (bypass cache if possible) */
   SIO_STREAM_SERVER     = (1 << 14),  /**< Set the stream to be a host for other streams if applicable */
-  SIO_STREAM_TCP        = (1 << 15)   /**< Set the stream to be a connection socket */
+  SIO_STREAM_TCP        = (1 << 15),  /**< Set the stream to be a connection socket */
+  SIO_STREAM_REUSEPORT  = (1 << 16)   /**< Let several server sockets bind the same address, the kernel balances between them (SO_REUSEPORT) */
 };
 
 typedef enum sio_stream_flags sio_stream_flags_t;
@@ -0,0 +1,140 @@
+/**
+* @file src/aux/hist.c
+* @brief Implementation of the SIO log-linear histograms
+*
+* Values below SIO_HIST_SUB_COUNT have a bucket each. Above that, a value whose
+* highest set bit is m lands in group m - SIO_HIST_SUB_BITS + 1, and its next
+* SIO_HIST_SUB_BITS bits select the sub-bucket within the group.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/aux/hist.h>
+#include <string.h>
+
+#if defined(SIO_COMPILER_MSVC)
+  #include <intrin.h>
+#endif
+
+/**
+* @brief Index of the highest set bit of a non-zero value
+*/
+static unsigned hist_msb(uint64_t value) {
+#if defined(SIO_COMPILER_MSVC)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return (unsigned)index;
+#else
+  return 63u - (unsigned)__builtin_clzll(value);
+#endif
+}
+
+/**
+* @brief Initialize or reset a histogram to empty
+*/
+void sio_hist_init(sio_hist_t *hist) {
+  memset(hist, 0, sizeof(*hist));
+  hist->min = UINT64_MAX;
+}
+
+/**
+* @brief Get the bucket a value is counted in
+*/
+uint32_t sio_hist_bucket(uint64_t value) {
+  if (value < SIO_HIST_SUB_COUNT) {
+    return (uint32_t)value;
+  }
+
+  unsigned msb = hist_msb(value);
+  if (msb >= SIO_HIST_MAX_BITS) {
+    return SIO_HIST_BUCKETS - 1;
+  }
+
+  unsigned shift = msb - SIO_HIST_SUB_BITS;
+  return (shift + 1) * SIO_HIST_SUB_COUNT + (uint32_t)(value >> shift) - SIO_HIST_SUB_COUNT;
+}
+
+/**
+* @brief Get the highest value counted in a bucket
+*/
+uint64_t sio_hist_bucket_max(uint32_t bucket) {
+  if (bucket < SIO_HIST_SUB_COUNT) {
+    return bucket;
+  }
+  if (bucket >= SIO_HIST_BUCKETS - 1) {
+    return UINT64_MAX;
+  }
+
+  unsigned shift = bucket / SIO_HIST_SUB_COUNT - 1;
+  uint64_t low = (uint64_t)(SIO_HIST_SUB_COUNT + bucket % SIO_HIST_SUB_COUNT) << shift;
+  return low + ((uint64_t)1 << shift) - 1;
+}
+
+/**
+* @brief Record a value
+*/
+void sio_hist_record(sio_hist_t *hist, uint64_t value) {
+  hist->buckets[sio_hist_bucket(value)]++;
+  hist->count++;
+  hist->sum += value;
+  if (value < hist->min) {
+    hist->min = value;
+  }
+  if (value > hist->max) {
+    hist->max = value;
+  }
+}
+
+/**
+* @brief Add the values of one histogram to another
+*/
+void sio_hist_merge(sio_hist_t *dst, const sio_hist_t *src) {
+  for (uint32_t i = 0; i < SIO_HIST_BUCKETS; i++) {
+    dst->buckets[i] += src->buckets[i];
+  }
+  dst->count += src->count;
+  dst->sum += src->sum;
+  if (src->min < dst->min) {
+    dst->min = src->min;
+  }
+  if (src->max > dst->max) {
+    dst->max = src->max;
+  }
+}
+
+/**
+* @brief Get the value at a percentile
+*/
+uint64_t sio_hist_percentile(const sio_hist_t *hist, double percentile) {
+  if (!hist->count) {
+    return 0;
+  }
+
+  if (percentile < 0.0) {
+    percentile = 0.0;
+  } else if (percentile > 100.0) {
+    percentile = 100.0;
+  }
+
+  /* Rank of the value at the percentile, 1-based and rounded up */
+  double exact = percentile / 100.0 * (double)hist->count;
+  uint64_t rank = (uint64_t)exact;
+  if ((double)rank < exact) {
+    rank++;
+  }
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < SIO_HIST_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if (seen >= rank) {
+      uint64_t value = sio_hist_bucket_max(i);
+      return value < hist->max ? value : hist->max;
+    }
+  }
+
+  return hist->max;
+}
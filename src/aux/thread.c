@@ -2638,7 +2638,7 @@ static void *sio_threadpool_worker(void *arg) {
     sio_mutex_lock(&pool->lock);
     
     /* Wait for tasks or shutdown signal */
-    while (pool->task_count == 0 && !pool->shutdown && pool->paused) {
+    while ((pool->task_count == 0 || pool->paused) && !pool->shutdown) {
       sio_cond_wait(&pool->not_empty, &pool->lock);
     }
     
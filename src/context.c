@@ -0,0 +1,2554 @@
+/**
+* @file src/context.c
+* @brief Implementation of the backend independent I/O context layer
+*
+* Validates and tracks operations, keeps the table of registered streams and the
+* ready list, and dispatches completions. Platform specific event handling is
+* delegated to the selected backend through its sio_context_backend_ops_t vtable.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/context.h>
+#include <sio/err.h>
+#include <src/context/backend.h>
+#include <sio/aux/thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(SIO_OS_POSIX)
+  #include <errno.h>
+  #include <time.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/stat.h>
+  #include <sys/socket.h>
+#elif defined(SIO_OS_WINDOWS)
+  #include <windows.h>
+#endif
+
+#if defined(SIO_ARCH_X86_64) && (defined(SIO_COMPILER_GCC) || defined(SIO_COMPILER_CLANG))
+  #include <x86intrin.h>
+  #include <cpuid.h>
+  #define SIO_CONTEXT_TSC 1
+#endif
+
+#define SIO_CONTEXT_DEFAULT_MAX_EVENTS 64
+#define SIO_CONTEXT_DEFAULT_QUEUE_DEPTH 256
+#define SIO_CONTEXT_STARVATION_LIMIT 8
+#define SIO_CONTEXT_DEFAULT_TRACE_EVENTS 4096
+
+/**
+* @brief Read a monotonic clock
+*
+* @return uint64_t Nanoseconds since an arbitrary point
+*/
+static uint64_t context_now_ns(void) {
+#if defined(SIO_OS_POSIX)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#elif defined(SIO_OS_WINDOWS)
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000 + (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / (uint64_t)freq.QuadPart;
+#else
+  return 0;
+#endif
+}
+
+/**
+* @brief Read a monotonic clock
+*
+* @return uint64_t Microseconds since an arbitrary point
+*/
+static uint64_t context_now_us(void) {
+  return context_now_ns() / 1000;
+}
+
+#if defined(SIO_CONTEXT_TSC)
+/* Nanoseconds per TSC tick in 32.32 fixed point, 0 while the latency clock is CLOCK_MONOTONIC */
+static uint64_t context_tsc_mult;
+#endif
+
+/**
+* @brief Pick and calibrate the latency clock, once per process
+*
+* Only an invariant TSC (CPUID 0x80000007 EDX bit 8) ticks at a constant rate
+* on every core. Racing calibrations store nearly the same value, so the result
+* needs no lock.
+*/
+static void context_latency_clock_init(void) {
+#if defined(SIO_CONTEXT_TSC)
+  static int calibrated;
+  if (__atomic_load_n(&calibrated, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  unsigned int regs[4] = {0, 0, 0, 0};
+  if (__get_cpuid_max(0x80000000, NULL) >= 0x80000007) {
+    __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+  }
+
+  if (regs[3] & (1u << 8)) {
+    uint64_t ns0 = context_now_ns();
+    uint64_t tsc0 = __rdtsc();
+    uint64_t ns1;
+    while ((ns1 = context_now_ns()) - ns0 < 1000000) {
+    }
+    uint64_t tsc1 = __rdtsc();
+    if (tsc1 > tsc0) {
+      __atomic_store_n(&context_tsc_mult, ((ns1 - ns0) << 32) / (tsc1 - tsc0), __ATOMIC_RELAXED);
+    }
+  }
+  __atomic_store_n(&calibrated, 1, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+* @brief Read the latency clock
+*
+* @return uint64_t Ticks since an arbitrary point, see context_ticks_to_ns
+*/
+static SIO_INLINE uint64_t context_ticks(void) {
+#if defined(SIO_CONTEXT_TSC)
+  if (__atomic_load_n(&context_tsc_mult, __ATOMIC_RELAXED)) {
+    return __rdtsc();
+  }
+#endif
+  return context_now_ns();
+}
+
+/**
+* @brief Convert a latency clock interval to nanoseconds
+*/
+static SIO_INLINE uint64_t context_ticks_to_ns(uint64_t ticks) {
+#if defined(SIO_CONTEXT_TSC)
+  uint64_t mult = __atomic_load_n(&context_tsc_mult, __ATOMIC_RELAXED);
+  if (!mult) {
+    return ticks;
+  }
+  /* Split so the product cannot overflow for intervals of years */
+  return (ticks >> 32) * mult + (((ticks & 0xffffffffu) * mult) >> 32);
+#else
+  return ticks;
+#endif
+}
+
+/**
+* @brief Find the backend vtable for a backend type
+*
+* @param backend Backend type
+* @return const sio_context_backend_ops_t* Vtable or NULL if not compiled in
+*/
+static const sio_context_backend_ops_t *context_backend_ops(sio_context_backend_t backend) {
+  switch (backend) {
+#if defined(SIO_OS_LINUX)
+    case SIO_CONTEXT_IO_URING:
+      return &sio_context_io_uring_ops;
+    case SIO_CONTEXT_EPOLL:
+      return &sio_context_epoll_ops;
+#endif
+#if defined(SIO_OS_POSIX)
+    case SIO_CONTEXT_POLL:
+      return &sio_context_poll_ops;
+    case SIO_CONTEXT_SELECT:
+      return &sio_context_select_ops;
+#endif
+    default:
+      return NULL;
+  }
+}
+
+/**
+* @brief Allocate and initialize a context for a specific backend
+*
+* @param context Pointer to receive the new context
+* @param ops Backend vtable
+* @param config Configuration options
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t context_create_backend(sio_context_t **context, const sio_context_backend_ops_t *ops, const sio_context_config_t *config) {
+  sio_context_t *ctx = (sio_context_t*)calloc(1, ops->context_size);
+  if (!ctx) {
+    return SIO_ERROR_MEM;
+  }
+
+  ctx->ops = ops;
+  ctx->flags = config->flags;
+  ctx->max_events = config->max_events ? config->max_events : SIO_CONTEXT_DEFAULT_MAX_EVENTS;
+  ctx->queue_depth = config->queue_depth ? config->queue_depth : SIO_CONTEXT_DEFAULT_QUEUE_DEPTH;
+  ctx->completion_fn = config->completion_fn;
+  ctx->user_data = config->user_data;
+  ctx->spin_us = ctx->spin_budget = config->spin_us;
+  sio_wheel_init(&ctx->timers, context_now_us() / 1000);
+
+  /* One state per operation the queue depth allows, the cache only grows past that */
+  sio_error_t err = sio_slab_init(&ctx->states, sizeof(sio_op_state_t), ctx->queue_depth);
+  if (err != SIO_SUCCESS) {
+    free(ctx);
+    return err;
+  }
+
+  if (ctx->flags & SIO_CTX_LATENCY) {
+    ctx->latency = (sio_hist_t*)malloc(SIO_OP_TYPE_COUNT * sizeof(sio_hist_t));
+    if (!ctx->latency) {
+      sio_slab_destroy(&ctx->states);
+      free(ctx);
+      return SIO_ERROR_MEM;
+    }
+    for (int i = 0; i < SIO_OP_TYPE_COUNT; i++) {
+      sio_hist_init(&ctx->latency[i]);
+    }
+    context_latency_clock_init();
+  }
+
+  if (ctx->flags & SIO_CTX_TRACE) {
+    uint64_t entries = 1;
+    while (entries < (config->trace_events ? config->trace_events : SIO_CONTEXT_DEFAULT_TRACE_EVENTS)) {
+      entries <<= 1;
+    }
+    ctx->trace = (sio_trace_event_t*)calloc((size_t)entries, sizeof(sio_trace_event_t));
+    if (!ctx->trace) {
+      free(ctx->latency);
+      sio_slab_destroy(&ctx->states);
+      free(ctx);
+      return SIO_ERROR_MEM;
+    }
+    ctx->trace_mask = entries - 1;
+    context_latency_clock_init();
+  }
+
+  err = ops->init(ctx, config);
+  if (err != SIO_SUCCESS) {
+    free(ctx->trace);
+    free(ctx->latency);
+    sio_slab_destroy(&ctx->states);
+    free(ctx->entries);
+    free(ctx);
+    return err;
+  }
+
+  *context = ctx;
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Allocate the internal state for an operation from the context's cache
+*
+* @param ctx Context
+* @return sio_op_state_t* Zeroed state or NULL on allocation failure
+*/
+static sio_op_state_t *context_state_alloc(sio_context_t *ctx) {
+  sio_op_state_t *state = (sio_op_state_t*)sio_slab_alloc(&ctx->states);
+  if (state) {
+    memset(state, 0, sizeof(*state));
+  }
+  return state;
+}
+
+/**
+* @brief Release the internal state of an operation
+*
+* @param ctx Context
+* @param state State to release
+*/
+static void context_state_free(sio_context_t *ctx, sio_op_state_t *state) {
+  sio_slab_free(&ctx->states, state);
+}
+
+/**
+* @brief Link a state into the outstanding list of its entry
+*/
+static void context_stream_link(sio_op_state_t *st) {
+  sio_context_entry_t *entry = st->entry;
+
+  st->stream_prev = NULL;
+  st->stream_next = entry->ops;
+  if (entry->ops) {
+    entry->ops->stream_prev = st;
+  }
+  entry->ops = st;
+}
+
+/**
+* @brief Unlink a state from the outstanding list of its entry
+*/
+static void context_stream_unlink(sio_op_state_t *st) {
+  if (st->stream_prev) {
+    st->stream_prev->stream_next = st->stream_next;
+  } else {
+    st->entry->ops = st->stream_next;
+  }
+  if (st->stream_next) {
+    st->stream_next->stream_prev = st->stream_prev;
+  }
+  st->stream_next = st->stream_prev = NULL;
+}
+
+/**
+* @brief Link a state into the in-flight list and the list of its stream
+*
+* A state whose stream is not registered yet is counted as unlisted until
+* sio_context_entry_ensure gives it an entry.
+*/
+static void context_inflight_add(sio_context_t *ctx, sio_op_state_t *st) {
+  st->all_prev = NULL;
+  st->all_next = ctx->inflight;
+  if (ctx->inflight) {
+    ctx->inflight->all_prev = st;
+  }
+  ctx->inflight = st;
+
+  if (st->entry) {
+    context_stream_link(st);
+  } else if (st->fd >= 0) {
+    st->flags |= SIO_OP_STATE_UNLISTED;
+    ctx->unlisted++;
+  }
+}
+
+/**
+* @brief Unlink a state from the in-flight list and the list of its stream
+*/
+static void context_inflight_remove(sio_context_t *ctx, sio_op_state_t *st) {
+  if (st->all_prev) {
+    st->all_prev->all_next = st->all_next;
+  } else {
+    ctx->inflight = st->all_next;
+  }
+  if (st->all_next) {
+    st->all_next->all_prev = st->all_prev;
+  }
+  st->all_next = st->all_prev = NULL;
+
+  if (st->flags & SIO_OP_STATE_UNLISTED) {
+    st->flags &= ~(uint32_t)SIO_OP_STATE_UNLISTED;
+    ctx->unlisted--;
+  } else if (st->entry) {
+    context_stream_unlink(st);
+  }
+}
+
+/**
+* @brief Grow the entries table so that it can be indexed by fd
+*
+* @param ctx Context
+* @param fd Descriptor that must fit
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t context_entries_reserve(sio_context_t *ctx, int fd) {
+  if ((size_t)fd < ctx->entry_capacity) {
+    return SIO_SUCCESS;
+  }
+
+  size_t capacity = ctx->entry_capacity ? ctx->entry_capacity : 64;
+  while (capacity <= (size_t)fd) {
+    capacity *= 2;
+  }
+
+  sio_context_entry_t **entries = (sio_context_entry_t**)realloc(ctx->entries, capacity * sizeof(*entries));
+  if (!entries) {
+    return SIO_ERROR_MEM;
+  }
+
+  memset(entries + ctx->entry_capacity, 0, (capacity - ctx->entry_capacity) * sizeof(*entries));
+  ctx->entries = entries;
+  ctx->entry_capacity = capacity;
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Register a stream by descriptor
+*
+* @param ctx Context
+* @param stream Stream to register
+* @param fd Native descriptor of the stream
+* @param user_data User data for the entry
+* @param out Pointer to receive the entry (can be NULL)
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t context_entry_add(sio_context_t *ctx, sio_stream_t *stream, int fd, void *user_data, sio_context_entry_t **out) {
+  sio_error_t err = context_entries_reserve(ctx, fd);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  if (ctx->entries[fd]) {
+    return SIO_ERROR_EXISTS;
+  }
+
+  sio_context_entry_t *entry = (sio_context_entry_t*)calloc(1, sizeof(sio_context_entry_t));
+  if (!entry) {
+    return SIO_ERROR_MEM;
+  }
+
+  entry->stream = stream;
+  entry->user_data = user_data;
+  entry->fd = fd;
+  entry->slot = -1;
+
+  if (ctx->ops->add) {
+    err = ctx->ops->add(ctx, entry);
+    if (err != SIO_SUCCESS) {
+      free(entry);
+      return err;
+    }
+  }
+
+  ctx->entries[fd] = entry;
+  if (out) {
+    *out = entry;
+  }
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Take the next completion to dispatch
+*
+* The highest class with completions goes first, unless a lower class has been
+* passed over SIO_CONTEXT_STARVATION_LIMIT times in a row.
+*
+* @param ctx Context
+* @return sio_op_state_t* State or NULL if the ready lists are empty
+*/
+static sio_op_state_t *context_ready_pop(sio_context_t *ctx) {
+  uint32_t pick = SIO_CONTEXT_PRIORITY_CLASSES;
+
+  for (uint32_t c = 1; c < SIO_CONTEXT_PRIORITY_CLASSES; c++) {
+    if (ctx->ready[c].head && ctx->ready_skipped[c] >= SIO_CONTEXT_STARVATION_LIMIT) {
+      pick = c;
+      break;
+    }
+  }
+  for (uint32_t c = 0; c < SIO_CONTEXT_PRIORITY_CLASSES && pick == SIO_CONTEXT_PRIORITY_CLASSES; c++) {
+    if (ctx->ready[c].head) {
+      pick = c;
+    }
+  }
+  if (pick == SIO_CONTEXT_PRIORITY_CLASSES) {
+    return NULL;
+  }
+
+  for (uint32_t c = 0; c < SIO_CONTEXT_PRIORITY_CLASSES; c++) {
+    if (c != pick && ctx->ready[c].head) {
+      ctx->ready_skipped[c]++;
+    }
+  }
+  ctx->ready_skipped[pick] = 0;
+
+  return sio_op_queue_pop(&ctx->ready[pick]);
+}
+
+/**
+* @brief Dispatch completed operations from the ready lists
+*
+* @param ctx Context
+* @param max_events Maximum number of completions to dispatch
+* @param out Receives the operations instead of the completion callback (NULL to call it)
+* @return uint32_t Number of completions dispatched
+*/
+static uint32_t context_dispatch(sio_context_t *ctx, uint32_t max_events, sio_op_t **out) {
+  uint32_t count = 0;
+
+  if (!ctx->ready_count) {
+    return 0;
+  }
+
+  /* One clock read per batch, not per callback */
+  int timed = !out && ctx->completion_fn;
+  uint64_t start = timed ? context_now_ns() : 0;
+  uint64_t now = ctx->latency ? context_ticks() : 0;
+
+  while (count < max_events) {
+    sio_op_state_t *st = context_ready_pop(ctx);
+    if (!st) {
+      break;
+    }
+
+    sio_op_t *op = st->op;
+    ctx->ready_count--;
+    ctx->pending--;
+    ctx->stats.completed[op->type]++;
+    if (ctx->latency) {
+      sio_hist_record(&ctx->latency[op->type], context_ticks_to_ns(now > st->queued_at ? now - st->queued_at : 0));
+    }
+    op->internal = NULL;
+    context_state_free(ctx, st);
+
+    if (out) {
+      out[count++] = op;
+    } else {
+      count++;
+      if (ctx->completion_fn) {
+        ctx->completion_fn(op, ctx->user_data);
+      }
+    }
+  }
+
+  if (timed) {
+    ctx->stats.callback_ns += context_now_ns() - start;
+  }
+  if (count) {
+    ctx->stats.batches++;
+    ctx->stats.batch_completions += count;
+    if (count > ctx->stats.batch_max) {
+      ctx->stats.batch_max = count;
+    }
+  }
+
+  return count;
+}
+
+/* Generic layer services for backends */
+
+int sio_context_stream_fd(const sio_stream_t *stream) {
+#if defined(SIO_OS_POSIX)
+  switch (stream->type) {
+    case SIO_STREAM_FILE:
+      return stream->data.file.fd;
+    case SIO_STREAM_SOCKET:
+      return stream->data.socket.fd;
+    case SIO_STREAM_PIPE:
+      return (stream->flags & SIO_STREAM_WRITE) ? stream->data.pipe.write_fd : stream->data.pipe.read_fd;
+    case SIO_STREAM_TIMER:
+      return stream->data.timer.fd;
+    case SIO_STREAM_SIGNAL:
+      return stream->data.signal.fd;
+    case SIO_STREAM_MSGQUEUE:
+      return (int)stream->data.msgqueue.mqd;
+    case SIO_STREAM_SHMEM:
+      return stream->data.shmem.fd;
+    case SIO_STREAM_TERMINAL:
+      return stream->data.terminal.fd;
+    default:
+      return -1;
+  }
+#else
+  (void)stream;
+  return -1;
+#endif
+}
+
+sio_context_entry_t *sio_context_entry_get(sio_context_t *ctx, int fd) {
+  if (fd < 0 || (size_t)fd >= ctx->entry_capacity) {
+    return NULL;
+  }
+  return ctx->entries[fd];
+}
+
+int sio_context_fixed_buffer_find(const sio_context_t *ctx, const void *addr, size_t len) {
+  uintptr_t start = (uintptr_t)addr;
+  size_t lo = 0, hi = ctx->fixed_buffer_count;
+
+  /* Find the last buffer starting at or before addr */
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ctx->fixed_buffers[mid].base <= start) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo == 0) {
+    return -1;
+  }
+
+  const sio_context_fixed_buffer_t *fb = &ctx->fixed_buffers[lo - 1];
+  if (start - fb->base > fb->len || len > fb->len - (start - fb->base)) {
+    return -1;
+  }
+
+  return (int)fb->index;
+}
+
+sio_error_t sio_context_entry_ensure(sio_context_t *ctx, sio_op_state_t *state) {
+  if (state->entry) {
+    return SIO_SUCCESS;
+  }
+
+  /* An operation held in a chain can find the entry added for its predecessor */
+  state->entry = sio_context_entry_get(ctx, state->fd);
+  if (!state->entry) {
+    sio_error_t err = context_entry_add(ctx, state->op->stream, state->fd, NULL, &state->entry);
+    if (err != SIO_SUCCESS) {
+      return err;
+    }
+  }
+
+  if (state->flags & SIO_OP_STATE_UNLISTED) {
+    state->flags &= ~(uint32_t)SIO_OP_STATE_UNLISTED;
+    ctx->unlisted--;
+  }
+  context_stream_link(state);
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Set the next expiry of a timer operation
+*/
+static void context_timer_set(sio_op_state_t *st, uint64_t expires) {
+  st->timer_expires = expires;
+  st->timer_ts[0] = (int64_t)(expires / 1000000000);
+  st->timer_ts[1] = (int64_t)(expires % 1000000000);
+}
+
+/**
+* @brief Put an operation the backend has no room for on the deferred queue of its class
+*/
+static void context_defer(sio_context_t *context, sio_op_state_t *st) {
+  st->flags |= SIO_OP_STATE_DEFERRED;
+  sio_op_queue_push(&context->deferred[st->prio], st);
+  context->deferred_count++;
+}
+
+/**
+* @brief Whether an operation transfers data, and so counts a short transfer as failure in a chain
+*/
+static int context_op_is_transfer(const sio_op_t *op) {
+  return op->type == SIO_OP_READ || op->type == SIO_OP_WRITE ||
+         (op->type >= SIO_OP_READ_AT && op->type <= SIO_OP_WRITEV_AT);
+}
+
+/**
+* @brief Number of bytes a transfer asks for, summed over the entries of a vectored one
+*/
+static size_t context_op_length(const sio_op_t *op) {
+  if (op->type != SIO_OP_READV_AT && op->type != SIO_OP_WRITEV_AT) {
+    return op->size;
+  }
+
+  const sio_iovec_t *iov = (const sio_iovec_t*)op->buffer;
+  size_t total = 0;
+  for (size_t i = 0; i < op->size; i++) {
+#if defined(SIO_OS_WINDOWS)
+    total += iov[i].len;
+#else
+    total += iov[i].iov_len;
+#endif
+  }
+  return total;
+}
+
+/**
+* @brief Start or cancel the operation held behind a finished one
+*
+* @param ctx Context
+* @param done Operation that just finished
+* @param next Held successor
+*/
+static void context_link_next(sio_context_t *ctx, const sio_op_t *done, sio_op_state_t *next) {
+  /* Short transfers break the chain, as they do for IOSQE_IO_LINK */
+  int ok = done->status == SIO_OP_COMPLETE &&
+           (!context_op_is_transfer(done) || done->result == context_op_length(done));
+
+  if (!ok) {
+    sio_context_complete_status(ctx, next, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+    return;
+  }
+
+  next->flags &= ~SIO_OP_STATE_HELD;
+  sio_error_t err = ctx->ops->submit(ctx, next);
+  if (err == SIO_ERROR_BUSY) {
+    context_defer(ctx, next);
+  } else if (err != SIO_SUCCESS) {
+    sio_context_complete_status(ctx, next, SIO_OP_ERROR, err, 0);
+  }
+}
+
+void sio_context_complete_status(sio_context_t *ctx, sio_op_state_t *state, sio_op_status_t status, sio_error_t error, size_t result) {
+  assert(!(state->flags & SIO_OP_STATE_DONE));
+
+  sio_op_t *op = state->op;
+
+  if (sio_wheel_armed(&state->deadline)) {
+    sio_wheel_remove(&ctx->timers, &state->deadline);
+  }
+
+  /* Cancelled because the deadline passed, unless the result won the race */
+  if (status == SIO_OP_CANCELLED && (state->flags & SIO_OP_STATE_EXPIRED)) {
+    status = SIO_OP_TIMEOUT;
+    error = SIO_ERROR_TIMEOUT;
+  }
+
+  op->status = status;
+  op->error = error;
+  op->result = result;
+  op->flags &= ~(uint32_t)SIO_OP_FLAG_MORE;
+  sio_context_trace(ctx, SIO_TRACE_COMPLETE, op, state->fd, status == SIO_OP_COMPLETE ? (int64_t)result : (int64_t)error);
+
+  context_inflight_remove(ctx, state);
+  state->flags |= SIO_OP_STATE_DONE;
+  sio_op_queue_push(&ctx->ready[state->prio], state);
+  ctx->ready_count++;
+
+  /* A cancelled chain member can finish before its predecessor */
+  if (state->link_prev) {
+    state->link_prev->link = NULL;
+    state->link_prev = NULL;
+  }
+
+  sio_op_state_t *next = state->link;
+  if (next) {
+    state->link = NULL;
+    next->link_prev = NULL;
+    if (next->flags & SIO_OP_STATE_HELD) {
+      context_link_next(ctx, op, next);
+    }
+  }
+}
+
+void sio_context_timer_arm(sio_context_t *ctx, sio_op_state_t *state) {
+  /* Rounded up, a wheel tick fires once its whole millisecond has begun */
+  sio_wheel_add(&ctx->timers, &state->deadline, (state->timer_expires + 999999) / 1000000);
+}
+
+void sio_context_timer_expired(sio_context_t *ctx, sio_op_state_t *state) {
+  sio_op_t *op = state->op;
+
+  if (!(op->flags & SIO_OP_FLAG_REPEAT)) {
+    sio_context_complete_status(ctx, state, SIO_OP_COMPLETE, SIO_SUCCESS, 1);
+    return;
+  }
+
+  /* The cancel was issued after this expiry, re-arming would leave it nothing to find */
+  if (state->flags & SIO_OP_STATE_CANCELLING) {
+    sio_context_complete_status(ctx, state, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+    return;
+  }
+
+  /* Next expiry on the original schedule, skipping the periods already missed */
+  uint64_t period = (uint64_t)op->size * 1000000;
+  uint64_t now = context_now_ns();
+  uint64_t count = now > state->timer_expires ? 1 + (now - state->timer_expires) / period : 1;
+  context_timer_set(state, state->timer_expires + count * period);
+
+  /* Re-armed before the callback runs, so the callback can cancel it */
+  sio_error_t err = ctx->ops->submit(ctx, state);
+  if (err == SIO_ERROR_BUSY) {
+    context_defer(ctx, state);
+  } else if (err != SIO_SUCCESS) {
+    sio_context_complete_status(ctx, state, SIO_OP_ERROR, err, 0);
+    return;
+  }
+
+  sio_context_notify(ctx, state, (int64_t)count);
+}
+
+void sio_context_trace_record(sio_context_t *ctx, sio_trace_kind_t kind, const sio_op_t *op, int fd, int64_t result) {
+  sio_trace_event_t *ev = &ctx->trace[ctx->trace_head++ & ctx->trace_mask];
+
+  ev->time = context_ticks();
+  ev->op = (uint64_t)(uintptr_t)op;
+  ev->result = result;
+  ev->fd = fd;
+  ev->kind = (uint8_t)kind;
+  ev->op_type = op ? (uint8_t)op->type : 0;
+  ev->status = op ? (uint8_t)op->status : 0;
+  ev->reserved = 0;
+}
+
+void sio_context_notify(sio_context_t *ctx, sio_op_state_t *state, int64_t res) {
+  sio_op_t *op = state->op;
+
+  op->status = SIO_OP_COMPLETE;
+  op->error = SIO_SUCCESS;
+  op->result = (size_t)res;
+  op->flags |= SIO_OP_FLAG_MORE;
+  ctx->notified++;
+  ctx->stats.completed[op->type]++;
+  sio_context_trace(ctx, SIO_TRACE_COMPLETE, op, state->fd, res);
+
+  if (ctx->completion_fn) {
+    uint64_t start = context_now_ns();
+    ctx->completion_fn(op, ctx->user_data);
+    ctx->stats.callback_ns += context_now_ns() - start;
+  }
+
+  /* Still in flight unless the callback cancelled it and the final completion already arrived */
+  if (op->internal == state && !(state->flags & SIO_OP_STATE_DONE)) {
+    op->status = SIO_OP_PENDING;
+    if (op->buffer_id >= 0) {
+      op->buffer = NULL;
+      op->buffer_id = -1;
+    }
+  }
+}
+
+void sio_context_lend_buffer(sio_context_t *ctx, sio_op_t *op, uint16_t buffer_id) {
+  ctx->ring_lent[buffer_id] = 1;
+  op->buffer = ctx->ring_pool->buffers[buffer_id].data;
+  op->buffer_id = buffer_id;
+}
+
+int sio_context_ring_take(sio_context_t *ctx) {
+  if (!ctx->ring_free_count) {
+    return -1;
+  }
+  return ctx->ring_free[--ctx->ring_free_count];
+}
+
+void sio_context_ring_put(sio_context_t *ctx, uint16_t buffer_id) {
+  ctx->ring_free[ctx->ring_free_count++] = buffer_id;
+}
+
+void sio_context_complete(sio_context_t *ctx, sio_op_state_t *state, int64_t res) {
+#if defined(SIO_OS_POSIX)
+  if (res >= 0) {
+    sio_op_t *op = state->op;
+
+    /* A zero-length read of a non-empty buffer is end of stream */
+    int is_read = op->type == SIO_OP_READ || op->type == SIO_OP_READ_AT || op->type == SIO_OP_READV_AT;
+    if (res == 0 && ((is_read && context_op_length(op) > 0) || op->type == SIO_OP_RECV_MULTISHOT)) {
+      sio_context_complete_status(ctx, state, SIO_OP_ERROR, SIO_ERROR_EOF, 0);
+      return;
+    }
+
+    sio_context_complete_status(ctx, state, SIO_OP_COMPLETE, SIO_SUCCESS, (size_t)res);
+  } else if (res == -ECANCELED) {
+    sio_context_complete_status(ctx, state, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+  } else if (res == -ETIME) {
+    sio_context_complete_status(ctx, state, SIO_OP_TIMEOUT, SIO_ERROR_TIMEOUT, 0);
+  } else {
+    sio_context_complete_status(ctx, state, SIO_OP_ERROR, sio_posix_error_to_sio_error((int)-res), 0);
+  }
+#else
+  if (res >= 0) {
+    sio_context_complete_status(ctx, state, SIO_OP_COMPLETE, SIO_SUCCESS, (size_t)res);
+  } else {
+    sio_context_complete_status(ctx, state, SIO_OP_ERROR, SIO_ERROR_IO, 0);
+  }
+#endif
+}
+
+int sio_context_zerocopy(sio_context_t *ctx, sio_op_state_t *state) {
+  sio_op_t *op = state->op;
+  sio_context_entry_t *entry = state->entry;
+
+  if (op->type != SIO_OP_WRITE || !(op->flags & SIO_OP_FLAG_ZEROCOPY) || op->size < SIO_OP_ZEROCOPY_MIN ||
+      op->stream->type != SIO_STREAM_SOCKET || !entry) {
+    return 0;
+  }
+
+#if defined(SIO_OS_LINUX) && defined(SO_ZEROCOPY)
+  /* Only TCP and UDP sockets take it, the kernel would copy for anything else anyway */
+  if (entry->zerocopy_mode == 0) {
+    int one = 1;
+    ctx->stats.syscalls++;
+    entry->zerocopy_mode = setsockopt(entry->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0 ? 1 : -1;
+  }
+  return entry->zerocopy_mode > 0;
+#else
+  (void)ctx;
+  return 0;
+#endif
+}
+
+sio_error_t sio_context_accept_fill(const sio_stream_t *server, sio_op_t *op, int fd) {
+  sio_accept_result_t *res = (sio_accept_result_t*)op->buffer;
+  int flags = (server->flags & ~SIO_STREAM_SERVER) | SIO_STREAM_NONBLOCK;
+
+  return sio_stream_from_handle(&res->stream, (void*)(intptr_t)fd, SIO_STREAM_SOCKET, (sio_stream_flags_t)flags);
+}
+
+#if defined(SIO_OS_POSIX)
+
+int sio_context_open_flags(sio_stream_flags_t opt) {
+  int flags = O_CLOEXEC;
+
+  if ((opt & SIO_STREAM_READ) && (opt & SIO_STREAM_WRITE)) {
+    flags |= O_RDWR;
+  } else if (opt & SIO_STREAM_WRITE) {
+    flags |= O_WRONLY;
+  } else {
+    flags |= O_RDONLY;
+  }
+
+  if (opt & SIO_STREAM_CREATE) {
+    flags |= O_CREAT;
+  }
+  if (opt & SIO_STREAM_EXCL) {
+    flags |= O_EXCL;
+  }
+  if (opt & SIO_STREAM_TRUNC) {
+    flags |= O_TRUNC;
+  }
+  if (opt & SIO_STREAM_APPEND) {
+    flags |= O_APPEND;
+  }
+  if (opt & SIO_STREAM_NONBLOCK) {
+    flags |= O_NONBLOCK;
+  }
+#ifdef O_DIRECT
+  if (opt & SIO_STREAM_DIRECT) {
+    flags |= O_DIRECT;
+  }
+#endif
+#ifdef O_SYNC
+  if (opt & SIO_STREAM_SYNC) {
+    flags |= O_SYNC;
+  }
+#endif
+
+  return flags;
+}
+
+sio_error_t sio_context_open_fill(sio_op_t *op, int fd) {
+  sio_open_request_t *req = (sio_open_request_t*)op->buffer;
+  return sio_stream_from_handle(&req->stream, (void*)(intptr_t)fd, SIO_STREAM_FILE, req->opt);
+}
+
+void sio_context_stat_fill(sio_op_t *op, uint32_t mode, uint64_t size, time_t atime, time_t mtime, time_t btime) {
+  sio_stat_request_t *req = (sio_stat_request_t*)op->buffer;
+  sio_file_info_t *info = &req->info;
+
+  switch (mode & S_IFMT) {
+    case S_IFREG:  info->type = SIO_FILE_TYPE_REGULAR; break;
+    case S_IFDIR:  info->type = SIO_FILE_TYPE_DIRECTORY; break;
+    case S_IFLNK:  info->type = SIO_FILE_TYPE_SYMLINK; break;
+    case S_IFIFO:  info->type = SIO_FILE_TYPE_PIPE; break;
+    case S_IFSOCK: info->type = SIO_FILE_TYPE_SOCKET; break;
+    case S_IFCHR:  info->type = SIO_FILE_TYPE_CHAR_DEVICE; break;
+    case S_IFBLK:  info->type = SIO_FILE_TYPE_BLOCK_DEVICE; break;
+    default:       info->type = SIO_FILE_TYPE_UNKNOWN; break;
+  }
+
+  info->size = size;
+  info->access_time = atime;
+  info->modify_time = mtime;
+  info->create_time = btime;
+  info->permissions = mode & 07777;
+
+  /* The last path component, as a directory listing names the file */
+  const char *name = strrchr(req->path, '/');
+  name = name && name[1] ? name + 1 : req->path;
+  snprintf(info->name, sizeof(info->name), "%s", name);
+}
+
+/**
+* @brief Run a blocking operation, on a helper thread
+*
+* @param st Operation state
+* @return int64_t Result in kernel convention
+*/
+static int64_t context_offload_call(sio_op_state_t *st) {
+  sio_op_t *op = st->op;
+  int rc;
+
+  switch (op->type) {
+    case SIO_OP_FSYNC:
+      rc = fsync(st->fd);
+      break;
+
+    case SIO_OP_SYNC_RANGE:
+#if defined(SIO_OS_LINUX)
+      rc = sync_file_range(st->fd, (off_t)op->offset, (off_t)op->size,
+                           SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+      break;
+#endif
+    case SIO_OP_FDATASYNC:
+#if defined(SIO_OS_MACOS)
+      rc = fsync(st->fd);
+#else
+      rc = fdatasync(st->fd);
+#endif
+      break;
+
+    case SIO_OP_OPEN: {
+      sio_open_request_t *req = (sio_open_request_t*)op->buffer;
+      int fd = open(req->path, sio_context_open_flags(req->opt), (mode_t)(req->mode ? req->mode : 0666));
+      if (fd < 0) {
+        return -errno;
+      }
+      if (sio_context_open_fill(op, fd) != SIO_SUCCESS) {
+        close(fd);
+        return -EINVAL;
+      }
+      return 0;
+    }
+
+    case SIO_OP_STAT: {
+      sio_stat_request_t *req = (sio_stat_request_t*)op->buffer;
+      struct stat sb;
+      rc = stat(req->path, &sb);
+      if (rc == 0) {
+        sio_context_stat_fill(op, (uint32_t)sb.st_mode, (uint64_t)sb.st_size, sb.st_atime, sb.st_mtime, sb.st_ctime);
+      }
+      break;
+    }
+
+    case SIO_OP_UNLINK:
+      rc = unlink((const char*)op->buffer);
+      break;
+
+    case SIO_OP_RENAME: {
+      const sio_rename_request_t *req = (const sio_rename_request_t*)op->buffer;
+      rc = rename(req->old_path, req->new_path);
+      break;
+    }
+
+    default:
+      return -EINVAL;
+  }
+
+  return rc < 0 ? -errno : 0;
+}
+
+/**
+* @brief Thread pool task: run an operation and hand it back to its context
+*/
+static void context_offload_task(void *arg) {
+  sio_op_state_t *st = (sio_op_state_t*)arg;
+  sio_context_t *ctx = st->offload_ctx;
+
+  st->offload_res = context_offload_call(st);
+
+  /* Only the first completion of a burst has to wake the owner, as for posts */
+  sio_op_state_t *head = __atomic_load_n(&ctx->offloaded, __ATOMIC_RELAXED);
+  do {
+    st->next = head;
+  } while (!__atomic_compare_exchange_n(&ctx->offloaded, &head, st, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  if (!head) {
+    ctx->ops->wakeup(ctx);
+  }
+}
+
+/**
+* @brief Hand an operation to the helper threads
+*
+* @return sio_error_t SIO_SUCCESS, SIO_ERROR_BUSY if the helper queue is full, or error code
+*/
+static sio_error_t context_offload_add(sio_context_t *ctx, sio_op_state_t *state) {
+  state->offload_ctx = ctx;
+  sio_error_t err = sio_threadpool_add_task(ctx->offload, context_offload_task, state, 0);
+  if (err == SIO_SUCCESS) {
+    state->flags |= SIO_OP_STATE_STARTED | SIO_OP_STATE_OFFLOADED;
+  }
+  return err;
+}
+
+sio_error_t sio_context_offload(sio_context_t *ctx, sio_op_state_t *state) {
+  if (!ctx->offload) {
+    sio_threadpool_t *pool = (sio_threadpool_t*)malloc(sizeof(sio_threadpool_t));
+    if (!pool) {
+      return SIO_ERROR_MEM;
+    }
+
+    sio_error_t err = sio_threadpool_create(pool, SIO_CONTEXT_OFFLOAD_THREADS, ctx->queue_depth);
+    if (err != SIO_SUCCESS) {
+      free(pool);
+      return err;
+    }
+    ctx->offload = pool;
+  }
+
+  /* A full helper queue must not defer the context, which would hold back every other stream */
+  sio_error_t err = ctx->offload_waiting.head ? SIO_ERROR_BUSY : context_offload_add(ctx, state);
+  if (err == SIO_ERROR_BUSY) {
+    sio_op_queue_push(&ctx->offload_waiting, state);
+    return SIO_SUCCESS;
+  }
+  return err;
+}
+
+sio_error_t sio_context_offload_cancel(sio_context_t *ctx, sio_op_state_t *state) {
+  if (state->flags & SIO_OP_STATE_OFFLOADED) {
+    return SIO_ERROR_BUSY;
+  }
+
+  sio_op_queue_remove(&ctx->offload_waiting, state);
+  sio_context_complete_status(ctx, state, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Complete the operations the helper threads finished
+*
+* Each of them left room in the helper queue for a waiting operation.
+*/
+static void context_take_offloaded(sio_context_t *ctx) {
+  if (!__atomic_load_n(&ctx->offloaded, __ATOMIC_RELAXED)) {
+    return;
+  }
+
+  sio_op_state_t *st = __atomic_exchange_n(&ctx->offloaded, NULL, __ATOMIC_ACQUIRE);
+  while (st) {
+    sio_op_state_t *next = st->next;
+    st->next = NULL;
+    sio_context_complete(ctx, st, st->offload_res);
+    st = next;
+  }
+
+  while ((st = sio_op_queue_pop(&ctx->offload_waiting)) != NULL) {
+    sio_error_t err = context_offload_add(ctx, st);
+    if (err == SIO_ERROR_BUSY) {
+      /* The next finished operation makes room again */
+      sio_op_queue_push_front(&ctx->offload_waiting, st);
+      break;
+    }
+    if (err != SIO_SUCCESS) {
+      sio_context_complete_status(ctx, st, SIO_OP_ERROR, err, 0);
+    }
+  }
+}
+
+/**
+* @brief Stop the helper threads, dropping the operations they have not started
+*
+* Files opened for operations that will never be dispatched are closed again.
+*/
+static void context_offload_stop(sio_context_t *ctx) {
+  if (!ctx->offload) {
+    return;
+  }
+
+  sio_threadpool_destroy(ctx->offload, 0);
+  free(ctx->offload);
+  ctx->offload = NULL;
+
+  for (sio_op_state_t *st = ctx->offloaded; st; st = st->next) {
+    if (st->op->type == SIO_OP_OPEN && st->offload_res == 0) {
+      sio_stream_close(&((sio_open_request_t*)st->op->buffer)->stream);
+    }
+  }
+  ctx->offloaded = NULL;
+  ctx->offload_waiting.head = ctx->offload_waiting.tail = NULL;
+}
+
+#else
+
+sio_error_t sio_context_offload(sio_context_t *ctx, sio_op_state_t *state) {
+  (void)ctx;
+  (void)state;
+  return SIO_ERROR_UNSUPPORTED;
+}
+
+sio_error_t sio_context_offload_cancel(sio_context_t *ctx, sio_op_state_t *state) {
+  (void)ctx;
+  (void)state;
+  return SIO_ERROR_UNSUPPORTED;
+}
+
+static void context_take_offloaded(sio_context_t *ctx) {
+  (void)ctx;
+}
+
+static void context_offload_stop(sio_context_t *ctx) {
+  (void)ctx;
+}
+
+#endif
+
+/* Public API */
+
+void sio_context_config_init(sio_context_config_t *config) {
+  if (!config) {
+    return;
+  }
+
+  memset(config, 0, sizeof(sio_context_config_t));
+  config->backend = SIO_CONTEXT_AUTO;
+  config->flags = SIO_CTX_NONE;
+  config->max_events = SIO_CONTEXT_DEFAULT_MAX_EVENTS;
+  config->queue_depth = SIO_CONTEXT_DEFAULT_QUEUE_DEPTH;
+}
+
+sio_error_t sio_context_create(sio_context_t **context, const sio_context_config_t *config) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  *context = NULL;
+
+  sio_context_config_t defaults;
+  if (!config) {
+    sio_context_config_init(&defaults);
+    config = &defaults;
+  }
+
+  if (config->backend != SIO_CONTEXT_AUTO) {
+    const sio_context_backend_ops_t *ops = context_backend_ops(config->backend);
+    if (!ops) {
+      return SIO_ERROR_UNSUPPORTED;
+    }
+    return context_create_backend(context, ops, config);
+  }
+
+  /* Automatic selection, best first; a backend that fails to initialize falls through */
+  static const sio_context_backend_t order[] = {
+    SIO_CONTEXT_IO_URING,
+    SIO_CONTEXT_EPOLL,
+    SIO_CONTEXT_POLL
+  };
+
+  sio_error_t err = SIO_ERROR_UNSUPPORTED;
+  for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+    const sio_context_backend_ops_t *ops = context_backend_ops(order[i]);
+    if (!ops || (ops->available && !ops->available())) {
+      continue;
+    }
+
+    err = context_create_backend(context, ops, config);
+    if (err == SIO_SUCCESS) {
+      break;
+    }
+  }
+
+  return err;
+}
+
+sio_error_t sio_context_destroy(sio_context_t *context) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  /* Tear down the helper threads and the backend first so nothing references operation state */
+  context_offload_stop(context);
+  context->ops->destroy(context);
+
+  while (context->inflight) {
+    sio_op_state_t *st = context->inflight;
+    context_inflight_remove(context, st);
+    st->op->status = SIO_OP_CANCELLED;
+    st->op->internal = NULL;
+    context_state_free(context, st);
+  }
+
+  /* Files opened and clients accepted for operations that will never be dispatched are closed again */
+  sio_op_state_t *st;
+  while ((st = context_ready_pop(context)) != NULL) {
+    if (st->op->status == SIO_OP_COMPLETE) {
+      if (st->op->type == SIO_OP_OPEN) {
+        sio_stream_close(&((sio_open_request_t*)st->op->buffer)->stream);
+      } else if (st->op->type == SIO_OP_ACCEPT || st->op->type == SIO_OP_ACCEPT_MULTISHOT) {
+        sio_stream_close(&((sio_accept_result_t*)st->op->buffer)->stream);
+      }
+    }
+    st->op->internal = NULL;
+    context_state_free(context, st);
+  }
+
+  for (size_t i = 0; i < context->entry_capacity; i++) {
+    free(context->entries[i]);
+  }
+  free(context->entries);
+  free(context->fixed_buffers);
+  free(context->ring_lent);
+  free(context->ring_free);
+  sio_slab_destroy(&context->states);
+  free(context->latency);
+  free(context->trace);
+  free(context);
+
+  return SIO_SUCCESS;
+}
+
+sio_context_backend_t sio_context_get_backend(const sio_context_t *context) {
+  return context ? context->ops->type : SIO_CONTEXT_AUTO;
+}
+
+sio_error_t sio_context_register(sio_context_t *context, sio_stream_t *stream, void *user_data) {
+  if (!context || !stream) {
+    return SIO_ERROR_PARAM;
+  }
+
+  int fd = sio_context_stream_fd(stream);
+  if (fd < 0) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  return context_entry_add(context, stream, fd, user_data, NULL);
+}
+
+sio_error_t sio_context_unregister(sio_context_t *context, sio_stream_t *stream) {
+  if (!context || !stream) {
+    return SIO_ERROR_PARAM;
+  }
+
+  int fd = sio_context_stream_fd(stream);
+  sio_context_entry_t *entry = sio_context_entry_get(context, fd);
+  if (!entry) {
+    return SIO_ERROR_NOTFOUND;
+  }
+
+  /* Outstanding operations lose their entry and are cancelled */
+  sio_error_t err = sio_context_cancel_stream(context, stream);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  /* What is left waits for the kernel to confirm the cancellation */
+  while (entry->ops) {
+    sio_op_state_t *st = entry->ops;
+    context_stream_unlink(st);
+    st->entry = NULL;
+  }
+
+  if (context->ops->remove) {
+    context->ops->remove(context, entry);
+  }
+
+  context->entries[fd] = NULL;
+  free(entry);
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Order registered buffers by address
+*/
+static int context_fixed_buffer_cmp(const void *a, const void *b) {
+  uintptr_t x = ((const sio_context_fixed_buffer_t*)a)->base;
+  uintptr_t y = ((const sio_context_fixed_buffer_t*)b)->base;
+  return (x > y) - (x < y);
+}
+
+sio_error_t sio_context_register_buffers(sio_context_t *context, sio_buffer_pool_t *pool) {
+  if (!context || !pool || pool->capacity == 0) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (context->fixed_pool) {
+    return SIO_ERROR_EXISTS;
+  }
+
+  sio_context_fixed_buffer_t *fixed = (sio_context_fixed_buffer_t*)malloc(pool->capacity * sizeof(sio_context_fixed_buffer_t));
+  if (!fixed) {
+    return SIO_ERROR_MEM;
+  }
+
+  for (size_t i = 0; i < pool->capacity; i++) {
+    fixed[i].base = (uintptr_t)pool->buffers[i].data;
+    fixed[i].len = pool->buffers[i].capacity;
+    fixed[i].index = (uint32_t)i;
+  }
+  qsort(fixed, pool->capacity, sizeof(sio_context_fixed_buffer_t), context_fixed_buffer_cmp);
+
+  if (context->ops->register_buffers) {
+    sio_error_t err = context->ops->register_buffers(context, pool);
+    if (err != SIO_SUCCESS) {
+      free(fixed);
+      return err;
+    }
+  }
+
+  context->fixed_pool = pool;
+  context->fixed_buffers = fixed;
+  context->fixed_buffer_count = pool->capacity;
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_unregister_buffers(sio_context_t *context) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (!context->fixed_pool) {
+    return SIO_ERROR_NOTFOUND;
+  }
+
+  /* In-flight operations may still reference registered buffers by index */
+  if (context->pending) {
+    return SIO_ERROR_BUSY;
+  }
+
+  if (context->ops->unregister_buffers) {
+    context->ops->unregister_buffers(context);
+  }
+
+  free(context->fixed_buffers);
+  context->fixed_pool = NULL;
+  context->fixed_buffers = NULL;
+  context->fixed_buffer_count = 0;
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_register_buffer_ring(sio_context_t *context, sio_buffer_pool_t *pool) {
+  if (!context || !pool || pool->capacity == 0 || pool->capacity > 32768) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (context->ring_pool) {
+    return SIO_ERROR_EXISTS;
+  }
+
+  context->ring_lent = (uint8_t*)calloc(pool->capacity, sizeof(uint8_t));
+  context->ring_free = (uint16_t*)malloc(pool->capacity * sizeof(uint16_t));
+  if (!context->ring_lent || !context->ring_free) {
+    free(context->ring_lent);
+    free(context->ring_free);
+    context->ring_lent = NULL;
+    context->ring_free = NULL;
+    return SIO_ERROR_MEM;
+  }
+
+  /* The ring owns every buffer that is free in the pool right now */
+  context->ring_free_count = 0;
+  for (size_t i = 0; i < pool->capacity; i++) {
+    if (pool->used_flags[i]) {
+      context->ring_lent[i] = 1; /* Held by someone else, never provided */
+      continue;
+    }
+    pool->used_flags[i] = 1;
+    pool->size++;
+    context->ring_free[context->ring_free_count++] = (uint16_t)i;
+  }
+  context->ring_pool = pool;
+
+  if (context->ops->register_buffer_ring) {
+    sio_error_t err = context->ops->register_buffer_ring(context, pool);
+    if (err != SIO_SUCCESS) {
+      while (context->ring_free_count) {
+        sio_buffer_pool_release(pool, &pool->buffers[context->ring_free[--context->ring_free_count]]);
+      }
+      free(context->ring_lent);
+      free(context->ring_free);
+      context->ring_lent = NULL;
+      context->ring_free = NULL;
+      context->ring_pool = NULL;
+      return err;
+    }
+  }
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_unregister_buffer_ring(sio_context_t *context) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (!context->ring_pool) {
+    return SIO_ERROR_NOTFOUND;
+  }
+
+  if (context->pending) {
+    return SIO_ERROR_BUSY;
+  }
+
+  if (context->ops->unregister_buffer_ring) {
+    context->ops->unregister_buffer_ring(context);
+  }
+
+  /* Buffers lent out stay acquired until the user releases them to the pool */
+  sio_buffer_pool_t *pool = context->ring_pool;
+  for (size_t i = 0; i < pool->capacity; i++) {
+    if (!context->ring_lent[i]) {
+      sio_buffer_pool_release(pool, &pool->buffers[i]);
+    }
+  }
+
+  free(context->ring_lent);
+  free(context->ring_free);
+  context->ring_lent = NULL;
+  context->ring_free = NULL;
+  context->ring_free_count = 0;
+  context->ring_pool = NULL;
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_release_buffer(sio_context_t *context, int32_t buffer_id) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (!context->ring_pool) {
+    return SIO_ERROR_NOTFOUND;
+  }
+
+  if (buffer_id < 0 || (size_t)buffer_id >= context->ring_pool->capacity || !context->ring_lent[buffer_id]) {
+    return SIO_ERROR_PARAM;
+  }
+
+  context->ring_lent[buffer_id] = 0;
+  sio_buffer_clear(&context->ring_pool->buffers[buffer_id]);
+
+  if (context->ops->recycle_buffer) {
+    context->ops->recycle_buffer(context, (uint16_t)buffer_id);
+  } else {
+    sio_context_ring_put(context, (uint16_t)buffer_id);
+  }
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_op_init(sio_op_t *op, sio_op_type_t type, sio_stream_t *stream, void *buffer, size_t size, void *user_data) {
+  if (!op) {
+    return SIO_ERROR_PARAM;
+  }
+
+  memset(op, 0, sizeof(sio_op_t));
+  op->type = type;
+  op->status = SIO_OP_PENDING;
+  op->stream = stream;
+  op->buffer = buffer;
+  op->size = size;
+  op->user_data = user_data;
+  op->buffer_id = -1;
+
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Map sio_op_t.priority to a priority class index, 0 being the highest
+*/
+static uint32_t context_priority_class(const sio_op_t *op) {
+  if (op->priority > SIO_OP_PRIORITY_NORMAL) {
+    return 0;
+  }
+  return op->priority == SIO_OP_PRIORITY_NORMAL ? 1 : 2;
+}
+
+/**
+* @brief Whether an operation can be part of a linked chain
+*/
+static int context_op_linkable(const sio_op_t *op) {
+  return op->type != SIO_OP_CLOSE && op->type != SIO_OP_CUSTOM && op->type != SIO_OP_TIMER &&
+         op->type != SIO_OP_RECV_MULTISHOT && op->type != SIO_OP_ACCEPT_MULTISHOT &&
+         !(op->type == SIO_OP_WRITE && (op->flags & SIO_OP_FLAG_ZEROCOPY));
+}
+
+/**
+* @brief Validate an operation and track it, without handing it to the backend
+*
+* Close and custom operations complete right away. Other operations are either
+* started with context_start, or held behind the operation they are linked to.
+*
+* @param context Context
+* @param op Operation to queue
+* @param after Operation the new one is linked behind (NULL if none)
+* @param out Receives the new operation state
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t context_queue(sio_context_t *context, sio_op_t *op, sio_op_state_t *after, sio_op_state_t **out) {
+  if (!op) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (op->internal) {
+    return SIO_ERROR_BUSY; /* Already in flight */
+  }
+
+  if (after && !context_op_linkable(op)) {
+    return SIO_ERROR_PARAM;
+  }
+
+  int fd = -1;
+  switch (op->type) {
+    case SIO_OP_READ:
+    case SIO_OP_WRITE:
+      if (!op->stream || (!op->buffer && op->size > 0)) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_READ_AT:
+    case SIO_OP_WRITE_AT:
+    case SIO_OP_READV_AT:
+    case SIO_OP_WRITEV_AT:
+      /* Offsets past INT64_MAX are negative to the kernel, and -1 means the file position to io_uring */
+      if (!op->stream || (!op->buffer && op->size > 0) || op->offset > (uint64_t)INT64_MAX) {
+        return SIO_ERROR_PARAM;
+      }
+      if ((op->type == SIO_OP_READV_AT || op->type == SIO_OP_WRITEV_AT) && op->size > SIO_OP_IOV_MAX) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_OPEN:
+      if (op->stream || !op->buffer || op->size < sizeof(sio_open_request_t) || !((sio_open_request_t*)op->buffer)->path) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_STAT:
+      if (op->stream || !op->buffer || op->size < sizeof(sio_stat_request_t) || !((sio_stat_request_t*)op->buffer)->path) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_UNLINK:
+      if (op->stream || !op->buffer) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_RENAME: {
+      const sio_rename_request_t *req = (const sio_rename_request_t*)op->buffer;
+      if (op->stream || !req || op->size < sizeof(sio_rename_request_t) || !req->old_path || !req->new_path) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+    }
+
+    case SIO_OP_FSYNC:
+    case SIO_OP_FDATASYNC:
+      if (!op->stream) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_SYNC_RANGE:
+      if (!op->stream || op->offset > (uint64_t)INT64_MAX || op->size > (uint64_t)INT64_MAX) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_ACCEPT:
+      if (!op->stream || !op->buffer || op->size < sizeof(sio_accept_result_t)) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_ACCEPT_MULTISHOT:
+      if (!op->stream || !op->buffer || op->size < offsetof(sio_accept_result_t, addr)) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_CONNECT:
+    case SIO_OP_CLOSE:
+      if (!op->stream) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_RECV_MULTISHOT:
+      if (!op->stream || !context->ring_pool) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    case SIO_OP_CUSTOM:
+      break;
+
+    case SIO_OP_TIMER:
+      /* The deadline timer is the wheel slot of the timer itself */
+      if (op->stream || op->timeout_ms || ((op->flags & SIO_OP_FLAG_REPEAT) && !op->size)) {
+        return SIO_ERROR_PARAM;
+      }
+      break;
+
+    default:
+      return SIO_ERROR_PARAM;
+  }
+
+  if (op->stream) {
+    fd = sio_context_stream_fd(op->stream);
+    if (fd < 0 && op->type != SIO_OP_CUSTOM) {
+      return SIO_ERROR_UNSUPPORTED;
+    }
+  }
+
+  /* Close drops the registration first so it cancels every other operation on the stream */
+  if (op->type == SIO_OP_CLOSE) {
+    sio_error_t err = sio_context_unregister(context, op->stream);
+    if (err != SIO_SUCCESS && err != SIO_ERROR_NOTFOUND) {
+      return err;
+    }
+  }
+
+  sio_op_state_t *st = context_state_alloc(context);
+  if (!st) {
+    return SIO_ERROR_MEM;
+  }
+
+  st->op = op;
+  st->fd = fd;
+  st->entry = sio_context_entry_get(context, fd);
+  st->prio = context_priority_class(op);
+
+  op->status = SIO_OP_PENDING;
+  op->error = SIO_SUCCESS;
+  op->result = 0;
+  op->flags &= ~(uint32_t)SIO_OP_FLAG_MORE;
+  op->internal = st;
+  if (op->type == SIO_OP_RECV_MULTISHOT) {
+    op->buffer = NULL;
+    op->buffer_id = -1;
+  }
+
+  context_inflight_add(context, st);
+  context->pending++;
+  context->stats.submitted[op->type]++;
+  if (context->latency) {
+    st->queued_at = context_ticks();
+  }
+  sio_context_trace(context, SIO_TRACE_SUBMIT, op, fd, (int64_t)op->size);
+  *out = st;
+
+  /* Custom operations have no kernel side and complete on the next wait */
+  if (op->type == SIO_OP_CUSTOM) {
+    sio_context_complete_status(context, st, SIO_OP_COMPLETE, SIO_SUCCESS, 0);
+    return SIO_SUCCESS;
+  }
+
+  /* Closing is synchronous on every backend, the descriptor is gone once this returns */
+  if (op->type == SIO_OP_CLOSE) {
+    sio_error_t err = sio_stream_close(op->stream);
+    if (err != SIO_SUCCESS) {
+      sio_context_complete_status(context, st, SIO_OP_ERROR, err, 0);
+    } else {
+      sio_context_complete_status(context, st, SIO_OP_COMPLETE, SIO_SUCCESS, 0);
+    }
+    return SIO_SUCCESS;
+  }
+
+  if (op->type == SIO_OP_TIMER) {
+    context_timer_set(st, context_now_ns() + (uint64_t)op->size * 1000000);
+  }
+
+  /* The deadline runs from submission, also for operations held in a chain */
+  if (op->timeout_ms) {
+    sio_wheel_add(&context->timers, &st->deadline, (context_now_us() + 999) / 1000 + op->timeout_ms);
+  }
+
+  if (after) {
+    after->link = st;
+    st->link_prev = after;
+    st->flags |= SIO_OP_STATE_HELD;
+  }
+
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Hand deferred operations to the backend, highest class first, until it is full again
+*
+* @param context Context
+*/
+static void context_submit_deferred(sio_context_t *context) {
+  size_t before = context->deferred_count;
+
+  for (uint32_t c = 0; c < SIO_CONTEXT_PRIORITY_CLASSES && context->deferred_count; c++) {
+    sio_op_state_t *st;
+    while ((st = sio_op_queue_pop(&context->deferred[c])) != NULL) {
+      st->flags &= ~(uint32_t)SIO_OP_STATE_DEFERRED;
+      context->deferred_count--;
+
+      sio_error_t err = context->ops->submit(context, st);
+      if (err == SIO_ERROR_BUSY) {
+        st->flags |= SIO_OP_STATE_DEFERRED;
+        sio_op_queue_push_front(&context->deferred[c], st);
+        context->deferred_count++;
+        c = SIO_CONTEXT_PRIORITY_CLASSES;
+        break;
+      }
+
+      /* The submission was accepted earlier, so a failure is reported as a completion */
+      if (err != SIO_SUCCESS) {
+        sio_context_complete_status(context, st, SIO_OP_ERROR, err, 0);
+      }
+    }
+  }
+
+  if (context->deferred_count != before && context->ops->flush) {
+    context->ops->flush(context);
+  }
+}
+
+/**
+* @brief Hand a queued operation, and the chain held behind it, to the backend
+*
+* An operation the backend has no room for is deferred, as is every operation
+* while others are deferred, so that room is handed out by priority class.
+*
+* @param context Context
+* @param st State returned by context_queue
+* @return sio_error_t SIO_SUCCESS or error code; on error the chain is dropped
+*/
+static sio_error_t context_start(sio_context_t *context, sio_op_state_t *st) {
+  if (st->flags & SIO_OP_STATE_DONE) {
+    return SIO_SUCCESS;
+  }
+
+  if (context->deferred_count) {
+    context_defer(context, st);
+    context_submit_deferred(context);
+    return SIO_SUCCESS;
+  }
+
+  sio_error_t err = context->ops->submit(context, st);
+  if (err == SIO_ERROR_BUSY) {
+    context_defer(context, st);
+    return SIO_SUCCESS;
+  }
+
+  if (err != SIO_SUCCESS) {
+    while (st) {
+      sio_op_state_t *next = st->link;
+      if (sio_wheel_armed(&st->deadline)) {
+        sio_wheel_remove(&context->timers, &st->deadline);
+      }
+      context_inflight_remove(context, st);
+      context->pending--;
+      st->op->internal = NULL;
+      context_state_free(context, st);
+      st = next;
+    }
+  }
+
+  return err;
+}
+
+/**
+* @brief Queue and start an array of operations, chaining the linked ones
+*
+* @param context Context
+* @param ops Operations
+* @param count Number of operations
+* @return sio_error_t SIO_SUCCESS or the error of the first failing operation
+*/
+static sio_error_t context_queue_batch(sio_context_t *context, sio_op_t **ops, size_t count) {
+  sio_op_state_t *head = NULL;
+  sio_op_state_t *tail = NULL;
+  sio_error_t err = SIO_SUCCESS;
+
+  for (size_t i = 0; i < count; i++) {
+    sio_op_t *op = ops[i];
+    int linked = op && (op->flags & SIO_OP_FLAG_LINK) && i + 1 < count;
+    sio_op_state_t *st;
+
+    if (linked && !context_op_linkable(op)) {
+      err = SIO_ERROR_PARAM;
+      break;
+    }
+
+    err = context_queue(context, op, tail, &st);
+    if (err != SIO_SUCCESS) {
+      break;
+    }
+
+    if (!head) {
+      head = st;
+    }
+    if (linked) {
+      tail = st;
+      continue;
+    }
+
+    err = context_start(context, head);
+    head = tail = NULL;
+    if (err != SIO_SUCCESS) {
+      break;
+    }
+  }
+
+  /* A chain cut short by a failure is started as far as it was queued */
+  if (head) {
+    sio_error_t start_err = context_start(context, head);
+    if (err == SIO_SUCCESS) {
+      err = start_err;
+    }
+  }
+
+  return err;
+}
+
+sio_error_t sio_context_submit(sio_context_t *context, sio_op_t *op) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  sio_op_state_t *st;
+  sio_error_t err = context_queue(context, op, NULL, &st);
+  if (err == SIO_SUCCESS) {
+    err = context_start(context, st);
+  }
+  if (err == SIO_SUCCESS && context->ops->flush) {
+    context->ops->flush(context);
+  }
+
+  return err;
+}
+
+sio_error_t sio_context_submit_batch(sio_context_t *context, sio_op_t **ops, size_t count) {
+  if (!context || (!ops && count > 0)) {
+    return SIO_ERROR_PARAM;
+  }
+
+  sio_error_t err = context_queue_batch(context, ops, count);
+
+  /* Operations queued before a failure stay submitted */
+  if (context->ops->flush) {
+    context->ops->flush(context);
+  }
+
+  return err;
+}
+
+sio_wait_result_t sio_context_submit_and_wait(sio_context_t *context, sio_op_t **ops, size_t count, uint64_t timeout_ms, uint32_t max_events) {
+  if (!context || (!ops && count > 0)) {
+    return SIO_WAIT_ERROR;
+  }
+
+  if (context_queue_batch(context, ops, count) != SIO_SUCCESS) {
+    /* Push what was queued so that no operation is left behind */
+    if (context->ops->flush) {
+      context->ops->flush(context);
+    }
+    return SIO_WAIT_ERROR;
+  }
+
+  /* The backend submits the queued operations as part of waiting */
+  return sio_context_wait(context, timeout_ms, max_events);
+}
+
+/**
+* @brief Cancel an in-flight operation, held and deferred ones never reached the backend
+*/
+static sio_error_t context_cancel_state(sio_context_t *context, sio_op_state_t *st) {
+  sio_context_trace(context, (st->flags & SIO_OP_STATE_EXPIRED) ? SIO_TRACE_TIMEOUT : SIO_TRACE_CANCEL, st->op, st->fd, 0);
+
+  if (st->flags & SIO_OP_STATE_DEFERRED) {
+    sio_op_queue_remove(&context->deferred[st->prio], st);
+    st->flags &= ~(uint32_t)SIO_OP_STATE_DEFERRED;
+    context->deferred_count--;
+    sio_context_complete_status(context, st, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+    return SIO_SUCCESS;
+  }
+
+  if (st->flags & SIO_OP_STATE_HELD) {
+    sio_context_complete_status(context, st, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+    return SIO_SUCCESS;
+  }
+
+  sio_error_t err = context->ops->cancel(context, st);
+  if (err == SIO_SUCCESS && !(st->flags & SIO_OP_STATE_DONE)) {
+    st->flags |= SIO_OP_STATE_CANCELLING;
+  }
+  return err;
+}
+
+/**
+* @brief Cancel every operation whose deadline has passed
+*
+* The cancellation finishes the operation as SIO_OP_TIMEOUT, right away on the
+* readiness backends and with the next completion on io_uring.
+*/
+static void context_expire(sio_context_t *ctx) {
+  if (!ctx->timers.count) {
+    return;
+  }
+
+  sio_wheel_timer_t *timer = sio_wheel_advance(&ctx->timers, context_now_us() / 1000);
+  while (timer) {
+    sio_op_state_t *st = (sio_op_state_t*)((char*)timer - offsetof(sio_op_state_t, deadline));
+    timer = timer->next;
+
+    /* Cancelling a chain may already have finished a later expired member */
+    if (st->flags & SIO_OP_STATE_DONE) {
+      continue;
+    }
+
+    if (st->op->type == SIO_OP_TIMER) {
+      sio_context_timer_expired(ctx, st);
+    } else {
+      st->flags |= SIO_OP_STATE_EXPIRED;
+      context_cancel_state(ctx, st);
+    }
+  }
+}
+
+/**
+* @brief Bound a wait timeout by the nearest deadline
+*
+* @param ctx Context
+* @param timeout_ms Requested timeout in milliseconds or SIO_WAIT_FOREVER
+* @return uint64_t Milliseconds until the timer wheel has work, at most timeout_ms
+*/
+static uint64_t context_timer_bound(const sio_context_t *ctx, uint64_t timeout_ms) {
+  if (!ctx->timers.count) {
+    return timeout_ms;
+  }
+
+  uint64_t next = sio_wheel_next(&ctx->timers);
+  uint64_t now = context_now_us() / 1000;
+  uint64_t bound = next > now ? next - now : 0;
+
+  return bound < timeout_ms ? bound : timeout_ms;
+}
+
+/**
+* @brief Push an operation on the posted queue, safe from any thread
+*
+* @return int Non-zero if the queue was empty, so the owner has to be woken
+*/
+static int context_post_push(sio_context_t *ctx, sio_op_t *op) {
+#if defined(SIO_COMPILER_MSVC)
+  sio_op_t *head;
+  do {
+    head = ctx->posted;
+    op->post_next = head;
+  } while (InterlockedCompareExchangePointer((PVOID volatile*)&ctx->posted, op, head) != head);
+#else
+  sio_op_t *head = __atomic_load_n(&ctx->posted, __ATOMIC_RELAXED);
+  do {
+    op->post_next = head;
+  } while (!__atomic_compare_exchange_n(&ctx->posted, &head, op, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+  return head == NULL;
+}
+
+/**
+* @brief Detach everything posted so far
+*
+* @return sio_op_t* Posted operations, newest first
+*/
+static sio_op_t *context_post_take(sio_context_t *ctx) {
+#if defined(SIO_COMPILER_MSVC)
+  return (sio_op_t*)InterlockedExchangePointer((PVOID volatile*)&ctx->posted, NULL);
+#else
+  if (!__atomic_load_n(&ctx->posted, __ATOMIC_RELAXED)) {
+    return NULL;
+  }
+  return __atomic_exchange_n(&ctx->posted, NULL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/**
+* @brief Move posted operations to the ready lists, in the order they were posted
+*/
+static void context_take_posted(sio_context_t *ctx) {
+  sio_op_t *op = context_post_take(ctx);
+  sio_op_t *fifo = NULL;
+
+  /* Helper threads hand their operations back through the same wakeup */
+  context_take_offloaded(ctx);
+
+  while (op) {
+    sio_op_t *next = op->post_next;
+    op->post_next = fifo;
+    fifo = op;
+    op = next;
+  }
+
+  while (fifo) {
+    op = fifo;
+
+    sio_op_state_t *st = context_state_alloc(ctx);
+    if (!st) {
+      /* Hand the rest back, in order, for the next wait */
+      while (fifo) {
+        op = fifo;
+        fifo = op->post_next;
+        context_post_push(ctx, op);
+      }
+      return;
+    }
+
+    fifo = op->post_next;
+    op->post_next = NULL;
+
+    st->op = op;
+    st->fd = -1;
+    st->prio = context_priority_class(op);
+    op->internal = st;
+    context_inflight_add(ctx, st);
+    ctx->pending++;
+    ctx->stats.submitted[op->type]++;
+    if (ctx->latency) {
+      st->queued_at = context_ticks();
+    }
+    sio_context_trace(ctx, SIO_TRACE_SUBMIT, op, -1, (int64_t)op->size);
+
+    sio_context_complete_status(ctx, st, op->status == SIO_OP_PENDING ? SIO_OP_COMPLETE : op->status, op->error, op->result);
+  }
+}
+
+/**
+* @brief Busy-poll the backend before a blocking wait
+*
+* Adapts the budget to the traffic: a spin that found nothing halves it (down
+* to 1/16 of the configured budget), a successful one doubles it again.
+*
+* @param ctx Context
+* @param max_events Maximum number of events to reap
+* @param timeout_ms Wait timeout, reduced by the time spent spinning
+* @return sio_wait_result_t SIO_WAIT_COMPLETED if completions arrived, SIO_WAIT_TIMEOUT
+*         if the wait has to block, or a backend error
+*/
+static sio_wait_result_t context_spin(sio_context_t *ctx, uint32_t max_events, uint64_t *timeout_ms) {
+  uint64_t budget = ctx->spin_budget;
+  if (*timeout_ms != SIO_WAIT_FOREVER && budget > *timeout_ms * 1000) {
+    budget = *timeout_ms * 1000;
+  }
+
+  size_t notified = ctx->notified;
+  uint64_t start = context_now_us();
+  uint64_t elapsed;
+
+  do {
+    sio_wait_result_t res = ctx->ops->poll(ctx, 0, max_events);
+    if (res == SIO_WAIT_ERROR || res == SIO_WAIT_INTERRUPTED) {
+      return res;
+    }
+
+    if (ctx->ready_count || ctx->notified != notified || ctx->woken) {
+      uint32_t grown = ctx->spin_budget * 2;
+      ctx->spin_budget = grown < ctx->spin_us ? grown : ctx->spin_us;
+      return SIO_WAIT_COMPLETED;
+    }
+
+    elapsed = context_now_us() - start;
+  } while (elapsed < budget);
+
+  uint32_t floor = ctx->spin_us / 16 ? ctx->spin_us / 16 : 1;
+  ctx->spin_budget = ctx->spin_budget / 2 > floor ? ctx->spin_budget / 2 : floor;
+
+  if (*timeout_ms != SIO_WAIT_FOREVER) {
+    uint64_t spent_ms = elapsed / 1000;
+    *timeout_ms = spent_ms < *timeout_ms ? *timeout_ms - spent_ms : 0;
+  }
+  return SIO_WAIT_TIMEOUT;
+}
+
+/**
+* @brief Wait for completions and dispatch them
+*
+* @param context Context
+* @param timeout_ms Timeout in milliseconds or SIO_WAIT_FOREVER
+* @param max_events Maximum number of completions to dispatch
+* @param out Receives the operations instead of the completion callback (NULL to call it)
+* @param count Receives the number of completions dispatched
+* @return sio_wait_result_t Wait result
+*/
+static sio_wait_result_t context_wait(sio_context_t *context, uint64_t timeout_ms, uint32_t max_events, sio_op_t **out, uint32_t *count) {
+  size_t notified = context->notified;
+  uint64_t end = timeout_ms == SIO_WAIT_FOREVER ? SIO_WAIT_FOREVER : context_now_us() / 1000 + timeout_ms;
+  int spun = 0;
+
+  for (;;) {
+    sio_wait_result_t result = SIO_WAIT_TIMEOUT;
+    int bounded = 0;
+
+    if (context->deferred_count) {
+      context_submit_deferred(context);
+    }
+    context_take_posted(context);
+
+    /* Completions already on the ready list, or a wakeup, make this a non-blocking poll */
+    if (context->ready_count < max_events) {
+      uint64_t poll_timeout = context->ready_count || context->woken ? 0 : timeout_ms;
+      uint32_t room = max_events - (uint32_t)context->ready_count;
+
+      /* Sleep no longer than the nearest deadline */
+      uint64_t bound = context_timer_bound(context, poll_timeout);
+      bounded = bound < poll_timeout;
+      poll_timeout = bound;
+
+      if (poll_timeout && context->spin_us && !spun) {
+        spun = 1;
+        result = context_spin(context, room, &poll_timeout);
+      }
+      if (result == SIO_WAIT_TIMEOUT) {
+        if (poll_timeout) {
+          uint64_t start = context_now_ns();
+          result = context->ops->poll(context, poll_timeout, room);
+          context->stats.wait_ns += context_now_ns() - start;
+        } else {
+          result = context->ops->poll(context, 0, room);
+        }
+      }
+    }
+
+    /* Reaping made room for operations the backend had to turn away */
+    if (context->deferred_count) {
+      context_submit_deferred(context);
+    }
+
+    context_take_posted(context);
+    context_expire(context);
+
+    *count = context_dispatch(context, max_events, out);
+    if (*count > 0 || context->notified != notified) {
+      context->woken = 0;
+      return SIO_WAIT_COMPLETED;
+    }
+
+    if (context->woken) {
+      context->woken = 0;
+      return SIO_WAIT_INTERRUPTED;
+    }
+
+    if (result == SIO_WAIT_ERROR || result == SIO_WAIT_INTERRUPTED) {
+      return result;
+    }
+
+    /* Woken for a deadline without anything to report yet, sleep for the rest of the timeout */
+    if (!bounded) {
+      return SIO_WAIT_TIMEOUT;
+    }
+    if (end != SIO_WAIT_FOREVER) {
+      uint64_t now = context_now_us() / 1000;
+      if (now >= end) {
+        return SIO_WAIT_TIMEOUT;
+      }
+      timeout_ms = end - now;
+    }
+  }
+}
+
+sio_wait_result_t sio_context_wait(sio_context_t *context, uint64_t timeout_ms, uint32_t max_events) {
+  if (!context) {
+    return SIO_WAIT_ERROR;
+  }
+
+  if (max_events == 0) {
+    max_events = context->max_events;
+  }
+
+  uint32_t count;
+  return context_wait(context, timeout_ms, max_events, NULL, &count);
+}
+
+sio_wait_result_t sio_context_reap(sio_context_t *context, sio_op_t **ops, uint32_t count, uint32_t *reaped, uint64_t timeout_ms) {
+  if (reaped) {
+    *reaped = 0;
+  }
+  if (!context || !ops || !count || !reaped) {
+    return SIO_WAIT_ERROR;
+  }
+
+  return context_wait(context, timeout_ms, count, ops, reaped);
+}
+
+uint32_t sio_context_peek(sio_context_t *context, sio_op_t **ops, uint32_t count) {
+  if (!context || !ops) {
+    return 0;
+  }
+
+  /* Only what is already visible: posted operations, the ready lists and, on io_uring, the mapped CQ ring */
+  context_take_posted(context);
+  if (context->ready_count < count && context->ops->peek) {
+    context->ops->peek(context, count - (uint32_t)context->ready_count);
+  }
+
+  return context_dispatch(context, count, ops);
+}
+
+sio_error_t sio_context_post(sio_context_t *context, sio_op_t *op) {
+  if (!context || !op || (unsigned)op->type >= SIO_OP_TYPE_COUNT) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (!(context->flags & SIO_CTX_THREAD_SAFE) || !context->ops->wakeup) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  if (op->internal) {
+    return SIO_ERROR_BUSY; /* Already in flight */
+  }
+
+  /* Only the first post of a burst has to wake the owner, the rest ride along */
+  if (context_post_push(context, op)) {
+    return context->ops->wakeup(context);
+  }
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_wakeup(sio_context_t *context) {
+  if (!context) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (!(context->flags & SIO_CTX_THREAD_SAFE) || !context->ops->wakeup) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  return context->ops->wakeup(context);
+}
+
+sio_error_t sio_context_cancel(sio_context_t *context, sio_op_t *op) {
+  if (!context || !op) {
+    return SIO_ERROR_PARAM;
+  }
+
+  sio_op_state_t *st = (sio_op_state_t*)op->internal;
+  if (!st) {
+    return SIO_ERROR_NOTFOUND;
+  }
+
+  /* Already complete, the result will be dispatched as is */
+  if (st->flags & SIO_OP_STATE_DONE) {
+    return SIO_SUCCESS;
+  }
+
+  return context_cancel_state(context, st);
+}
+
+/**
+* @brief Cancel the operations of a list that the backend does not own yet
+*
+* Held and deferred operations finish right away. Cancelling a chain member can
+* finish other members of the list, so the walk restarts whenever the next
+* state was completed behind its back.
+*
+* @param ctx Context
+* @param head Pointer to the list head
+* @param unlisted Walk the in-flight list for unlisted states of stream instead
+* @param stream Stream the unlisted states have to target
+* @param own Whether to cancel only held and deferred states
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t context_cancel_list(sio_context_t *ctx, sio_op_state_t **head, int unlisted, const sio_stream_t *stream, int own) {
+  sio_op_state_t *st = *head;
+
+  while (st) {
+    sio_op_state_t *next = unlisted ? st->all_next : st->stream_next;
+    int match = unlisted ? (st->flags & SIO_OP_STATE_UNLISTED) && st->op->stream == stream : 1;
+
+    if (own) {
+      match = match && (st->flags & (SIO_OP_STATE_HELD | SIO_OP_STATE_DEFERRED));
+    }
+
+    /* Operations on the helper threads finish on their own */
+    if (match && !(st->flags & (SIO_OP_STATE_CANCELLING | SIO_OP_STATE_OFFLOADED))) {
+      sio_error_t err = context_cancel_state(ctx, st);
+      if (err != SIO_SUCCESS) {
+        return err;
+      }
+
+      if (next && (next->flags & SIO_OP_STATE_DONE)) {
+        next = *head;
+      }
+    }
+    st = next;
+  }
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_cancel_stream(sio_context_t *context, sio_stream_t *stream) {
+  if (!context || !stream) {
+    return SIO_ERROR_PARAM;
+  }
+
+  sio_error_t err;
+
+  /* Only operations on streams that were never registered need the context-wide list */
+  if (context->unlisted) {
+    err = context_cancel_list(context, &context->inflight, 1, stream, 0);
+    if (err != SIO_SUCCESS) {
+      return err;
+    }
+  }
+
+  sio_context_entry_t *entry = sio_context_entry_get(context, sio_context_stream_fd(stream));
+  if (!entry || !entry->ops) {
+    return SIO_SUCCESS;
+  }
+
+  if (context->ops->cancel_stream) {
+    err = context_cancel_list(context, &entry->ops, 0, stream, 1);
+    if (err != SIO_SUCCESS) {
+      return err;
+    }
+
+    int issued = 0;
+    for (sio_op_state_t *st = entry->ops; st; st = st->stream_next) {
+      if (!(st->flags & SIO_OP_STATE_CANCELLING)) {
+        issued = 1;
+        break;
+      }
+    }
+    if (!issued) {
+      return SIO_SUCCESS;
+    }
+
+    err = context->ops->cancel_stream(context, entry);
+    if (err == SIO_SUCCESS) {
+      for (sio_op_state_t *st = entry->ops; st; st = st->stream_next) {
+        st->flags |= SIO_OP_STATE_CANCELLING;
+      }
+      return SIO_SUCCESS;
+    }
+    if (err != SIO_ERROR_UNSUPPORTED) {
+      return err;
+    }
+  }
+
+  return context_cancel_list(context, &entry->ops, 0, stream, 0);
+}
+
+int sio_context_has_pending(const sio_context_t *context) {
+  return context ? context->pending != 0 : 0;
+}
+
+size_t sio_context_pending_count(const sio_context_t *context) {
+  return context ? context->pending : 0;
+}
+
+sio_error_t sio_context_get_stats(const sio_context_t *context, sio_context_stats_t *stats) {
+  if (!context || !stats) {
+    return SIO_ERROR_PARAM;
+  }
+
+  *stats = context->stats;
+  stats->state_hits = context->states.hits;
+  stats->state_misses = context->states.misses;
+  stats->state_capacity = context->states.capacity;
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_get_latency(const sio_context_t *context, sio_op_type_t type, sio_hist_t *hist) {
+  if (!context || !hist || (int)type < 0 || (int)type >= SIO_OP_TYPE_COUNT) {
+    return SIO_ERROR_PARAM;
+  }
+  if (!context->latency) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  *hist = context->latency[type];
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Copy events out of the trace ring with their times in nanoseconds
+*
+* @param ctx Context with a trace ring
+* @param first Sequence number of the first event to copy
+* @param events Receives the events
+* @param count Number of events to copy
+*/
+static void context_trace_read(const sio_context_t *ctx, uint64_t first, sio_trace_event_t *events, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    events[i] = ctx->trace[(first + i) & ctx->trace_mask];
+    events[i].time = context_ticks_to_ns(events[i].time);
+  }
+}
+
+/**
+* @brief Get the sequence number of the oldest event still in the trace ring
+*/
+static uint64_t context_trace_oldest(const sio_context_t *ctx) {
+  return ctx->trace_head > ctx->trace_mask ? ctx->trace_head - ctx->trace_mask - 1 : 0;
+}
+
+sio_error_t sio_context_trace_copy(const sio_context_t *context, sio_trace_event_t *events, size_t max, size_t *count) {
+  if (!context || (!events && max) || !count) {
+    return SIO_ERROR_PARAM;
+  }
+  if (!context->trace) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  uint64_t first = context_trace_oldest(context);
+  if (context->trace_head - first > max) {
+    first = context->trace_head - max;
+  }
+
+  *count = (size_t)(context->trace_head - first);
+  context_trace_read(context, first, events, *count);
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Write a whole buffer to a stream, resuming partial writes
+*/
+static sio_error_t context_write_all(sio_stream_t *stream, const void *data, size_t size) {
+  const char *p = (const char*)data;
+
+  while (size) {
+    size_t written = 0;
+    sio_error_t err = sio_stream_write(stream, p, size, &written, SIO_DOALL);
+    if (err != SIO_SUCCESS) {
+      return err;
+    }
+    if (!written) {
+      return SIO_ERROR_IO;
+    }
+    p += written;
+    size -= written;
+  }
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_trace_dump(const sio_context_t *context, sio_stream_t *stream) {
+  if (!context || !stream) {
+    return SIO_ERROR_PARAM;
+  }
+  if (!context->trace) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  uint64_t first = context_trace_oldest(context);
+
+  sio_trace_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SIO_TRACE_MAGIC, sizeof(header.magic));
+  header.version = SIO_TRACE_VERSION;
+  header.event_size = sizeof(sio_trace_event_t);
+  header.count = context->trace_head - first;
+  header.dropped = first;
+
+  sio_error_t err = context_write_all(stream, &header, sizeof(header));
+
+  /* Converted in chunks, the ring itself keeps raw clock ticks */
+  sio_trace_event_t chunk[64];
+  while (err == SIO_SUCCESS && first < context->trace_head) {
+    uint64_t left = context->trace_head - first;
+    size_t n = left < 64 ? (size_t)left : 64;
+    context_trace_read(context, first, chunk, n);
+    err = context_write_all(stream, chunk, n * sizeof(sio_trace_event_t));
+    first += n;
+  }
+
+  return err;
+}
+
+sio_error_t sio_context_backend_config(sio_context_t *context, sio_context_backend_t backend, const void *config, size_t config_size) {
+  if (!context || !config) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (backend != context->ops->type) {
+    return SIO_ERROR_PARAM;
+  }
+
+  if (!context->ops->configure) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  return context->ops->configure(context, config, config_size);
+}
+
+int sio_context_backend_available(sio_context_backend_t backend) {
+  if (backend == SIO_CONTEXT_AUTO) {
+    return 1;
+  }
+
+  const sio_context_backend_ops_t *ops = context_backend_ops(backend);
+  if (!ops) {
+    return 0;
+  }
+
+  return ops->available ? ops->available() : 1;
+}
+
+const char *sio_context_backend_name(sio_context_backend_t backend) {
+  switch (backend) {
+    case SIO_CONTEXT_AUTO:
+      return "auto";
+    case SIO_CONTEXT_IO_URING:
+      return "io_uring";
+    case SIO_CONTEXT_EPOLL:
+      return "epoll";
+    case SIO_CONTEXT_KQUEUE:
+      return "kqueue";
+    case SIO_CONTEXT_IOCP:
+      return "iocp";
+    case SIO_CONTEXT_POLL:
+      return "poll";
+    case SIO_CONTEXT_SELECT:
+      return "select";
+    default:
+      return "unknown";
+  }
+}
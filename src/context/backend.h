@@ -0,0 +1,514 @@
+/**
+* @file src/context/backend.h
+* @brief Internal interface between the generic context layer and its backends
+*
+* The generic layer (src/context.c) owns operation bookkeeping: the registered
+* stream table with a list of outstanding operations per stream, the in-flight
+* operation list and the ready list that completions are dispatched from. Each
+* backend (epoll, io_uring, ...) implements the sio_context_backend_ops_t vtable
+* and embeds sio_context_t as the first member of its own context structure.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#ifndef SIO_CONTEXT_BACKEND_H
+#define SIO_CONTEXT_BACKEND_H
+
+#include <sio/context.h>
+#include <src/context/wheel.h>
+#include <src/context/slab.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Priority classes of sio_op_t.priority: 0 is SIO_OP_PRIORITY_HIGH */
+#define SIO_CONTEXT_PRIORITY_CLASSES 3
+
+/* Helper threads running blocking operations for backends without kernel support */
+#define SIO_CONTEXT_OFFLOAD_THREADS 4
+
+typedef struct sio_op_state sio_op_state_t;
+typedef struct sio_context_entry sio_context_entry_t;
+
+/**
+* @brief Intrusive FIFO of operation states
+*/
+typedef struct sio_op_queue {
+  sio_op_state_t *head;      /**< First state in the queue */
+  sio_op_state_t *tail;      /**< Last state in the queue */
+} sio_op_queue_t;
+
+/**
+* @brief Operation state flags
+*/
+enum sio_op_state_flags {
+  SIO_OP_STATE_STARTED  = (1 << 0),   /**< Backend has started the operation (e.g. connect issued) */
+  SIO_OP_STATE_QUEUED   = (1 << 1),   /**< State is linked into a backend queue */
+  SIO_OP_STATE_DONE     = (1 << 2),   /**< State is on the ready list awaiting dispatch */
+  SIO_OP_STATE_POLLED   = (1 << 3),   /**< Backend waits for readiness instead of doing the I/O */
+  SIO_OP_STATE_HELD     = (1 << 4),   /**< Linked behind another operation and not issued yet */
+  SIO_OP_STATE_EXPIRED  = (1 << 5),   /**< Deadline passed, a cancellation finishes as SIO_OP_TIMEOUT */
+  SIO_OP_STATE_DEFERRED = (1 << 6),   /**< Backend was full, waiting on the context's deferred queue */
+  SIO_OP_STATE_UNLISTED = (1 << 7),   /**< Targets a stream that was not registered, so on no stream list */
+  SIO_OP_STATE_CANCELLING = (1 << 8), /**< Cancellation requested, the completion is still to come */
+  SIO_OP_STATE_ZEROCOPY = (1 << 9),   /**< Sent without copying, the final completion waits for the buffer release */
+  SIO_OP_STATE_OFFLOADED = (1 << 10)  /**< A helper thread owns the blocking operation and finishes it on its own */
+};
+
+/**
+* @brief Internal per-operation state, referenced by sio_op_t.internal
+*/
+struct sio_op_state {
+  sio_op_t *op;                  /**< Owning operation */
+  sio_context_entry_t *entry;    /**< Registered stream entry (NULL if not registered) */
+  int fd;                        /**< Native descriptor the operation targets */
+  uint32_t flags;                /**< SIO_OP_STATE_* flags */
+  uint32_t prio;                 /**< Priority class index, 0 is the highest */
+  sio_op_state_t *next;          /**< Backend queue / ready list / deferred queue linkage */
+  sio_op_state_t *prev;          /**< Backend queue / ready list / deferred queue linkage */
+  sio_op_state_t *all_next;      /**< Context-wide in-flight list linkage */
+  sio_op_state_t *all_prev;      /**< Context-wide in-flight list linkage */
+  sio_op_state_t *stream_next;   /**< Linkage in the outstanding list of the entry */
+  sio_op_state_t *stream_prev;   /**< Linkage in the outstanding list of the entry */
+  sio_op_state_t *link;          /**< Next operation of a linked chain (NULL if none) */
+  sio_op_state_t *link_prev;     /**< Previous operation of a linked chain (NULL if none) */
+  sio_wheel_timer_t deadline;    /**< Deadline timer, armed when op->timeout_ms is set */
+  uint64_t queued_at;            /**< Latency clock at submission (SIO_CTX_LATENCY only) */
+  union {
+    struct {
+      uint64_t timer_expires;    /**< SIO_OP_TIMER: next expiry in nanoseconds of the monotonic clock */
+      int64_t timer_ts[2];       /**< SIO_OP_TIMER: timer_expires as seconds and nanoseconds, for a kernel timespec */
+    };
+    struct {
+      sio_context_t *offload_ctx; /**< Offloaded operation: context it completes on */
+      int64_t offload_res;       /**< Offloaded operation: result in kernel convention */
+    };
+    struct {
+      int64_t zerocopy_res;      /**< Zero-copy write: result of the send, reported again on release */
+      uint32_t zerocopy_id;      /**< Zero-copy write: MSG_ZEROCOPY sequence number of the send */
+    };
+  };
+};
+
+/**
+* @brief Readiness bits tracked per registered stream
+*/
+enum sio_context_ready {
+  SIO_READY_IN     = (1 << 0),   /**< Input side is ready (no EAGAIN seen since last edge) */
+  SIO_READY_OUT    = (1 << 1),   /**< Output side is ready (no EAGAIN seen since last edge) */
+  SIO_READY_ALWAYS = (1 << 2),   /**< Descriptor cannot be polled and is always ready (regular files) */
+  SIO_READY_ERR    = (1 << 3)    /**< Error reported since the last drain, the error queue may hold zero-copy releases */
+};
+
+/**
+* @brief Registered stream entry, indexed by native descriptor
+*/
+struct sio_context_entry {
+  sio_stream_t *stream;          /**< Registered stream */
+  void *user_data;               /**< User data passed to sio_context_register */
+  int fd;                        /**< Native descriptor */
+  int slot;                      /**< Backend file slot (io_uring fixed file index), -1 if none */
+  uint32_t ready;                /**< SIO_READY_* bits */
+  sio_op_queue_t in;             /**< Pending input-side operations (read, accept) */
+  sio_op_queue_t out;            /**< Pending output-side operations (write, connect) */
+  sio_op_state_t *ops;           /**< Every outstanding operation on the stream, in any state */
+  sio_op_queue_t zerocopy;       /**< Zero-copy sends waiting for their buffer release (MSG_ZEROCOPY) */
+  uint32_t zerocopy_next;        /**< MSG_ZEROCOPY sequence number of the next zero-copy send */
+  int zerocopy_mode;             /**< SO_ZEROCOPY probe: 0 not tried, 1 enabled, -1 not supported */
+  sio_context_entry_t *dirty_next; /**< Linkage for entries with runnable queued operations */
+  int dirty;                     /**< Whether the entry is on the dirty list */
+};
+
+/**
+* @brief Registered pool buffer, kept sorted by address for lookups
+*/
+typedef struct sio_context_fixed_buffer {
+  uintptr_t base;                /**< Start of the buffer memory */
+  size_t len;                    /**< Length of the buffer memory */
+  uint32_t index;                /**< Index in the registered pool */
+} sio_context_fixed_buffer_t;
+
+/**
+* @brief Backend operations vtable
+*/
+typedef struct sio_context_backend_ops {
+  sio_context_backend_t type;    /**< Backend identifier */
+  size_t context_size;           /**< Size of the backend context structure */
+
+  /* Optional runtime probe - NULL if always available when compiled in */
+  int (*available)(void);
+
+  sio_error_t (*init)(sio_context_t *ctx, const sio_context_config_t *config);
+  void (*destroy)(sio_context_t *ctx);
+
+  sio_error_t (*add)(sio_context_t *ctx, sio_context_entry_t *entry);
+  sio_error_t (*remove)(sio_context_t *ctx, sio_context_entry_t *entry);
+
+  /*
+  * Queue an operation; the kernel transition is deferred to flush or poll.
+  * Operations chained behind it (state->link) are SIO_OP_STATE_HELD: a backend
+  * may issue the whole chain and clear the flag, otherwise the generic layer
+  * submits each one once its predecessor succeeded.
+  */
+  sio_error_t (*submit)(sio_context_t *ctx, sio_op_state_t *state);
+  /* Push everything queued since the last flush in one pass */
+  void (*flush)(sio_context_t *ctx);
+  sio_error_t (*cancel)(sio_context_t *ctx, sio_op_state_t *state);
+  /*
+  * Optional - cancel everything the backend issued on a stream with one request.
+  * NULL or SIO_ERROR_UNSUPPORTED makes the generic layer cancel entry->ops one by one.
+  */
+  sio_error_t (*cancel_stream)(sio_context_t *ctx, sio_context_entry_t *entry);
+
+  /* Reap completions into the ready list; returns SIO_WAIT_* without dispatching */
+  sio_wait_result_t (*poll)(sio_context_t *ctx, uint64_t timeout_ms, uint32_t max_events);
+  /* Optional - move completions already visible in user space to the ready list without a syscall */
+  uint32_t (*peek)(sio_context_t *ctx, uint32_t max_events);
+  /* Interrupt a poll from another thread; called for SIO_CTX_THREAD_SAFE contexts and by offload threads */
+  sio_error_t (*wakeup)(sio_context_t *ctx);
+
+  /* Optional - can be NULL if not implemented */
+  sio_error_t (*configure)(sio_context_t *ctx, const void *config, size_t config_size);
+  sio_error_t (*register_buffers)(sio_context_t *ctx, const sio_buffer_pool_t *pool);
+  void (*unregister_buffers)(sio_context_t *ctx);
+
+  /* Optional kernel buffer ring - if NULL the generic free list is used */
+  sio_error_t (*register_buffer_ring)(sio_context_t *ctx, const sio_buffer_pool_t *pool);
+  void (*unregister_buffer_ring)(sio_context_t *ctx);
+  void (*recycle_buffer)(sio_context_t *ctx, uint16_t buffer_id);
+} sio_context_backend_ops_t;
+
+/**
+* @brief Generic context structure, embedded first in every backend context
+*/
+struct sio_context {
+  const sio_context_backend_ops_t *ops; /**< Backend vtable */
+  uint32_t flags;                /**< SIO_CTX_* flags */
+  uint32_t max_events;           /**< Maximum events reaped per wait */
+  uint32_t queue_depth;          /**< Queue depth hint */
+  sio_completion_fn completion_fn; /**< Completion callback */
+  void *user_data;               /**< User data for the completion callback */
+
+  uint32_t spin_us;              /**< Configured busy-poll budget in microseconds */
+  uint32_t spin_budget;          /**< Current adaptive busy-poll budget in microseconds */
+
+  size_t pending;                /**< Submitted operations not yet dispatched */
+  size_t unlisted;               /**< In-flight operations with SIO_OP_STATE_UNLISTED */
+  sio_op_state_t *inflight;      /**< Operations owned by the backend */
+  sio_op_queue_t ready[SIO_CONTEXT_PRIORITY_CLASSES]; /**< Completed operations awaiting dispatch, per class */
+  uint32_t ready_skipped[SIO_CONTEXT_PRIORITY_CLASSES]; /**< Dispatches a waiting class was passed over */
+  size_t ready_count;            /**< Number of states on the ready lists */
+  sio_op_queue_t deferred[SIO_CONTEXT_PRIORITY_CLASSES]; /**< Operations the backend had no room for, per class */
+  size_t deferred_count;         /**< Number of deferred states */
+
+  sio_context_entry_t **entries; /**< Registered streams indexed by descriptor */
+  size_t entry_capacity;         /**< Size of the entries table */
+
+  sio_buffer_pool_t *fixed_pool; /**< Registered buffer pool (NULL if none) */
+  sio_context_fixed_buffer_t *fixed_buffers; /**< Pool buffers sorted by address */
+  size_t fixed_buffer_count;     /**< Number of registered pool buffers */
+
+  sio_buffer_pool_t *ring_pool;  /**< Pool feeding the provided buffer ring (NULL if none) */
+  uint8_t *ring_lent;            /**< Per pool buffer: lent to the user by a completion */
+  uint16_t *ring_free;           /**< Provided buffers available (backends without a kernel ring) */
+  uint32_t ring_free_count;      /**< Number of entries in ring_free */
+  size_t notified;               /**< Multishot completions delivered in place */
+
+  sio_wheel_t timers;            /**< Operation deadlines, in milliseconds of the monotonic clock */
+  sio_slab_t states;             /**< Cache of operation states, sized from queue_depth */
+  sio_context_stats_t stats;     /**< Counters behind sio_context_get_stats (the state_* fields come from states) */
+  sio_hist_t *latency;           /**< Latency per operation type, SIO_OP_TYPE_COUNT histograms (NULL without SIO_CTX_LATENCY) */
+  sio_trace_event_t *trace;      /**< Trace ring, times in latency clock ticks (NULL without SIO_CTX_TRACE) */
+  uint64_t trace_head;           /**< Events ever recorded, the next goes to trace[trace_head & trace_mask] */
+  uint64_t trace_mask;           /**< Trace ring entries - 1 */
+
+  sio_op_t *posted;              /**< Operations posted by other threads, newest first (atomic) */
+  struct sio_threadpool *offload; /**< Helper threads for blocking operations, started on first use (NULL before) */
+  sio_op_state_t *offloaded;     /**< Operations the helper threads finished, newest first, linked by next (atomic) */
+  sio_op_queue_t offload_waiting; /**< Blocking operations waiting for room in the helper queue */
+  int woken;                     /**< A wakeup was consumed by the backend and not yet reported */
+};
+
+/* Backends */
+#if defined(SIO_OS_LINUX)
+extern const sio_context_backend_ops_t sio_context_io_uring_ops;
+extern const sio_context_backend_ops_t sio_context_epoll_ops;
+#endif
+#if defined(SIO_OS_POSIX)
+extern const sio_context_backend_ops_t sio_context_poll_ops;
+extern const sio_context_backend_ops_t sio_context_select_ops;
+#endif
+
+/* Queue helpers */
+
+static SIO_INLINE void sio_op_queue_push(sio_op_queue_t *q, sio_op_state_t *st) {
+  st->next = NULL;
+  st->prev = q->tail;
+  if (q->tail) {
+    q->tail->next = st;
+  } else {
+    q->head = st;
+  }
+  q->tail = st;
+}
+
+static SIO_INLINE void sio_op_queue_push_front(sio_op_queue_t *q, sio_op_state_t *st) {
+  st->prev = NULL;
+  st->next = q->head;
+  if (q->head) {
+    q->head->prev = st;
+  } else {
+    q->tail = st;
+  }
+  q->head = st;
+}
+
+static SIO_INLINE void sio_op_queue_remove(sio_op_queue_t *q, sio_op_state_t *st) {
+  if (st->prev) {
+    st->prev->next = st->next;
+  } else {
+    q->head = st->next;
+  }
+  if (st->next) {
+    st->next->prev = st->prev;
+  } else {
+    q->tail = st->prev;
+  }
+  st->next = st->prev = NULL;
+}
+
+static SIO_INLINE sio_op_state_t *sio_op_queue_pop(sio_op_queue_t *q) {
+  sio_op_state_t *st = q->head;
+  if (st) {
+    sio_op_queue_remove(q, st);
+  }
+  return st;
+}
+
+/* Generic layer services for backends */
+
+/**
+* @brief Get the native descriptor of a stream
+*
+* @param stream Stream to query
+* @return int Descriptor, or -1 if the stream type has none
+*/
+int sio_context_stream_fd(const sio_stream_t *stream);
+
+/**
+* @brief Look up the registered entry for a descriptor
+*
+* @param ctx Context
+* @param fd Native descriptor
+* @return sio_context_entry_t* Entry or NULL if not registered
+*/
+sio_context_entry_t *sio_context_entry_get(sio_context_t *ctx, int fd);
+
+/**
+* @brief Find the registered pool buffer that contains a memory range
+*
+* @param ctx Context
+* @param addr Start of the range
+* @param len Length of the range
+* @return int Pool index of the buffer, or -1 if the range is not in a registered buffer
+*/
+int sio_context_fixed_buffer_find(const sio_context_t *ctx, const void *addr, size_t len);
+
+/**
+* @brief Make sure the stream of an operation is registered, registering it implicitly
+*
+* On success state->entry points to the registered entry.
+*
+* @param ctx Context
+* @param state Operation state
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+sio_error_t sio_context_entry_ensure(sio_context_t *ctx, sio_op_state_t *state);
+
+/**
+* @brief Finish an operation and move it to the ready list
+*
+* @param ctx Context
+* @param state Operation state
+* @param res Result in kernel convention (>= 0 bytes/value, < 0 negated errno)
+*/
+void sio_context_complete(sio_context_t *ctx, sio_op_state_t *state, int64_t res);
+
+/**
+* @brief Finish an operation with an explicit status and move it to the ready list
+*
+* @param ctx Context
+* @param state Operation state
+* @param status Final operation status
+* @param error Error code for SIO_OP_ERROR
+* @param result Bytes transferred or operation-specific result
+*/
+void sio_context_complete_status(sio_context_t *ctx, sio_op_state_t *state, sio_op_status_t status, sio_error_t error, size_t result);
+
+/**
+* @brief Arm a timer operation in the context's timer wheel
+*
+* For backends without kernel timers: the wheel fires it at state->timer_expires
+* and the wait calls sio_context_timer_expired.
+*
+* @param ctx Context
+* @param state SIO_OP_TIMER state
+*/
+void sio_context_timer_arm(sio_context_t *ctx, sio_op_state_t *state);
+
+/**
+* @brief Report the expiry of a timer operation
+*
+* Completes a one-shot timer. A periodic one is moved to its next expiry,
+* handed to the backend again and delivered like a multishot completion, unless
+* a cancel is on its way, which finishes it as SIO_OP_CANCELLED instead.
+*
+* @param ctx Context
+* @param state SIO_OP_TIMER state
+*/
+void sio_context_timer_expired(sio_context_t *ctx, sio_op_state_t *state);
+
+/**
+* @brief Whether an operation blocks in the kernel with no readiness to wait for
+*
+* Backends that cannot issue these asynchronously hand them to sio_context_offload.
+*/
+static SIO_INLINE int sio_context_op_blocks(const sio_op_t *op) {
+  return op->type >= SIO_OP_FSYNC && op->type <= SIO_OP_RENAME;
+}
+
+/**
+* @brief Run a blocking operation on the context's helper threads
+*
+* The operation completes through the ready list of the context, the helper
+* thread wakes the owner with ops->wakeup. When the helper queue is full it
+* waits on the context's own offload queue instead, so a burst of blocking
+* operations never holds back other I/O.
+*
+* @param ctx Context
+* @param state Operation state
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+sio_error_t sio_context_offload(sio_context_t *ctx, sio_op_state_t *state);
+
+/**
+* @brief Cancel an operation handed to sio_context_offload
+*
+* One still waiting on the offload queue finishes as SIO_OP_CANCELLED. One that
+* a helper thread has taken (SIO_OP_STATE_OFFLOADED) cannot be stopped.
+*
+* @param ctx Context
+* @param state Operation state
+* @return sio_error_t SIO_SUCCESS, or SIO_ERROR_BUSY if a helper thread owns it
+*/
+sio_error_t sio_context_offload_cancel(sio_context_t *ctx, sio_op_state_t *state);
+
+/**
+* @brief Get the open(2) flags for stream flags, close-on-exec included
+*
+* @param opt SIO_STREAM_* flags
+* @return int Open flags
+*/
+int sio_context_open_flags(sio_stream_flags_t opt);
+
+/**
+* @brief Wrap a descriptor opened for a SIO_OP_OPEN operation into its request
+*
+* @param op SIO_OP_OPEN operation
+* @param fd Opened descriptor
+* @return sio_error_t SIO_SUCCESS or error code (the descriptor is left open)
+*/
+sio_error_t sio_context_open_fill(sio_op_t *op, int fd);
+
+/**
+* @brief Fill the file information of a SIO_OP_STAT operation
+*
+* @param op SIO_OP_STAT operation
+* @param mode File type and permission bits (st_mode)
+* @param size File size in bytes
+* @param atime Last access time
+* @param mtime Last modification time
+* @param btime Creation time, or the last status change where unknown
+*/
+void sio_context_stat_fill(sio_op_t *op, uint32_t mode, uint64_t size, time_t atime, time_t mtime, time_t btime);
+
+/**
+* @brief Whether a write is to be sent without copying
+*
+* True for a SIO_OP_FLAG_ZEROCOPY write of at least SIO_OP_ZEROCOPY_MIN bytes to
+* a registered socket that takes SO_ZEROCOPY, which is probed once per stream.
+* Backends call it only when they can report the buffer release.
+*
+* @param ctx Context
+* @param state Operation state
+* @return int Non-zero to send without copying
+*/
+int sio_context_zerocopy(sio_context_t *ctx, sio_op_state_t *state);
+
+/**
+* @brief Append an event to the trace ring, use sio_context_trace
+*
+* @param ctx Context with a trace ring
+* @param kind Event kind
+* @param op Operation (NULL for SIO_TRACE_ENTER)
+* @param fd Descriptor
+* @param result Kind specific result
+*/
+void sio_context_trace_record(sio_context_t *ctx, sio_trace_kind_t kind, const sio_op_t *op, int fd, int64_t result);
+
+/**
+* @brief Record a trace event if the context traces
+*/
+static SIO_INLINE void sio_context_trace(sio_context_t *ctx, sio_trace_kind_t kind, const sio_op_t *op, int fd, int64_t result) {
+  if (ctx->trace) {
+    sio_context_trace_record(ctx, kind, op, fd, result);
+  }
+}
+
+/**
+* @brief Deliver a completion of a multishot operation that stays pending
+*
+* Invokes the completion callback immediately with SIO_OP_FLAG_MORE set.
+*
+* @param ctx Context
+* @param state Operation state
+* @param res Result (bytes transferred)
+*/
+void sio_context_notify(sio_context_t *ctx, sio_op_state_t *state, int64_t res);
+
+/**
+* @brief Attach a provided buffer to an operation result and mark it lent
+*
+* @param ctx Context
+* @param op Operation receiving the buffer
+* @param buffer_id Buffer id
+*/
+void sio_context_lend_buffer(sio_context_t *ctx, sio_op_t *op, uint16_t buffer_id);
+
+/**
+* @brief Take a provided buffer from the generic free list
+*
+* @param ctx Context
+* @return int Buffer id or -1 if none is available
+*/
+int sio_context_ring_take(sio_context_t *ctx);
+
+/**
+* @brief Return an unused provided buffer to the generic free list
+*
+* @param ctx Context
+* @param buffer_id Buffer id
+*/
+void sio_context_ring_put(sio_context_t *ctx, uint16_t buffer_id);
+
+/**
+* @brief Fill an accept result from a freshly accepted descriptor
+*
+* @param server Listening stream
+* @param op Accept operation
+* @param fd Accepted descriptor
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+sio_error_t sio_context_accept_fill(const sio_stream_t *server, sio_op_t *op, int fd);
+
+#endif /* SIO_CONTEXT_BACKEND_H */
@@ -0,0 +1,194 @@
+/**
+* @file src/context/epoll.c
+* @brief Linux epoll backend for the I/O context
+*
+* Streams are added to the epoll set once, edge-triggered for both directions.
+* Each registered stream keeps per-direction readiness bits and queues of pending
+* operations; an edge sets the bit and the queues are drained with non-blocking
+* syscalls until EAGAIN clears it again (see src/context/reactor.h). Operations
+* on a stream that is ready are attempted as soon as the submission is flushed,
+* without an epoll_wait.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/context.h>
+#include <sio/err.h>
+#include <src/context/backend.h>
+#include <src/context/reactor.h>
+
+#if defined(SIO_OS_LINUX)
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+/**
+* @brief epoll backend context
+*/
+typedef struct sio_context_epoll {
+  sio_context_reactor_t reactor; /**< Readiness reactor (must be first) */
+  int epfd;                      /**< epoll instance */
+  struct epoll_event *events;    /**< Event array for epoll_wait */
+  uint32_t event_capacity;       /**< Size of the event array */
+} sio_context_epoll_t;
+
+static sio_error_t epoll_init(sio_context_t *ctx, const sio_context_config_t *config) {
+  sio_context_epoll_t *ep = (sio_context_epoll_t*)ctx;
+  (void)config;
+
+  ep->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (ep->epfd < 0) {
+    return sio_get_last_error();
+  }
+
+  ep->event_capacity = ctx->max_events;
+  ep->events = (struct epoll_event*)malloc(ep->event_capacity * sizeof(struct epoll_event));
+  if (!ep->events) {
+    close(ep->epfd);
+    return SIO_ERROR_MEM;
+  }
+
+  /* EPOLLERR is reported without being asked for */
+  ep->reactor.zerocopy = 1;
+
+  sio_error_t err = sio_context_reactor_wake_open(ctx);
+  if (err == SIO_SUCCESS && ep->reactor.wake_fd[0] >= 0) {
+    /* A NULL entry marks the wakeup descriptor */
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(ep->epfd, EPOLL_CTL_ADD, ep->reactor.wake_fd[0], &ev) < 0) {
+      err = sio_get_last_error();
+    }
+  }
+  if (err != SIO_SUCCESS) {
+    sio_context_reactor_wake_close(ctx);
+    close(ep->epfd);
+    free(ep->events);
+    return err;
+  }
+
+  return SIO_SUCCESS;
+}
+
+static void epoll_destroy(sio_context_t *ctx) {
+  sio_context_epoll_t *ep = (sio_context_epoll_t*)ctx;
+
+  close(ep->epfd);
+  free(ep->events);
+  sio_context_reactor_wake_close(ctx);
+}
+
+static sio_error_t epoll_add(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_epoll_t *ep = (sio_context_epoll_t*)ctx;
+
+  sio_error_t err = sio_context_reactor_set_nonblock(entry->fd);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.ptr = entry;
+
+  if (epoll_ctl(ep->epfd, EPOLL_CTL_ADD, entry->fd, &ev) < 0) {
+    /* Regular files and block devices cannot be polled and never block */
+    if (errno == EPERM) {
+      entry->ready = SIO_READY_IN | SIO_READY_OUT | SIO_READY_ALWAYS;
+      return SIO_SUCCESS;
+    }
+    return sio_get_last_error();
+  }
+
+  /* Assume ready until EAGAIN says otherwise, so the first operation is tried right away */
+  entry->ready = SIO_READY_IN | SIO_READY_OUT;
+  return SIO_SUCCESS;
+}
+
+static sio_error_t epoll_remove(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_epoll_t *ep = (sio_context_epoll_t*)ctx;
+
+  sio_context_reactor_forget(ctx, entry);
+
+  if (!(entry->ready & SIO_READY_ALWAYS) && epoll_ctl(ep->epfd, EPOLL_CTL_DEL, entry->fd, NULL) < 0 && errno != EBADF && errno != ENOENT) {
+    return sio_get_last_error();
+  }
+
+  return SIO_SUCCESS;
+}
+
+static sio_wait_result_t epoll_poll(sio_context_t *ctx, uint64_t timeout_ms, uint32_t max_events) {
+  sio_context_epoll_t *ep = (sio_context_epoll_t*)ctx;
+
+  sio_context_reactor_flush(ctx);
+
+  if (ctx->ready_count || ep->reactor.dirty) {
+    timeout_ms = 0;
+  }
+
+  int max = (int)(max_events < ep->event_capacity ? max_events : ep->event_capacity);
+  ctx->stats.syscalls++;
+  sio_context_trace(ctx, SIO_TRACE_ENTER, NULL, ep->epfd, 0);
+  int n = epoll_wait(ep->epfd, ep->events, max, sio_context_reactor_timeout(timeout_ms));
+  if (n < 0) {
+    if (ctx->ready_count) {
+      return SIO_WAIT_COMPLETED;
+    }
+    return errno == EINTR ? SIO_WAIT_INTERRUPTED : SIO_WAIT_ERROR;
+  }
+
+  /* Only record the edges here, multishot callbacks in the drain may remove other entries */
+  for (int i = 0; i < n; i++) {
+    sio_context_entry_t *entry = (sio_context_entry_t*)ep->events[i].data.ptr;
+    uint32_t events = ep->events[i].events;
+
+    if (!entry) {
+      sio_context_reactor_wake_drain(ctx);
+      continue;
+    }
+
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+      entry->ready |= SIO_READY_IN;
+    }
+    if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+      entry->ready |= SIO_READY_OUT;
+    }
+    if (events & EPOLLERR) {
+      entry->ready |= SIO_READY_ERR;
+    }
+
+    sio_context_reactor_mark_dirty(ctx, entry);
+  }
+
+  sio_context_reactor_flush(ctx);
+
+  return ctx->ready_count ? SIO_WAIT_COMPLETED : SIO_WAIT_TIMEOUT;
+}
+
+const sio_context_backend_ops_t sio_context_epoll_ops = {
+  .type = SIO_CONTEXT_EPOLL,
+  .context_size = sizeof(sio_context_epoll_t),
+  .available = NULL,
+  .init = epoll_init,
+  .destroy = epoll_destroy,
+  .add = epoll_add,
+  .remove = epoll_remove,
+  .submit = sio_context_reactor_submit,
+  .flush = sio_context_reactor_flush,
+  .cancel = sio_context_reactor_cancel,
+  .cancel_stream = NULL, /* Queued operations are dropped one by one without a syscall */
+  .poll = epoll_poll,
+  .peek = NULL, /* Readiness has to be asked for with a syscall */
+  .wakeup = sio_context_reactor_wakeup,
+  .configure = NULL, /* No epoll specific options */
+  .register_buffers = NULL, /* Readiness based, buffers are only touched by plain syscalls */
+  .unregister_buffers = NULL,
+  .register_buffer_ring = NULL, /* Provided buffers come from the generic free list */
+  .unregister_buffer_ring = NULL,
+  .recycle_buffer = NULL
+};
+
+#endif /* SIO_OS_LINUX */
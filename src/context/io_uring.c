@@ -0,0 +1,1290 @@
+/**
+* @file src/context/io_uring.c
+* @brief Linux io_uring backend for the I/O context
+*
+* Talks to the kernel through the raw io_uring_setup/io_uring_enter syscalls and
+* the mmap'd submission and completion rings, without liburing. Every sio_op_t
+* maps onto one SQE whose user_data is the operation state; sio_context_wait
+* submits whatever is still queued and waits for completions in the same
+* io_uring_enter call, then reaps the CQ ring into the ready list.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/context.h>
+#include <sio/err.h>
+#include <src/context/backend.h>
+
+#if defined(SIO_OS_LINUX)
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#ifndef __NR_io_uring_setup
+  #define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+  #define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+  #define __NR_io_uring_register 427
+#endif
+
+/* Default number of fixed file slots */
+#define SIO_URING_DEFAULT_FIXED_FILES 4096
+
+/* Buffer group id of the provided buffer ring */
+#define SIO_URING_BUFFER_GROUP 0
+
+/* Largest transfer a single read/write SQE is asked to do (same cap as the kernel's MAX_RW_COUNT) */
+#define SIO_URING_MAX_RW 0x7ffff000u
+
+/**
+* @brief Submission queue ring
+*/
+typedef struct sio_uring_sq {
+  uint32_t *head;                /**< Kernel-owned consumer index */
+  uint32_t *tail;                /**< Producer index published to the kernel */
+  uint32_t *flags;               /**< IORING_SQ_* flags */
+  uint32_t *array;               /**< SQE index array */
+  uint32_t mask;                 /**< Ring mask */
+  uint32_t entries;              /**< Ring size */
+  uint32_t sqe_tail;             /**< Local producer index (SQEs filled but not yet published) */
+  struct io_uring_sqe *sqes;     /**< SQE array */
+} sio_uring_sq_t;
+
+/**
+* @brief Completion queue ring
+*/
+typedef struct sio_uring_cq {
+  uint32_t *head;                /**< Consumer index */
+  uint32_t *tail;                /**< Kernel-owned producer index */
+  uint32_t mask;                 /**< Ring mask */
+  uint32_t entries;              /**< Ring size */
+  struct io_uring_cqe *cqes;     /**< CQE array */
+} sio_uring_cq_t;
+
+/**
+* @brief io_uring backend context
+*/
+typedef struct sio_context_uring {
+  sio_context_t base;            /**< Generic context (must be first) */
+  int ring_fd;                   /**< io_uring instance */
+  uint32_t features;             /**< IORING_FEAT_* reported by the kernel */
+  int cancel_fd;                 /**< Whether one request can cancel everything on a descriptor */
+  int send_zc;                   /**< Whether IORING_OP_SEND_ZC is supported (6.0) */
+  sio_error_t broken;            /**< Why there is no ring after a failed rebuild (SIO_SUCCESS while there is one) */
+  sio_io_uring_config_t config;  /**< Configuration the ring was built with */
+  sio_uring_sq_t sq;             /**< Submission queue */
+  sio_uring_cq_t cq;             /**< Completion queue */
+  void *sq_ring;                 /**< SQ ring mapping */
+  size_t sq_ring_size;           /**< SQ ring mapping size */
+  void *cq_ring;                 /**< CQ ring mapping (same as sq_ring with IORING_FEAT_SINGLE_MMAP) */
+  size_t cq_ring_size;           /**< CQ ring mapping size */
+  size_t sqes_size;              /**< SQE array mapping size */
+  uint32_t *file_free;           /**< Stack of free fixed file slots */
+  uint32_t file_free_count;      /**< Number of free fixed file slots */
+  uint32_t file_slots;           /**< Size of the fixed file table (0 if not registered) */
+  struct io_uring_buf_ring *buf_ring; /**< Provided buffer ring shared with the kernel */
+  size_t buf_ring_size;          /**< Provided buffer ring mapping size */
+  uint32_t buf_ring_mask;        /**< Provided buffer ring mask */
+  uint16_t buf_ring_tail;        /**< Local tail of the provided buffer ring */
+  int wake_fd;                   /**< Wakeup eventfd (-1 without SIO_CTX_THREAD_SAFE) */
+  uint64_t wake_value;           /**< Target of the read kept pending on wake_fd, its address tags the CQE */
+} sio_context_uring_t;
+
+static int uring_setup(uint32_t entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, const void *arg, size_t argsz) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int uring_register(int fd, uint32_t opcode, const void *arg, uint32_t nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+* @brief Unmap the rings and close the io_uring instance
+*/
+static void uring_teardown(sio_context_uring_t *ur) {
+  if (ur->sq.sqes && ur->sq.sqes != MAP_FAILED) {
+    munmap(ur->sq.sqes, ur->sqes_size);
+  }
+  if (ur->cq_ring && ur->cq_ring != MAP_FAILED && ur->cq_ring != ur->sq_ring) {
+    munmap(ur->cq_ring, ur->cq_ring_size);
+  }
+  if (ur->sq_ring && ur->sq_ring != MAP_FAILED) {
+    munmap(ur->sq_ring, ur->sq_ring_size);
+  }
+  if (ur->ring_fd >= 0) {
+    close(ur->ring_fd);
+  }
+
+  /* Closing the ring drops the provided buffer ring registration */
+  if (ur->buf_ring) {
+    munmap(ur->buf_ring, ur->buf_ring_size);
+    ur->buf_ring = NULL;
+  }
+
+  free(ur->file_free);
+  ur->file_free = NULL;
+  ur->file_free_count = ur->file_slots = 0;
+
+  ur->sq.sqes = NULL;
+  ur->sq_ring = ur->cq_ring = NULL;
+  ur->ring_fd = -1;
+}
+
+/**
+* @brief Register an empty fixed file table
+*
+* Failure is not fatal, registered streams then use their plain descriptor.
+*
+* @param ur Backend context
+* @param slots Requested number of slots (0 for the default)
+*/
+static void uring_files_setup(sio_context_uring_t *ur, uint32_t slots) {
+  struct rlimit rl;
+
+  if (!slots) {
+    slots = SIO_URING_DEFAULT_FIXED_FILES;
+  }
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && slots > rl.rlim_cur) {
+    slots = (uint32_t)rl.rlim_cur;
+  }
+
+  int32_t *fds = (int32_t*)malloc(slots * sizeof(int32_t));
+  ur->file_free = (uint32_t*)malloc(slots * sizeof(uint32_t));
+  if (!fds || !ur->file_free) {
+    free(fds);
+    free(ur->file_free);
+    ur->file_free = NULL;
+    return;
+  }
+
+  /* -1 entries are empty slots, filled later with IORING_REGISTER_FILES_UPDATE */
+  for (uint32_t i = 0; i < slots; i++) {
+    fds[i] = -1;
+    ur->file_free[i] = slots - 1 - i;
+  }
+
+  if (uring_register(ur->ring_fd, IORING_REGISTER_FILES, fds, slots) < 0) {
+    free(ur->file_free);
+    ur->file_free = NULL;
+  } else {
+    ur->file_slots = slots;
+    ur->file_free_count = slots;
+  }
+
+  free(fds);
+}
+
+/**
+* @brief Check for IORING_ASYNC_CANCEL_FD with IORING_ASYNC_CANCEL_ALL
+*
+* Both date from 5.19 and cannot be probed directly, so this asks for
+* IORING_REGISTER_SYNC_CANCEL (6.0) with an invalid descriptor: newer kernels
+* reject the descriptor, older ones the request.
+*/
+static int uring_probe_cancel_fd(int ring_fd) {
+#if defined(IORING_ASYNC_CANCEL_FD_FIXED)
+  struct io_uring_sync_cancel_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.fd = -1;
+  reg.flags = IORING_ASYNC_CANCEL_FD;
+  reg.timeout.tv_sec = -1;
+  reg.timeout.tv_nsec = -1;
+
+  return uring_register(ring_fd, IORING_REGISTER_SYNC_CANCEL, &reg, 1) < 0 && errno == EBADF;
+#else
+  (void)ring_fd;
+  return 0;
+#endif
+}
+
+/**
+* @brief Check for IORING_OP_SEND_ZC with IORING_REGISTER_PROBE
+*/
+static int uring_probe_send_zc(int ring_fd) {
+#if defined(IORING_CQE_F_NOTIF)
+  size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe = (struct io_uring_probe*)calloc(1, size);
+  if (!probe) {
+    return 0;
+  }
+
+  int supported = uring_register(ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                  probe->last_op >= IORING_OP_SEND_ZC && (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  return supported;
+#else
+  (void)ring_fd;
+  return 0;
+#endif
+}
+
+/**
+* @brief Create the io_uring instance and map its rings
+*
+* @param ur Backend context
+* @param config Ring configuration
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t uring_build(sio_context_uring_t *ur, const sio_io_uring_config_t *config) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  /* The rings are accessed with the default 64 byte SQE and 16 byte CQE layout */
+  if (config->flags & (IORING_SETUP_SQE128 | IORING_SETUP_CQE32)) {
+    return SIO_ERROR_PARAM;
+  }
+
+  uint32_t entries = config->sq_entries ? config->sq_entries : ur->base.queue_depth;
+  p.flags = config->flags;
+  if (config->cq_entries) {
+    p.flags |= IORING_SETUP_CQSIZE;
+    p.cq_entries = config->cq_entries;
+  }
+  if (config->flags & IORING_SETUP_SQPOLL) {
+    p.sq_thread_idle = config->sq_thread_idle;
+    if (config->flags & IORING_SETUP_SQ_AFF) {
+      p.sq_thread_cpu = config->sq_thread_cpu;
+    }
+  }
+
+  ur->ring_fd = uring_setup(entries, &p);
+  if (ur->ring_fd < 0) {
+    return sio_get_last_error();
+  }
+
+  /* Timed waits rely on IORING_ENTER_EXT_ARG (5.11) */
+  if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+    uring_teardown(ur);
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  ur->features = p.features;
+  ur->config = *config;
+  ur->cancel_fd = uring_probe_cancel_fd(ur->ring_fd);
+  ur->send_zc = uring_probe_send_zc(ur->ring_fd);
+
+  ur->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  ur->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ur->cq_ring_size > ur->sq_ring_size) {
+      ur->sq_ring_size = ur->cq_ring_size;
+    }
+    ur->cq_ring_size = ur->sq_ring_size;
+  }
+
+  ur->sq_ring = mmap(NULL, ur->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring_fd, IORING_OFF_SQ_RING);
+  if (ur->sq_ring == MAP_FAILED) {
+    sio_error_t err = sio_get_last_error();
+    uring_teardown(ur);
+    return err;
+  }
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ur->cq_ring = ur->sq_ring;
+  } else {
+    ur->cq_ring = mmap(NULL, ur->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring_fd, IORING_OFF_CQ_RING);
+    if (ur->cq_ring == MAP_FAILED) {
+      sio_error_t err = sio_get_last_error();
+      uring_teardown(ur);
+      return err;
+    }
+  }
+
+  ur->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  ur->sq.sqes = (struct io_uring_sqe*)mmap(NULL, ur->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring_fd, IORING_OFF_SQES);
+  if (ur->sq.sqes == MAP_FAILED) {
+    sio_error_t err = sio_get_last_error();
+    uring_teardown(ur);
+    return err;
+  }
+
+  char *sq = (char*)ur->sq_ring;
+  ur->sq.head = (uint32_t*)(sq + p.sq_off.head);
+  ur->sq.tail = (uint32_t*)(sq + p.sq_off.tail);
+  ur->sq.flags = (uint32_t*)(sq + p.sq_off.flags);
+  ur->sq.array = (uint32_t*)(sq + p.sq_off.array);
+  ur->sq.mask = *(uint32_t*)(sq + p.sq_off.ring_mask);
+  ur->sq.entries = *(uint32_t*)(sq + p.sq_off.ring_entries);
+  ur->sq.sqe_tail = *ur->sq.tail;
+
+  /* SQE slots are used in ring order, so the index array is an identity map */
+  for (uint32_t i = 0; i < ur->sq.entries; i++) {
+    ur->sq.array[i] = i;
+  }
+
+  char *cq = (char*)ur->cq_ring;
+  ur->cq.head = (uint32_t*)(cq + p.cq_off.head);
+  ur->cq.tail = (uint32_t*)(cq + p.cq_off.tail);
+  ur->cq.mask = *(uint32_t*)(cq + p.cq_off.ring_mask);
+  ur->cq.entries = *(uint32_t*)(cq + p.cq_off.ring_entries);
+  ur->cq.cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  uring_files_setup(ur, config->fixed_files);
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Publish filled SQEs to the kernel
+*
+* @return uint32_t Number of SQEs the kernel has not consumed yet
+*/
+static uint32_t uring_sq_flush(sio_context_uring_t *ur) {
+  __atomic_store_n(ur->sq.tail, ur->sq.sqe_tail, __ATOMIC_RELEASE);
+  return ur->sq.sqe_tail - __atomic_load_n(ur->sq.head, __ATOMIC_ACQUIRE);
+}
+
+/**
+* @brief Publish queued SQEs and tell whether the kernel has to be entered for them
+*
+* @param ur Backend context
+* @param flags Receives the io_uring_enter flags the submission needs
+* @return uint32_t Number of SQEs to pass to io_uring_enter (0 if no call is needed)
+*/
+static uint32_t uring_sq_publish(sio_context_uring_t *ur, uint32_t *flags) {
+  uint32_t to_submit = uring_sq_flush(ur);
+
+  *flags = 0;
+  if (to_submit && (ur->config.flags & IORING_SETUP_SQPOLL)) {
+    /* The poller thread sees the new tail by itself unless it went idle */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!(__atomic_load_n(ur->sq.flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)) {
+      return 0;
+    }
+    *flags = IORING_ENTER_SQ_WAKEUP;
+  }
+
+  return to_submit;
+}
+
+/**
+* @brief Submit all queued SQEs without waiting
+*
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+static sio_error_t uring_submit_pending(sio_context_uring_t *ur) {
+  uint32_t flags;
+  uint32_t to_submit = uring_sq_publish(ur, &flags);
+  if (!to_submit) {
+    return SIO_SUCCESS;
+  }
+
+  int ret;
+  do {
+    ur->base.stats.syscalls++;
+    sio_context_trace(&ur->base, SIO_TRACE_ENTER, NULL, ur->ring_fd, to_submit);
+    ret = uring_enter(ur->ring_fd, to_submit, 0, flags, NULL, 0);
+  } while (ret < 0 && errno == EINTR);
+
+  /* EBUSY/EAGAIN mean the CQ is backed up; the SQEs go in with the next wait */
+  if (ret < 0 && errno != EBUSY && errno != EAGAIN) {
+    return sio_get_last_error();
+  }
+
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Make room for a number of SQEs, submitting queued ones if needed
+*
+* @param ur Backend context
+* @param count Number of SQEs that must fit
+* @return int Non-zero if count SQEs can be taken without a submission in between
+*/
+static int uring_sq_reserve(sio_context_uring_t *ur, uint32_t count) {
+  uint32_t head = __atomic_load_n(ur->sq.head, __ATOMIC_ACQUIRE);
+
+  if (ur->sq.sqe_tail - head + count > ur->sq.entries) {
+    ur->base.stats.sq_full++;
+    uring_submit_pending(ur);
+    head = __atomic_load_n(ur->sq.head, __ATOMIC_ACQUIRE);
+
+    /* The poller thread consumes asynchronously, wait until it made room */
+    if (ur->sq.sqe_tail - head + count > ur->sq.entries && (ur->config.flags & IORING_SETUP_SQPOLL)) {
+      ur->base.stats.syscalls++;
+      sio_context_trace(&ur->base, SIO_TRACE_ENTER, NULL, ur->ring_fd, 0);
+      uring_enter(ur->ring_fd, 0, 0, IORING_ENTER_SQ_WAIT, NULL, 0);
+      head = __atomic_load_n(ur->sq.head, __ATOMIC_ACQUIRE);
+    }
+  }
+
+  return ur->sq.sqe_tail - head + count <= ur->sq.entries;
+}
+
+/**
+* @brief Get a free SQE, submitting queued ones if the ring is full
+*
+* @return struct io_uring_sqe* Zeroed SQE or NULL if the ring stays full
+*/
+static struct io_uring_sqe *uring_get_sqe(sio_context_uring_t *ur) {
+  if (!uring_sq_reserve(ur, 1)) {
+    return NULL;
+  }
+
+  struct io_uring_sqe *sqe = &ur->sq.sqes[ur->sq.sqe_tail & ur->sq.mask];
+  memset(sqe, 0, sizeof(*sqe));
+  ur->sq.sqe_tail++;
+  return sqe;
+}
+
+/**
+* @brief Fill the common SQE fields
+*/
+static void uring_prep(struct io_uring_sqe *sqe, uint8_t opcode, int fd, const void *addr, uint32_t len, uint64_t off) {
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)addr;
+  sqe->len = len;
+  sqe->off = off;
+}
+
+/**
+* @brief Keep a read pending on the wakeup eventfd, so that a write to it completes a wait
+*/
+static void uring_wake_arm(sio_context_uring_t *ur) {
+  struct io_uring_sqe *sqe = uring_get_sqe(ur);
+  if (sqe) {
+    uring_prep(sqe, IORING_OP_READ, ur->wake_fd, &ur->wake_value, sizeof(ur->wake_value), 0);
+    sqe->user_data = (uint64_t)(uintptr_t)&ur->wake_value;
+  }
+}
+
+/**
+* @brief Translate an operation into an SQE
+*
+* @param ctx Context
+* @param st Operation state
+* @param sqe SQE to fill
+*/
+static void uring_prep_op(sio_context_t *ctx, sio_op_state_t *st, struct io_uring_sqe *sqe) {
+  sio_op_t *op = st->op;
+  int is_socket = op->stream && op->stream->type == SIO_STREAM_SOCKET;
+  uint32_t len = op->size > SIO_URING_MAX_RW ? SIO_URING_MAX_RW : (uint32_t)op->size;
+  int buf_index = -1;
+
+  if (ctx->fixed_buffer_count && (op->type == SIO_OP_READ || op->type == SIO_OP_WRITE ||
+                                  op->type == SIO_OP_READ_AT || op->type == SIO_OP_WRITE_AT)) {
+    buf_index = sio_context_fixed_buffer_find(ctx, op->buffer, len);
+  }
+
+  switch (op->type) {
+    case SIO_OP_READ:
+      if (buf_index >= 0) {
+        uring_prep(sqe, IORING_OP_READ_FIXED, st->fd, op->buffer, len, is_socket ? 0 : (uint64_t)-1);
+        sqe->buf_index = (uint16_t)buf_index;
+      } else if (is_socket) {
+        uring_prep(sqe, IORING_OP_RECV, st->fd, op->buffer, len, 0);
+      } else {
+        uring_prep(sqe, IORING_OP_READ, st->fd, op->buffer, len, (uint64_t)-1);
+      }
+      break;
+
+    case SIO_OP_WRITE:
+      /* Socket writes keep SEND for MSG_NOSIGNAL, WRITE_FIXED would raise SIGPIPE */
+      if (buf_index >= 0 && !is_socket) {
+        uring_prep(sqe, IORING_OP_WRITE_FIXED, st->fd, op->buffer, len, (uint64_t)-1);
+        sqe->buf_index = (uint16_t)buf_index;
+#if defined(IORING_CQE_F_NOTIF)
+      } else if (is_socket && ((sio_context_uring_t*)ctx)->send_zc && sio_context_zerocopy(ctx, st)) {
+        /* Posts a second CQE (IORING_CQE_F_NOTIF) once the kernel let go of the buffer */
+        uring_prep(sqe, IORING_OP_SEND_ZC, st->fd, op->buffer, len, 0);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        if (buf_index >= 0) {
+          sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+          sqe->buf_index = (uint16_t)buf_index;
+        }
+        st->flags |= SIO_OP_STATE_ZEROCOPY;
+#endif
+      } else if (is_socket) {
+        uring_prep(sqe, IORING_OP_SEND, st->fd, op->buffer, len, 0);
+        sqe->msg_flags = MSG_NOSIGNAL;
+      } else {
+        uring_prep(sqe, IORING_OP_WRITE, st->fd, op->buffer, len, (uint64_t)-1);
+      }
+      break;
+
+    case SIO_OP_READ_AT:
+      if (buf_index >= 0) {
+        uring_prep(sqe, IORING_OP_READ_FIXED, st->fd, op->buffer, len, op->offset);
+        sqe->buf_index = (uint16_t)buf_index;
+      } else {
+        uring_prep(sqe, IORING_OP_READ, st->fd, op->buffer, len, op->offset);
+      }
+      break;
+
+    case SIO_OP_WRITE_AT:
+      if (buf_index >= 0) {
+        uring_prep(sqe, IORING_OP_WRITE_FIXED, st->fd, op->buffer, len, op->offset);
+        sqe->buf_index = (uint16_t)buf_index;
+      } else {
+        uring_prep(sqe, IORING_OP_WRITE, st->fd, op->buffer, len, op->offset);
+      }
+      break;
+
+    /* sio_iovec_t is laid out as struct iovec on POSIX, size is the entry count */
+    case SIO_OP_READV_AT:
+      uring_prep(sqe, IORING_OP_READV, st->fd, op->buffer, (uint32_t)op->size, op->offset);
+      break;
+
+    case SIO_OP_WRITEV_AT:
+      uring_prep(sqe, IORING_OP_WRITEV, st->fd, op->buffer, (uint32_t)op->size, op->offset);
+      break;
+
+    case SIO_OP_FSYNC:
+      uring_prep(sqe, IORING_OP_FSYNC, st->fd, NULL, 0, 0);
+      break;
+
+    case SIO_OP_FDATASYNC:
+      uring_prep(sqe, IORING_OP_FSYNC, st->fd, NULL, 0, 0);
+      sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+      break;
+
+    case SIO_OP_SYNC_RANGE:
+      /* The SQE length is 32 bits wide, longer ranges sync to the end of the file */
+      uring_prep(sqe, IORING_OP_SYNC_FILE_RANGE, st->fd, NULL, op->size > UINT32_MAX ? 0 : (uint32_t)op->size, op->offset);
+      sqe->sync_range_flags = SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+      break;
+
+    case SIO_OP_OPEN: {
+      const sio_open_request_t *req = (const sio_open_request_t*)op->buffer;
+      uring_prep(sqe, IORING_OP_OPENAT, AT_FDCWD, req->path, (uint32_t)(req->mode ? req->mode : 0666), 0);
+      sqe->open_flags = (uint32_t)sio_context_open_flags(req->opt);
+      break;
+    }
+
+    case SIO_OP_STAT: {
+      /* The kernel writes a struct statx over info, uring_statx converts it in place */
+      sio_stat_request_t *req = (sio_stat_request_t*)op->buffer;
+      uring_prep(sqe, IORING_OP_STATX, AT_FDCWD, req->path, STATX_BASIC_STATS | STATX_BTIME, (uint64_t)(uintptr_t)&req->info);
+      break;
+    }
+
+    case SIO_OP_UNLINK:
+      uring_prep(sqe, IORING_OP_UNLINKAT, AT_FDCWD, op->buffer, 0, 0);
+      break;
+
+    case SIO_OP_RENAME: {
+      const sio_rename_request_t *req = (const sio_rename_request_t*)op->buffer;
+      uring_prep(sqe, IORING_OP_RENAMEAT, AT_FDCWD, req->old_path, (uint32_t)AT_FDCWD, (uint64_t)(uintptr_t)req->new_path);
+      break;
+    }
+
+    case SIO_OP_ACCEPT: {
+      sio_accept_result_t *res = (sio_accept_result_t*)op->buffer;
+      res->addr.len = sizeof(res->addr.addr.ss);
+      uring_prep(sqe, IORING_OP_ACCEPT, st->fd, &res->addr.addr.sa, 0, (uint64_t)(uintptr_t)&res->addr.len);
+      sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+      break;
+    }
+
+    case SIO_OP_ACCEPT_MULTISHOT:
+      /* A shared address buffer would be overwritten by later clients, see uring_accept */
+      uring_prep(sqe, IORING_OP_ACCEPT, st->fd, NULL, 0, 0);
+      sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+      sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+      break;
+
+    case SIO_OP_CONNECT:
+      if (op->buffer) {
+        const sio_addr_t *addr = (const sio_addr_t*)op->buffer;
+        uring_prep(sqe, IORING_OP_CONNECT, st->fd, &addr->addr.sa, 0, addr->len);
+      } else {
+        /* Wait for a connect that is already in progress */
+        uring_prep(sqe, IORING_OP_POLL_ADD, st->fd, NULL, 0, 0);
+        sqe->poll32_events = POLLOUT;
+        st->flags |= SIO_OP_STATE_POLLED;
+      }
+      break;
+
+    case SIO_OP_RECV_MULTISHOT:
+      /* The kernel picks a buffer from the provided ring for every completion */
+      uring_prep(sqe, IORING_OP_RECV, st->fd, NULL, 0, 0);
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->flags |= IOSQE_BUFFER_SELECT;
+      sqe->buf_group = SIO_URING_BUFFER_GROUP;
+      break;
+
+    case SIO_OP_TIMER:
+      /* Absolute, so a periodic timer re-armed late keeps its schedule */
+      uring_prep(sqe, IORING_OP_TIMEOUT, -1, st->timer_ts, 1, 0);
+      sqe->timeout_flags = IORING_TIMEOUT_ABS;
+      break;
+
+    default:
+      uring_prep(sqe, IORING_OP_NOP, -1, NULL, 0, 0);
+      break;
+  }
+
+  /* Sockets only break a link on a short transfer with MSG_WAITALL */
+  if (st->link && (sqe->opcode == IORING_OP_RECV || sqe->opcode == IORING_OP_SEND)) {
+    sqe->msg_flags |= MSG_WAITALL;
+  }
+
+  if (st->entry && st->entry->slot >= 0 && sqe->opcode != IORING_OP_NOP && sqe->opcode != IORING_OP_TIMEOUT) {
+    sqe->fd = st->entry->slot;
+    sqe->flags |= IOSQE_FIXED_FILE;
+  }
+
+  sqe->user_data = (uint64_t)(uintptr_t)st;
+}
+
+/**
+* @brief Wrap a descriptor accepted by the kernel into the accept result
+*
+* @param st Accept operation state
+* @param fd Accepted descriptor
+* @return int32_t 0 on success or negated errno
+*/
+static int32_t uring_accept(sio_op_state_t *st, int fd) {
+  sio_op_t *op = st->op;
+
+  /* One extra syscall per client, only for callers that sized the result for the address */
+  if (op->type == SIO_OP_ACCEPT_MULTISHOT && op->size >= sizeof(sio_accept_result_t)) {
+    sio_accept_result_t *res = (sio_accept_result_t*)op->buffer;
+    res->addr.len = sizeof(res->addr.addr.ss);
+    if (getpeername(fd, &res->addr.addr.sa, &res->addr.len) < 0) {
+      res->addr.len = 0;
+    }
+  }
+
+  if (sio_context_accept_fill(op->stream, op, fd) != SIO_SUCCESS) {
+    close(fd);
+    return -EINVAL;
+  }
+  return 0;
+}
+
+_Static_assert(sizeof(sio_file_info_t) >= sizeof(struct statx), "statx results are written over sio_file_info_t");
+
+/**
+* @brief Convert the struct statx the kernel wrote over the info of a stat request
+*
+* @param op SIO_OP_STAT operation
+*/
+static void uring_statx(sio_op_t *op) {
+  struct statx sx;
+  memcpy(&sx, &((sio_stat_request_t*)op->buffer)->info, sizeof(sx));
+
+  time_t btime = (sx.stx_mask & STATX_BTIME) ? (time_t)sx.stx_btime.tv_sec : (time_t)sx.stx_ctime.tv_sec;
+  sio_context_stat_fill(op, sx.stx_mode, sx.stx_size, (time_t)sx.stx_atime.tv_sec, (time_t)sx.stx_mtime.tv_sec, btime);
+}
+
+/**
+* @brief Complete an operation from its CQE
+*
+* @param ctx Context
+* @param st Operation state
+* @param res CQE result
+* @param flags CQE flags
+*/
+static void uring_complete(sio_context_t *ctx, sio_op_state_t *st, int32_t res, uint32_t flags) {
+  sio_op_t *op = st->op;
+
+  if (op->type == SIO_OP_RECV_MULTISHOT) {
+    if (flags & IORING_CQE_F_BUFFER) {
+      uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+      ctx->ring_pool->buffers[bid].size = res > 0 ? (size_t)res : 0;
+      sio_context_lend_buffer(ctx, op, bid);
+    }
+
+    if (flags & IORING_CQE_F_MORE) {
+      sio_context_notify(ctx, st, res);
+      return;
+    }
+  }
+
+#if defined(IORING_CQE_F_NOTIF)
+  /* The send result comes first, with IORING_CQE_F_MORE if a notification follows */
+  if (st->flags & SIO_OP_STATE_ZEROCOPY) {
+    if (flags & IORING_CQE_F_MORE) {
+      st->zerocopy_res = res;
+      if (res >= 0) {
+        sio_context_notify(ctx, st, res);
+      }
+      return;
+    }
+    if (flags & IORING_CQE_F_NOTIF) {
+      res = (int32_t)st->zerocopy_res;
+    }
+  }
+#endif
+
+  /* A timeout that ran out completes with -ETIME, which is the timer firing */
+  if (op->type == SIO_OP_TIMER && res == -ETIME) {
+    sio_context_timer_expired(ctx, st);
+    return;
+  }
+
+  if (op->type == SIO_OP_ACCEPT_MULTISHOT && (flags & IORING_CQE_F_MORE)) {
+    /* A client that could not be wrapped is dropped, the operation stays armed */
+    if (res >= 0 && uring_accept(st, res) == 0) {
+      sio_context_notify(ctx, st, 0);
+    }
+    return;
+  }
+
+  if (res >= 0) {
+    if (op->type == SIO_OP_ACCEPT || op->type == SIO_OP_ACCEPT_MULTISHOT) {
+      res = uring_accept(st, res);
+    } else if (op->type == SIO_OP_OPEN) {
+      if (sio_context_open_fill(op, res) != SIO_SUCCESS) {
+        close(res);
+        res = -EINVAL;
+      } else {
+        res = 0;
+      }
+    } else if (op->type == SIO_OP_STAT) {
+      uring_statx(op);
+    } else if (st->flags & SIO_OP_STATE_POLLED) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      if (getsockopt(st->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        err = errno;
+      }
+      res = -err;
+    }
+  }
+
+  sio_context_complete(ctx, st, res);
+}
+
+/**
+* @brief Move available CQEs to the ready list
+*
+* @param ctx Context
+* @param max_events Maximum number of operations to complete
+* @return uint32_t Number of operations completed
+*/
+static uint32_t uring_reap(sio_context_t *ctx, uint32_t max_events) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+  if (ur->ring_fd < 0) {
+    return 0;
+  }
+
+  uint32_t head = *ur->cq.head;
+  uint32_t tail = __atomic_load_n(ur->cq.tail, __ATOMIC_ACQUIRE);
+  uint32_t count = 0;
+
+  while (head != tail && count < max_events) {
+    struct io_uring_cqe *cqe = &ur->cq.cqes[head & ur->cq.mask];
+    sio_op_state_t *st = (sio_op_state_t*)(uintptr_t)cqe->user_data;
+    int32_t res = cqe->res;
+    uint32_t flags = cqe->flags;
+
+    /* Consume before handling, multishot completions run the callback in place */
+    __atomic_store_n(ur->cq.head, ++head, __ATOMIC_RELEASE);
+
+    /* The wakeup read is re-armed, the next enter submits it */
+    if ((void*)st == (void*)&ur->wake_value) {
+      ctx->woken = 1;
+      uring_wake_arm(ur);
+      continue;
+    }
+
+    /* user_data 0 marks internal requests such as cancellations */
+    if (st) {
+      uring_complete(ctx, st, res, flags);
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/**
+* @brief Check whether completions are waiting in the CQ ring
+*/
+static int uring_cq_ready(sio_context_uring_t *ur) {
+  return *ur->cq.head != __atomic_load_n(ur->cq.tail, __ATOMIC_ACQUIRE);
+}
+
+static int uring_available(void) {
+  static int available = -1;
+
+  if (available < 0) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    int fd = uring_setup(1, &p);
+    available = fd >= 0 && (p.features & IORING_FEAT_EXT_ARG) && (p.features & IORING_FEAT_NODROP);
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  return available;
+}
+
+static sio_error_t uring_init(sio_context_t *ctx, const sio_context_config_t *config) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+  sio_io_uring_config_t defaults;
+
+  ur->ring_fd = -1;
+  ur->wake_fd = -1;
+
+  const sio_io_uring_config_t *uconfig = (const sio_io_uring_config_t*)config->backend_config;
+  if (!uconfig || config->backend_config_size < sizeof(sio_io_uring_config_t)) {
+    memset(&defaults, 0, sizeof(defaults));
+    uconfig = &defaults;
+  }
+
+  sio_error_t err = uring_build(ur, uconfig);
+  if (err != SIO_SUCCESS || !(ctx->flags & SIO_CTX_THREAD_SAFE)) {
+    return err;
+  }
+
+  ur->wake_fd = eventfd(0, EFD_CLOEXEC);
+  if (ur->wake_fd < 0) {
+    err = sio_get_last_error();
+    uring_teardown(ur);
+    return err;
+  }
+  uring_wake_arm(ur);
+
+  return SIO_SUCCESS;
+}
+
+static void uring_destroy(sio_context_t *ctx) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  /* Descriptors opened or accepted by completions nobody reaped would leak with the ring (sqes is mapped last) */
+  if (ur->sq.sqes) {
+    uint32_t tail = __atomic_load_n(ur->cq.tail, __ATOMIC_ACQUIRE);
+    for (uint32_t head = *ur->cq.head; head != tail; head++) {
+      struct io_uring_cqe *cqe = &ur->cq.cqes[head & ur->cq.mask];
+      sio_op_state_t *st = (sio_op_state_t*)(uintptr_t)cqe->user_data;
+      if (!st || (void*)st == (void*)&ur->wake_value || cqe->res < 0) {
+        continue;
+      }
+      if (st->op->type == SIO_OP_OPEN || st->op->type == SIO_OP_ACCEPT || st->op->type == SIO_OP_ACCEPT_MULTISHOT) {
+        close(cqe->res);
+      }
+    }
+  }
+
+  uring_teardown(ur);
+  if (ur->wake_fd >= 0) {
+    close(ur->wake_fd);
+  }
+}
+
+static sio_error_t uring_wakeup(sio_context_t *ctx) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (eventfd_write(ur->wake_fd, 1) < 0) {
+    return sio_get_last_error();
+  }
+  return SIO_SUCCESS;
+}
+
+static sio_error_t uring_add(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  /* A full table is not an error, the stream just keeps using its descriptor */
+  if (!ur->file_free_count) {
+    return SIO_SUCCESS;
+  }
+
+  uint32_t slot = ur->file_free[ur->file_free_count - 1];
+  int32_t fd = entry->fd;
+  struct io_uring_files_update up;
+  memset(&up, 0, sizeof(up));
+  up.offset = slot;
+  up.fds = (uint64_t)(uintptr_t)&fd;
+
+  if (uring_register(ur->ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1) < 0) {
+    return sio_get_last_error();
+  }
+
+  ur->file_free_count--;
+  entry->slot = (int)slot;
+  return SIO_SUCCESS;
+}
+
+static sio_error_t uring_remove(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (entry->slot < 0) {
+    return SIO_SUCCESS;
+  }
+
+  /* In-flight requests hold their own file reference, clearing the slot is safe */
+  int32_t fd = -1;
+  struct io_uring_files_update up;
+  memset(&up, 0, sizeof(up));
+  up.offset = (uint32_t)entry->slot;
+  up.fds = (uint64_t)(uintptr_t)&fd;
+  uring_register(ur->ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+
+  ur->file_free[ur->file_free_count++] = (uint32_t)entry->slot;
+  entry->slot = -1;
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Successor of an operation that the kernel runs as part of its chain
+*
+* A failed sync or file system call completes with an error but does not fail
+* the kernel link, so what follows one stays held and the generic layer starts
+* it once the call succeeded.
+*/
+static sio_op_state_t *uring_kernel_link(const sio_op_state_t *st) {
+  return sio_context_op_blocks(st->op) ? NULL : st->link;
+}
+
+static sio_error_t uring_submit(sio_context_t *ctx, sio_op_state_t *st) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (ur->ring_fd < 0) {
+    return ur->broken;
+  }
+
+  /* A linked chain has to reach the kernel in one submission */
+  uint32_t count = 0;
+  for (sio_op_state_t *s = st; s; s = uring_kernel_link(s)) {
+    count++;
+  }
+  if (count > ur->sq.entries) {
+    return SIO_ERROR_PARAM; /* Could never fit */
+  }
+  if (!uring_sq_reserve(ur, count)) {
+    return SIO_ERROR_BUSY;
+  }
+
+  for (sio_op_state_t *s = st; s; s = uring_kernel_link(s)) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ur);
+    uring_prep_op(ctx, s, sqe);
+    if (uring_kernel_link(s)) {
+      sqe->flags |= IOSQE_IO_LINK;
+    }
+    s->flags = (s->flags & ~(uint32_t)SIO_OP_STATE_HELD) | SIO_OP_STATE_STARTED;
+  }
+
+  return SIO_SUCCESS;
+}
+
+static void uring_flush(sio_context_t *ctx) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  /* Errors leave the SQEs in the ring, they are retried by the next wait */
+  if (ur->ring_fd >= 0) {
+    uring_submit_pending(ur);
+  }
+}
+
+static sio_error_t uring_cancel(sio_context_t *ctx, sio_op_state_t *st) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (ur->ring_fd < 0) {
+    return ur->broken;
+  }
+
+  struct io_uring_sqe *sqe = uring_get_sqe(ur);
+  if (!sqe) {
+    return SIO_ERROR_BUSY;
+  }
+
+  /* The operation itself completes with -ECANCELED (or its result if it won the race) */
+  uring_prep(sqe, IORING_OP_ASYNC_CANCEL, -1, st, 0, 0);
+  sqe->user_data = 0;
+
+  return uring_submit_pending(ur);
+}
+
+static sio_error_t uring_cancel_stream(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (!ur->cancel_fd || ur->ring_fd < 0) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+
+  struct io_uring_sqe *sqe = uring_get_sqe(ur);
+  if (!sqe) {
+    return SIO_ERROR_BUSY;
+  }
+
+  /* Matches on the file, so operations issued through the fixed slot are included */
+  uring_prep(sqe, IORING_OP_ASYNC_CANCEL, entry->fd, NULL, 0, 0);
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  sqe->user_data = 0;
+
+  return uring_submit_pending(ur);
+}
+
+static sio_wait_result_t uring_poll(sio_context_t *ctx, uint64_t timeout_ms, uint32_t max_events) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (ur->ring_fd < 0) {
+    return ctx->ready_count ? SIO_WAIT_COMPLETED : SIO_WAIT_ERROR;
+  }
+
+  uint32_t wakeup;
+  uint32_t to_submit = uring_sq_publish(ur, &wakeup);
+  int overflow = (__atomic_load_n(ur->sq.flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0;
+  int block = !ctx->ready_count && !uring_cq_ready(ur) && timeout_ms != 0;
+  sio_wait_result_t result = SIO_WAIT_COMPLETED;
+
+  if (overflow) {
+    ctx->stats.cq_overflows++;
+  }
+
+  if (to_submit || overflow || block) {
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    uint32_t flags = IORING_ENTER_EXT_ARG | wakeup;
+
+    memset(&arg, 0, sizeof(arg));
+    if (block || overflow) {
+      flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (block && timeout_ms != SIO_WAIT_FOREVER) {
+      ts.tv_sec = (long long)(timeout_ms / 1000);
+      ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+      arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    ctx->stats.syscalls++;
+    sio_context_trace(ctx, SIO_TRACE_ENTER, NULL, ur->ring_fd, to_submit);
+    int ret = uring_enter(ur->ring_fd, to_submit, block ? 1 : 0, flags, &arg, sizeof(arg));
+    if (ret < 0) {
+      switch (errno) {
+        case ETIME:
+          result = SIO_WAIT_TIMEOUT;
+          break;
+        case EINTR:
+          result = SIO_WAIT_INTERRUPTED;
+          break;
+        case EBUSY:
+        case EAGAIN:
+          break; /* CQ overflow backlog, reaping below makes room */
+        default:
+          result = SIO_WAIT_ERROR;
+          break;
+      }
+    }
+  }
+
+  uring_reap(ctx, max_events);
+
+  if (ctx->ready_count) {
+    return SIO_WAIT_COMPLETED;
+  }
+  return result == SIO_WAIT_COMPLETED ? SIO_WAIT_TIMEOUT : result;
+}
+
+static sio_error_t uring_register_buffers(sio_context_t *ctx, const sio_buffer_pool_t *pool) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  /* SQEs address registered buffers with a 16 bit index */
+  if (pool->capacity > UINT16_MAX) {
+    return SIO_ERROR_PARAM;
+  }
+
+  struct iovec *iov = (struct iovec*)malloc(pool->capacity * sizeof(struct iovec));
+  if (!iov) {
+    return SIO_ERROR_MEM;
+  }
+
+  for (size_t i = 0; i < pool->capacity; i++) {
+    iov[i].iov_base = pool->buffers[i].data;
+    iov[i].iov_len = pool->buffers[i].capacity;
+  }
+
+  int ret = uring_register(ur->ring_fd, IORING_REGISTER_BUFFERS, iov, (uint32_t)pool->capacity);
+  sio_error_t err = ret < 0 ? sio_get_last_error() : SIO_SUCCESS;
+
+  free(iov);
+  return err;
+}
+
+static void uring_unregister_buffers(sio_context_t *ctx) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+  uring_register(ur->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+}
+
+/**
+* @brief Add a pool buffer to the provided buffer ring (published by uring_buf_ring_publish)
+*/
+static void uring_buf_ring_add(sio_context_uring_t *ur, const sio_buffer_t *buf, uint16_t bid) {
+  struct io_uring_buf *slot = &ur->buf_ring->bufs[ur->buf_ring_tail & ur->buf_ring_mask];
+  slot->addr = (uint64_t)(uintptr_t)buf->data;
+  slot->len = (uint32_t)buf->capacity;
+  slot->bid = bid;
+  ur->buf_ring_tail++;
+}
+
+static void uring_buf_ring_publish(sio_context_uring_t *ur) {
+  __atomic_store_n(&ur->buf_ring->tail, ur->buf_ring_tail, __ATOMIC_RELEASE);
+}
+
+static sio_error_t uring_register_buffer_ring(sio_context_t *ctx, const sio_buffer_pool_t *pool) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  uint32_t entries = 1;
+  while (entries < pool->capacity) {
+    entries <<= 1;
+  }
+
+  long page = sysconf(_SC_PAGESIZE);
+  size_t size = entries * sizeof(struct io_uring_buf);
+  size = (size + (size_t)page - 1) & ~((size_t)page - 1);
+
+  void *ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    return sio_get_last_error();
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)ring;
+  reg.ring_entries = entries;
+  reg.bgid = SIO_URING_BUFFER_GROUP;
+
+  if (uring_register(ur->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    sio_error_t err = errno == EINVAL ? SIO_ERROR_UNSUPPORTED : sio_get_last_error();
+    munmap(ring, size);
+    return err;
+  }
+
+  ur->buf_ring = (struct io_uring_buf_ring*)ring;
+  ur->buf_ring_size = size;
+  ur->buf_ring_mask = entries - 1;
+  ur->buf_ring_tail = 0;
+
+  /* The kernel ring holds every buffer that is not lent out */
+  for (size_t i = 0; i < pool->capacity; i++) {
+    if (!ctx->ring_lent[i]) {
+      uring_buf_ring_add(ur, &pool->buffers[i], (uint16_t)i);
+    }
+  }
+  uring_buf_ring_publish(ur);
+  ctx->ring_free_count = 0;
+
+  return SIO_SUCCESS;
+}
+
+static void uring_unregister_buffer_ring(sio_context_t *ctx) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (!ur->buf_ring) {
+    return;
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.bgid = SIO_URING_BUFFER_GROUP;
+  uring_register(ur->ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+  munmap(ur->buf_ring, ur->buf_ring_size);
+  ur->buf_ring = NULL;
+}
+
+static void uring_recycle_buffer(sio_context_t *ctx, uint16_t buffer_id) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (!ur->buf_ring) {
+    return;
+  }
+
+  uring_buf_ring_add(ur, &ctx->ring_pool->buffers[buffer_id], buffer_id);
+  uring_buf_ring_publish(ur);
+}
+
+static sio_error_t uring_configure(sio_context_t *ctx, const void *config, size_t config_size) {
+  sio_context_uring_t *ur = (sio_context_uring_t*)ctx;
+
+  if (config_size < sizeof(sio_io_uring_config_t)) {
+    return SIO_ERROR_PARAM;
+  }
+
+  /* Rebuilding the ring would drop in-flight requests */
+  if (ctx->pending) {
+    return SIO_ERROR_BUSY;
+  }
+
+  sio_io_uring_config_t previous = ur->config;
+  uring_teardown(ur);
+
+  /* Fixed file slots went with the old ring */
+  for (size_t i = 0; i < ctx->entry_capacity; i++) {
+    if (ctx->entries[i]) {
+      ctx->entries[i]->slot = -1;
+    }
+  }
+
+  sio_error_t err = uring_build(ur, (const sio_io_uring_config_t*)config);
+  if (err != SIO_SUCCESS) {
+    /* Without the old ring either, every call fails with this until a configuration builds */
+    sio_error_t rebuild = uring_build(ur, &previous);
+    if (rebuild != SIO_SUCCESS) {
+      ur->broken = rebuild;
+      return rebuild;
+    }
+  }
+  ur->broken = SIO_SUCCESS;
+
+  /* Registrations belong to the old ring and have to be repeated */
+  if (ctx->fixed_pool) {
+    uring_register_buffers(ctx, ctx->fixed_pool);
+  }
+  if (ctx->ring_pool) {
+    uring_register_buffer_ring(ctx, ctx->ring_pool);
+  }
+
+  for (size_t i = 0; i < ctx->entry_capacity; i++) {
+    if (ctx->entries[i]) {
+      uring_add(ctx, ctx->entries[i]);
+    }
+  }
+
+  if (ur->wake_fd >= 0) {
+    uring_wake_arm(ur);
+  }
+
+  return err;
+}
+
+const sio_context_backend_ops_t sio_context_io_uring_ops = {
+  .type = SIO_CONTEXT_IO_URING,
+  .context_size = sizeof(sio_context_uring_t),
+  .available = uring_available,
+  .init = uring_init,
+  .destroy = uring_destroy,
+  .add = uring_add,
+  .remove = uring_remove,
+  .submit = uring_submit,
+  .flush = uring_flush,
+  .cancel = uring_cancel,
+  .cancel_stream = uring_cancel_stream,
+  .poll = uring_poll,
+  .peek = uring_reap, /* The CQ ring is mapped, reading it needs no syscall */
+  .wakeup = uring_wakeup,
+  .configure = uring_configure,
+  .register_buffers = uring_register_buffers,
+  .unregister_buffers = uring_unregister_buffers,
+  .register_buffer_ring = uring_register_buffer_ring,
+  .unregister_buffer_ring = uring_unregister_buffer_ring,
+  .recycle_buffer = uring_recycle_buffer
+};
+
+#endif /* SIO_OS_LINUX */
@@ -0,0 +1,380 @@
+/**
+* @file src/context/poll.c
+* @brief Portable poll() and select() backends for the I/O context
+*
+* Fallbacks for systems where neither io_uring nor epoll can be used, for
+* example containers whose seccomp profile blocks io_uring. Both share the
+* readiness reactor (src/context/reactor.h) and a dense array of registered
+* descriptors: entry->slot is the index of the stream's pollfd, so removal
+* swaps the last pollfd into the hole in O(1).
+*
+* poll() and select() are level-triggered, so before each wait only the
+* directions that have queued operations and last hit EAGAIN are asked for.
+* The select() backend is limited to descriptors below FD_SETSIZE. The wakeup
+* descriptor rides in the slot after the last stream.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/context.h>
+#include <sio/err.h>
+#include <src/context/backend.h>
+#include <src/context/reactor.h>
+
+#if defined(SIO_OS_POSIX)
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/select.h>
+
+#define SIO_POLL_INITIAL_CAPACITY 16
+
+/**
+* @brief poll() / select() backend context
+*/
+typedef struct sio_context_poll {
+  sio_context_reactor_t reactor; /**< Readiness reactor (must be first) */
+  struct pollfd *fds;            /**< Dense pollfd array, indexed by entry->slot, plus the wakeup slot */
+  sio_context_entry_t **owners;  /**< Entry owning each pollfd */
+  uint32_t count;                /**< Number of registered descriptors */
+  uint32_t capacity;             /**< Size of the fds and owners arrays */
+} sio_context_poll_t;
+
+/**
+* @brief Grow the pollfd and owner arrays to hold at least a number of slots
+*/
+static sio_error_t poll_reserve(sio_context_poll_t *pl, uint32_t slots) {
+  if (slots <= pl->capacity) {
+    return SIO_SUCCESS;
+  }
+
+  uint32_t capacity = pl->capacity ? pl->capacity * 2 : SIO_POLL_INITIAL_CAPACITY;
+  while (capacity < slots) {
+    capacity *= 2;
+  }
+
+  struct pollfd *fds = (struct pollfd*)realloc(pl->fds, capacity * sizeof(struct pollfd));
+  if (!fds) {
+    return SIO_ERROR_MEM;
+  }
+  pl->fds = fds;
+
+  sio_context_entry_t **owners = (sio_context_entry_t**)realloc(pl->owners, capacity * sizeof(sio_context_entry_t*));
+  if (!owners) {
+    return SIO_ERROR_MEM;
+  }
+  pl->owners = owners;
+  pl->capacity = capacity;
+
+  return SIO_SUCCESS;
+}
+
+static sio_error_t poll_init(sio_context_t *ctx, const sio_context_config_t *config) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+  (void)config;
+
+  /* poll() reports POLLERR for any armed descriptor, select() has no set for the error queue */
+  pl->reactor.zerocopy = ctx->ops->type == SIO_CONTEXT_POLL;
+
+  sio_error_t err = sio_context_reactor_wake_open(ctx);
+  if (err == SIO_SUCCESS) {
+    err = poll_reserve(pl, 1);
+  }
+  if (err != SIO_SUCCESS) {
+    sio_context_reactor_wake_close(ctx);
+    free(pl->fds);
+    free(pl->owners);
+  }
+  return err;
+}
+
+static void poll_destroy(sio_context_t *ctx) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+
+  free(pl->fds);
+  free(pl->owners);
+  sio_context_reactor_wake_close(ctx);
+}
+
+static sio_error_t poll_add(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+
+  sio_error_t err = sio_context_reactor_set_nonblock(entry->fd);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  /* Keep the slot after the last stream free for the wakeup descriptor */
+  err = poll_reserve(pl, pl->count + 2);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  pl->fds[pl->count].fd = entry->fd;
+  pl->fds[pl->count].events = 0;
+  pl->fds[pl->count].revents = 0;
+  pl->owners[pl->count] = entry;
+  entry->slot = (int)pl->count++;
+
+  /* Assume ready until EAGAIN says otherwise, so the first operation is tried right away */
+  entry->ready = SIO_READY_IN | SIO_READY_OUT;
+  return SIO_SUCCESS;
+}
+
+static sio_error_t poll_remove(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+
+  sio_context_reactor_forget(ctx, entry);
+
+  /* Swap the last descriptor into the hole */
+  uint32_t slot = (uint32_t)entry->slot;
+  uint32_t last = --pl->count;
+  if (slot != last) {
+    pl->fds[slot] = pl->fds[last];
+    pl->owners[slot] = pl->owners[last];
+    pl->owners[slot]->slot = (int)slot;
+  }
+  entry->slot = -1;
+
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Set the interest of every pollfd from the queued operations
+*
+* Descriptors without interest get a negative fd so that poll() skips them
+* even when they report POLLHUP. Sockets with zero-copy sends waiting for their
+* release stay armed without events, for the POLLERR of the error queue. The
+* wakeup descriptor is put in the slot after the last stream.
+*
+* @return uint32_t Number of pollfds to wait on
+*/
+static uint32_t poll_arm(sio_context_poll_t *pl) {
+  for (uint32_t i = 0; i < pl->count; i++) {
+    sio_context_entry_t *entry = pl->owners[i];
+    short events = 0;
+
+    if (entry->in.head && !(entry->ready & SIO_READY_IN)) {
+      events |= POLLIN;
+    }
+    if (entry->out.head && !(entry->ready & SIO_READY_OUT)) {
+      events |= POLLOUT;
+    }
+
+    pl->fds[i].fd = events || entry->zerocopy.head ? entry->fd : -1;
+    pl->fds[i].events = events;
+    pl->fds[i].revents = 0;
+  }
+
+  if (pl->reactor.wake_fd[0] < 0) {
+    return pl->count;
+  }
+
+  pl->fds[pl->count].fd = pl->reactor.wake_fd[0];
+  pl->fds[pl->count].events = POLLIN;
+  pl->fds[pl->count].revents = 0;
+  return pl->count + 1;
+}
+
+/**
+* @brief Record readiness reported for a pollfd and queue its entry for draining
+*/
+static void poll_ready(sio_context_t *ctx, sio_context_entry_t *entry, short revents) {
+  if (revents & (POLLIN | POLLHUP | POLLERR)) {
+    entry->ready |= SIO_READY_IN;
+  }
+  if (revents & (POLLOUT | POLLHUP | POLLERR)) {
+    entry->ready |= SIO_READY_OUT;
+  }
+  if (revents & POLLERR) {
+    entry->ready |= SIO_READY_ERR;
+  }
+  sio_context_reactor_mark_dirty(ctx, entry);
+}
+
+static sio_wait_result_t poll_wait(sio_context_t *ctx, uint64_t timeout_ms, uint32_t max_events) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+  (void)max_events;
+
+  sio_context_reactor_flush(ctx);
+
+  if (ctx->ready_count || pl->reactor.dirty) {
+    timeout_ms = 0;
+  }
+
+  uint32_t nfds = poll_arm(pl);
+  ctx->stats.syscalls++;
+  sio_context_trace(ctx, SIO_TRACE_ENTER, NULL, -1, 0);
+  int n = poll(pl->fds, nfds, sio_context_reactor_timeout(timeout_ms));
+  if (n < 0) {
+    if (ctx->ready_count) {
+      return SIO_WAIT_COMPLETED;
+    }
+    return errno == EINTR ? SIO_WAIT_INTERRUPTED : SIO_WAIT_ERROR;
+  }
+
+  if (nfds > pl->count && pl->fds[pl->count].revents) {
+    sio_context_reactor_wake_drain(ctx);
+    n--;
+  }
+
+  /* Only record readiness here, multishot callbacks in the drain may remove entries */
+  for (uint32_t i = 0; i < pl->count && n > 0; i++) {
+    if (pl->fds[i].revents) {
+      poll_ready(ctx, pl->owners[i], pl->fds[i].revents);
+      n--;
+    }
+  }
+
+  sio_context_reactor_flush(ctx);
+
+  return ctx->ready_count ? SIO_WAIT_COMPLETED : SIO_WAIT_TIMEOUT;
+}
+
+static sio_error_t select_init(sio_context_t *ctx, const sio_context_config_t *config) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+
+  sio_error_t err = poll_init(ctx, config);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  /* The wakeup descriptor goes into the fd_sets like any stream */
+  if (pl->reactor.wake_fd[0] >= FD_SETSIZE) {
+    poll_destroy(ctx);
+    return SIO_ERROR_UNSUPPORTED;
+  }
+  return SIO_SUCCESS;
+}
+
+static sio_error_t select_add(sio_context_t *ctx, sio_context_entry_t *entry) {
+  if (entry->fd >= FD_SETSIZE) {
+    return SIO_ERROR_UNSUPPORTED;
+  }
+  return poll_add(ctx, entry);
+}
+
+static sio_wait_result_t select_wait(sio_context_t *ctx, uint64_t timeout_ms, uint32_t max_events) {
+  sio_context_poll_t *pl = (sio_context_poll_t*)ctx;
+  (void)max_events;
+
+  sio_context_reactor_flush(ctx);
+
+  if (ctx->ready_count || pl->reactor.dirty) {
+    timeout_ms = 0;
+  }
+
+  fd_set rfds, wfds;
+  int maxfd = -1;
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+
+  uint32_t nfds = poll_arm(pl);
+  for (uint32_t i = 0; i < nfds; i++) {
+    if (pl->fds[i].events & POLLIN) {
+      FD_SET(pl->fds[i].fd, &rfds);
+    }
+    if (pl->fds[i].events & POLLOUT) {
+      FD_SET(pl->fds[i].fd, &wfds);
+    }
+    if (pl->fds[i].fd > maxfd) {
+      maxfd = pl->fds[i].fd;
+    }
+  }
+
+  struct timeval tv;
+  struct timeval *tvp = NULL;
+  if (timeout_ms != SIO_WAIT_FOREVER) {
+    tv.tv_sec = (time_t)(timeout_ms / 1000);
+    tv.tv_usec = (suseconds_t)(timeout_ms % 1000) * 1000;
+    tvp = &tv;
+  }
+
+  ctx->stats.syscalls++;
+  sio_context_trace(ctx, SIO_TRACE_ENTER, NULL, -1, 0);
+  int n = select(maxfd + 1, &rfds, &wfds, NULL, tvp);
+  if (n < 0) {
+    if (ctx->ready_count) {
+      return SIO_WAIT_COMPLETED;
+    }
+    return errno == EINTR ? SIO_WAIT_INTERRUPTED : SIO_WAIT_ERROR;
+  }
+
+  if (nfds > pl->count && FD_ISSET(pl->fds[pl->count].fd, &rfds)) {
+    sio_context_reactor_wake_drain(ctx);
+    n--;
+  }
+
+  for (uint32_t i = 0; i < pl->count && n > 0; i++) {
+    int fd = pl->fds[i].fd;
+    short revents = 0;
+
+    if (fd < 0) {
+      continue;
+    }
+    if (FD_ISSET(fd, &rfds)) {
+      revents |= POLLIN;
+    }
+    if (FD_ISSET(fd, &wfds)) {
+      revents |= POLLOUT;
+    }
+    if (revents) {
+      poll_ready(ctx, pl->owners[i], revents);
+      n--;
+    }
+  }
+
+  sio_context_reactor_flush(ctx);
+
+  return ctx->ready_count ? SIO_WAIT_COMPLETED : SIO_WAIT_TIMEOUT;
+}
+
+const sio_context_backend_ops_t sio_context_poll_ops = {
+  .type = SIO_CONTEXT_POLL,
+  .context_size = sizeof(sio_context_poll_t),
+  .available = NULL,
+  .init = poll_init,
+  .destroy = poll_destroy,
+  .add = poll_add,
+  .remove = poll_remove,
+  .submit = sio_context_reactor_submit,
+  .flush = sio_context_reactor_flush,
+  .cancel = sio_context_reactor_cancel,
+  .cancel_stream = NULL, /* Queued operations are dropped one by one without a syscall */
+  .poll = poll_wait,
+  .peek = NULL, /* Readiness has to be asked for with a syscall */
+  .wakeup = sio_context_reactor_wakeup,
+  .configure = NULL, /* No poll specific options */
+  .register_buffers = NULL, /* Readiness based, buffers are only touched by plain syscalls */
+  .unregister_buffers = NULL,
+  .register_buffer_ring = NULL, /* Provided buffers come from the generic free list */
+  .unregister_buffer_ring = NULL,
+  .recycle_buffer = NULL
+};
+
+const sio_context_backend_ops_t sio_context_select_ops = {
+  .type = SIO_CONTEXT_SELECT,
+  .context_size = sizeof(sio_context_poll_t),
+  .available = NULL,
+  .init = select_init,
+  .destroy = poll_destroy,
+  .add = select_add,
+  .remove = poll_remove,
+  .submit = sio_context_reactor_submit,
+  .flush = sio_context_reactor_flush,
+  .cancel = sio_context_reactor_cancel,
+  .cancel_stream = NULL, /* Queued operations are dropped one by one without a syscall */
+  .poll = select_wait,
+  .peek = NULL, /* Readiness has to be asked for with a syscall */
+  .wakeup = sio_context_reactor_wakeup,
+  .configure = NULL, /* No select specific options */
+  .register_buffers = NULL, /* Readiness based, buffers are only touched by plain syscalls */
+  .unregister_buffers = NULL,
+  .register_buffer_ring = NULL, /* Provided buffers come from the generic free list */
+  .unregister_buffer_ring = NULL,
+  .recycle_buffer = NULL
+};
+
+#endif /* SIO_OS_POSIX */
@@ -0,0 +1,563 @@
+/**
+* @file src/context/reactor.c
+* @brief Readiness reactor shared by the epoll, poll() and select() backends
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/context.h>
+#include <sio/err.h>
+#include <src/context/reactor.h>
+
+#if defined(SIO_OS_POSIX)
+
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#if defined(SIO_OS_LINUX)
+  #include <string.h>
+  #include <sys/eventfd.h>
+  #include <linux/errqueue.h>
+#endif
+
+/* The kernel reports MSG_ZEROCOPY buffer releases on the socket error queue */
+#if defined(SIO_OS_LINUX) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  #define SIO_REACTOR_ZEROCOPY 1
+#endif
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0
+#endif
+
+int sio_context_reactor_timeout(uint64_t timeout_ms) {
+  if (timeout_ms == SIO_WAIT_FOREVER) {
+    return -1;
+  }
+  return timeout_ms > (uint64_t)INT_MAX ? INT_MAX : (int)timeout_ms;
+}
+
+int sio_context_reactor_op_is_input(const sio_op_t *op) {
+  return op->type == SIO_OP_READ || op->type == SIO_OP_ACCEPT || op->type == SIO_OP_RECV_MULTISHOT || op->type == SIO_OP_ACCEPT_MULTISHOT ||
+         op->type == SIO_OP_READ_AT || op->type == SIO_OP_READV_AT;
+}
+
+sio_error_t sio_context_reactor_set_nonblock(int fd) {
+  int fl = fcntl(fd, F_GETFL);
+  if (fl < 0) {
+    return sio_get_last_error();
+  }
+  if (!(fl & O_NONBLOCK) && fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0) {
+    return sio_get_last_error();
+  }
+  return SIO_SUCCESS;
+}
+
+#if defined(SIO_REACTOR_ZEROCOPY)
+
+/**
+* @brief Finish the zero-copy sends whose buffer release the error queue reports
+*
+* A notification covers the inclusive range of sequence numbers ee_info to
+* ee_data. Finished sends go to the ready list, no callback runs.
+*/
+static void reactor_zerocopy_reap(sio_context_t *ctx, sio_context_entry_t *entry) {
+  char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_storage))];
+
+  while (entry->zerocopy.head) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ctx->stats.syscalls++;
+    if (recvmsg(entry->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err ee;
+      if (cm->cmsg_len < CMSG_LEN(sizeof(ee))) {
+        continue;
+      }
+      memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+      if (ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+
+      sio_op_state_t *st = entry->zerocopy.head;
+      while (st) {
+        sio_op_state_t *next = st->next;
+        /* Sequence numbers wrap, so the range is compared by distance */
+        if (st->zerocopy_id - ee.ee_info <= ee.ee_data - ee.ee_info) {
+          sio_op_queue_remove(&entry->zerocopy, st);
+          sio_context_complete(ctx, st, st->zerocopy_res);
+        }
+        st = next;
+      }
+    }
+  }
+}
+
+#endif /* SIO_REACTOR_ZEROCOPY */
+
+void sio_context_reactor_mark_dirty(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+
+  if (!entry->dirty) {
+    entry->dirty = 1;
+    entry->dirty_next = r->dirty;
+    r->dirty = entry;
+  }
+}
+
+void sio_context_reactor_forget(sio_context_t *ctx, sio_context_entry_t *entry) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+
+  if (entry->dirty) {
+    sio_context_entry_t **link = &r->dirty;
+    while (*link != entry) {
+      link = &(*link)->dirty_next;
+    }
+    *link = entry->dirty_next;
+    entry->dirty = 0;
+  }
+
+#if defined(SIO_REACTOR_ZEROCOPY)
+  /* Nobody watches the error queue any more, so the remaining sends finish now */
+  if (entry->zerocopy.head) {
+    reactor_zerocopy_reap(ctx, entry);
+    sio_op_state_t *st;
+    while ((st = entry->zerocopy.head) != NULL) {
+      sio_op_queue_remove(&entry->zerocopy, st);
+      sio_context_complete(ctx, st, st->zerocopy_res);
+    }
+  }
+#endif
+}
+
+sio_error_t sio_context_reactor_wake_open(sio_context_t *ctx) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+
+  /* Opened even without SIO_CTX_THREAD_SAFE, offload threads wake the owner through it */
+  r->wake_fd[0] = r->wake_fd[1] = -1;
+
+#if defined(SIO_OS_LINUX)
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    return sio_get_last_error();
+  }
+  r->wake_fd[0] = r->wake_fd[1] = fd;
+#else
+  if (pipe(r->wake_fd) < 0) {
+    return sio_get_last_error();
+  }
+  for (int i = 0; i < 2; i++) {
+    fcntl(r->wake_fd[i], F_SETFL, fcntl(r->wake_fd[i], F_GETFL) | O_NONBLOCK);
+    fcntl(r->wake_fd[i], F_SETFD, FD_CLOEXEC);
+  }
+#endif
+
+  return SIO_SUCCESS;
+}
+
+void sio_context_reactor_wake_close(sio_context_t *ctx) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+
+  if (r->wake_fd[0] >= 0) {
+    close(r->wake_fd[0]);
+  }
+  if (r->wake_fd[1] >= 0 && r->wake_fd[1] != r->wake_fd[0]) {
+    close(r->wake_fd[1]);
+  }
+  r->wake_fd[0] = r->wake_fd[1] = -1;
+}
+
+void sio_context_reactor_wake_drain(sio_context_t *ctx) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+  uint64_t buf[8];
+
+  /* An eventfd read resets the counter, a pipe is read until empty */
+  while (read(r->wake_fd[0], buf, sizeof(buf)) == (ssize_t)sizeof(buf)) {
+  }
+  ctx->woken = 1;
+}
+
+sio_error_t sio_context_reactor_wakeup(sio_context_t *ctx) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+  uint64_t one = 1;
+
+  /* EAGAIN means the descriptor is already readable, which is all that is needed */
+  if (write(r->wake_fd[1], &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    return sio_get_last_error();
+  }
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Accept one pending connection as a non-blocking, close-on-exec descriptor
+*
+* @param fd Listening descriptor
+* @param addr Receives the client address, or NULL to skip it
+* @return int Descriptor or -1 with errno set
+*/
+static int reactor_accept(int fd, sio_addr_t *addr) {
+  struct sockaddr *sa = NULL;
+  socklen_t *len = NULL;
+
+  if (addr) {
+    addr->len = sizeof(addr->addr.ss);
+    sa = &addr->addr.sa;
+    len = &addr->len;
+  }
+#if defined(SIO_OS_LINUX) || defined(SIO_OS_BSD)
+  return accept4(fd, sa, len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  int cfd = accept(fd, sa, len);
+  if (cfd >= 0) {
+    fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+    fcntl(cfd, F_SETFD, FD_CLOEXEC);
+  }
+  return cfd;
+#endif
+}
+
+/**
+* @brief Attempt a queued operation without blocking
+*
+* @param st Operation state
+* @return int64_t Result in kernel convention, -EAGAIN if the stream is not ready
+*/
+static int64_t reactor_try_op(sio_op_state_t *st) {
+  sio_op_t *op = st->op;
+  int is_socket = op->stream->type == SIO_STREAM_SOCKET;
+  ssize_t n;
+
+  switch (op->type) {
+    case SIO_OP_READ:
+      do {
+        n = is_socket ? recv(st->fd, op->buffer, op->size, MSG_DONTWAIT) : read(st->fd, op->buffer, op->size);
+      } while (n < 0 && errno == EINTR);
+      return n < 0 ? -errno : n;
+
+    case SIO_OP_WRITE:
+      do {
+        n = is_socket ? send(st->fd, op->buffer, op->size, MSG_DONTWAIT | MSG_NOSIGNAL) : write(st->fd, op->buffer, op->size);
+      } while (n < 0 && errno == EINTR);
+      return n < 0 ? -errno : n;
+
+    case SIO_OP_READ_AT:
+      do {
+        n = pread(st->fd, op->buffer, op->size, (off_t)op->offset);
+      } while (n < 0 && errno == EINTR);
+      return n < 0 ? -errno : n;
+
+    case SIO_OP_WRITE_AT:
+      do {
+        n = pwrite(st->fd, op->buffer, op->size, (off_t)op->offset);
+      } while (n < 0 && errno == EINTR);
+      return n < 0 ? -errno : n;
+
+    case SIO_OP_READV_AT:
+      do {
+        n = preadv(st->fd, (const struct iovec*)op->buffer, (int)op->size, (off_t)op->offset);
+      } while (n < 0 && errno == EINTR);
+      return n < 0 ? -errno : n;
+
+    case SIO_OP_WRITEV_AT:
+      do {
+        n = pwritev(st->fd, (const struct iovec*)op->buffer, (int)op->size, (off_t)op->offset);
+      } while (n < 0 && errno == EINTR);
+      return n < 0 ? -errno : n;
+
+    case SIO_OP_ACCEPT:
+    case SIO_OP_ACCEPT_MULTISHOT: {
+      sio_accept_result_t *res = (sio_accept_result_t*)op->buffer;
+      sio_addr_t *addr = op->size >= sizeof(*res) ? &res->addr : NULL;
+      int fd;
+
+      for (;;) {
+        fd = reactor_accept(st->fd, addr);
+        if (fd >= 0 || (errno != EINTR && errno != ECONNABORTED)) {
+          break;
+        }
+      }
+
+      if (fd < 0) {
+        return -errno;
+      }
+
+      if (sio_context_accept_fill(op->stream, op, fd) != SIO_SUCCESS) {
+        close(fd);
+        return -EINVAL;
+      }
+      return 0;
+    }
+
+    case SIO_OP_CONNECT: {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      if (getsockopt(st->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        return -errno;
+      }
+      if (err) {
+        return -err;
+      }
+
+      /* Writable without error but not yet connected means the edge was stale */
+      struct sockaddr_storage peer;
+      len = sizeof(peer);
+      if (getpeername(st->fd, (struct sockaddr*)&peer, &len) < 0) {
+        return errno == ENOTCONN ? -EAGAIN : -errno;
+      }
+      return 0;
+    }
+
+    default:
+      return -EINVAL;
+  }
+}
+
+/**
+* @brief Receive once into a provided buffer for a multishot receive
+*
+* @param ctx Context
+* @param st Operation state
+* @param res Receives the final result when the operation ends
+* @return int Non-zero if data was delivered and the operation stays pending
+*/
+static int reactor_recv_multishot(sio_context_t *ctx, sio_op_state_t *st, int64_t *res) {
+  int bid = sio_context_ring_take(ctx);
+  if (bid < 0) {
+    *res = -ENOBUFS;
+    return 0;
+  }
+
+  sio_buffer_t *buf = &ctx->ring_pool->buffers[bid];
+  ssize_t n;
+  do {
+    n = st->op->stream->type == SIO_STREAM_SOCKET
+      ? recv(st->fd, buf->data, buf->capacity, MSG_DONTWAIT)
+      : read(st->fd, buf->data, buf->capacity);
+  } while (n < 0 && errno == EINTR);
+
+  if (n <= 0) {
+    sio_context_ring_put(ctx, (uint16_t)bid);
+    *res = n < 0 ? -errno : 0;
+    return 0;
+  }
+
+  buf->size = (size_t)n;
+  sio_context_lend_buffer(ctx, st->op, (uint16_t)bid);
+  sio_context_notify(ctx, st, n);
+  return 1;
+}
+
+#if defined(SIO_REACTOR_ZEROCOPY)
+
+/**
+* @brief Send a write with MSG_ZEROCOPY
+*
+* @param ctx Context
+* @param entry Entry of the socket
+* @param st Write operation state, at the head of the output queue
+* @param res Receives the result when the write completes right away
+* @return int Non-zero if the first completion was delivered and the write waits for its release
+*/
+static int reactor_send_zerocopy(sio_context_t *ctx, sio_context_entry_t *entry, sio_op_state_t *st, int64_t *res) {
+  sio_op_t *op = st->op;
+  ssize_t n;
+
+  do {
+    n = send(st->fd, op->buffer, op->size, MSG_DONTWAIT | MSG_NOSIGNAL | MSG_ZEROCOPY);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0) {
+    /* Out of option memory for pending notifications, this one is copied */
+    if (errno == ENOBUFS) {
+      ctx->stats.syscalls++;
+      *res = reactor_try_op(st);
+    } else {
+      *res = -errno;
+    }
+    return 0;
+  }
+
+  /* Every successful MSG_ZEROCOPY send takes the next sequence number of the socket */
+  sio_op_queue_remove(&entry->out, st);
+  st->flags = (st->flags & ~(uint32_t)SIO_OP_STATE_QUEUED) | SIO_OP_STATE_ZEROCOPY;
+  st->zerocopy_id = entry->zerocopy_next++;
+  st->zerocopy_res = n;
+  sio_op_queue_push(&entry->zerocopy, st);
+  sio_context_notify(ctx, st, n);
+  return 1;
+}
+
+#endif /* SIO_REACTOR_ZEROCOPY */
+
+/**
+* @brief Run queued operations of one direction until the queue empties or EAGAIN
+*
+* @return int Non-zero if a callback ran, after which the entry must not be touched
+*/
+static int reactor_drain_queue(sio_context_t *ctx, sio_context_entry_t *entry, sio_op_queue_t *queue, uint32_t ready_bit) {
+  sio_op_state_t *st;
+
+  while ((entry->ready & ready_bit) && (st = queue->head) != NULL) {
+    int64_t res;
+
+    ctx->stats.syscalls++;
+
+    if (st->op->type == SIO_OP_RECV_MULTISHOT || st->op->type == SIO_OP_ACCEPT_MULTISHOT) {
+      /*
+      * The callback may unregister the stream, so the rest of the drain is deferred.
+      * The dirty entry brings the flush back here until the queue hits EAGAIN.
+      */
+      sio_context_reactor_mark_dirty(ctx, entry);
+      if (st->op->type == SIO_OP_RECV_MULTISHOT) {
+        if (reactor_recv_multishot(ctx, st, &res)) {
+          return 1;
+        }
+      } else if ((res = reactor_try_op(st)) == 0) {
+        sio_context_notify(ctx, st, 0);
+        return 1;
+      }
+#if defined(SIO_REACTOR_ZEROCOPY)
+    } else if (((sio_context_reactor_t*)ctx)->zerocopy && sio_context_zerocopy(ctx, st)) {
+      /* As for multishot operations, the callback of the first completion may unregister the stream */
+      sio_context_reactor_mark_dirty(ctx, entry);
+      if (reactor_send_zerocopy(ctx, entry, st, &res)) {
+        return 1;
+      }
+#endif
+    } else {
+      res = reactor_try_op(st);
+    }
+
+    if (res == -EAGAIN || res == -EWOULDBLOCK) {
+      if (!(entry->ready & SIO_READY_ALWAYS)) {
+        entry->ready &= ~ready_bit;
+      }
+      break;
+    }
+
+    sio_op_queue_remove(queue, st);
+    st->flags &= ~SIO_OP_STATE_QUEUED;
+    sio_context_complete(ctx, st, res);
+  }
+
+  return 0;
+}
+
+/**
+* @brief Drain both directions of an entry
+*/
+static void reactor_drain(sio_context_t *ctx, sio_context_entry_t *entry) {
+#if defined(SIO_REACTOR_ZEROCOPY)
+  /* Releases are only looked for once the socket reported an error, not on every drain */
+  if (entry->ready & SIO_READY_ERR) {
+    entry->ready &= ~(uint32_t)SIO_READY_ERR;
+    reactor_zerocopy_reap(ctx, entry);
+  }
+#endif
+  if (!reactor_drain_queue(ctx, entry, &entry->in, SIO_READY_IN)) {
+    reactor_drain_queue(ctx, entry, &entry->out, SIO_READY_OUT);
+  }
+}
+
+sio_error_t sio_context_reactor_submit(sio_context_t *ctx, sio_op_state_t *st) {
+  sio_op_t *op = st->op;
+
+  /* Timers have no descriptor, the context's wheel runs them */
+  if (op->type == SIO_OP_TIMER) {
+    sio_context_timer_arm(ctx, st);
+    return SIO_SUCCESS;
+  }
+
+  /* Readiness says nothing about syncs and file system calls, they block in the kernel */
+  if (sio_context_op_blocks(op)) {
+    return sio_context_offload(ctx, st);
+  }
+
+  sio_error_t err = sio_context_entry_ensure(ctx, st);
+  if (err != SIO_SUCCESS) {
+    return err;
+  }
+
+  sio_context_entry_t *entry = st->entry;
+
+  if (op->type == SIO_OP_CONNECT && op->buffer) {
+    const sio_addr_t *addr = (const sio_addr_t*)op->buffer;
+    ctx->stats.syscalls++;
+    if (connect(st->fd, &addr->addr.sa, addr->len) == 0) {
+      sio_context_complete(ctx, st, 0);
+      return SIO_SUCCESS;
+    }
+    if (errno != EINPROGRESS) {
+      sio_context_complete(ctx, st, -errno);
+      return SIO_SUCCESS;
+    }
+    /* Completion is signalled by the next output edge */
+    entry->ready &= ~SIO_READY_OUT;
+  }
+
+  st->flags |= SIO_OP_STATE_QUEUED;
+  if (sio_context_reactor_op_is_input(op)) {
+    sio_op_queue_push(&entry->in, st);
+    if (entry->ready & SIO_READY_IN) {
+      sio_context_reactor_mark_dirty(ctx, entry);
+    }
+  } else {
+    sio_op_queue_push(&entry->out, st);
+    if (entry->ready & SIO_READY_OUT) {
+      sio_context_reactor_mark_dirty(ctx, entry);
+    }
+  }
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_context_reactor_cancel(sio_context_t *ctx, sio_op_state_t *st) {
+  /* Completing a timer takes it off the wheel */
+  if (st->op->type == SIO_OP_TIMER) {
+    sio_context_complete_status(ctx, st, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+    return SIO_SUCCESS;
+  }
+
+  if (sio_context_op_blocks(st->op)) {
+    return sio_context_offload_cancel(ctx, st);
+  }
+
+  /* Operations that are not queued are already running to completion */
+  if (!(st->flags & SIO_OP_STATE_QUEUED)) {
+    return SIO_SUCCESS;
+  }
+
+  sio_context_entry_t *entry = st->entry;
+  sio_op_queue_remove(sio_context_reactor_op_is_input(st->op) ? &entry->in : &entry->out, st);
+  st->flags &= ~SIO_OP_STATE_QUEUED;
+  sio_context_complete_status(ctx, st, SIO_OP_CANCELLED, SIO_SUCCESS, 0);
+
+  return SIO_SUCCESS;
+}
+
+void sio_context_reactor_flush(sio_context_t *ctx) {
+  sio_context_reactor_t *r = (sio_context_reactor_t*)ctx;
+
+  /* Run operations submitted to streams that are (or may be) ready */
+  while (r->dirty) {
+    sio_context_entry_t *entry = r->dirty;
+    r->dirty = entry->dirty_next;
+    entry->dirty = 0;
+    reactor_drain(ctx, entry);
+  }
+}
+
+#endif /* SIO_OS_POSIX */
@@ -0,0 +1,125 @@
+/**
+* @file src/context/reactor.h
+* @brief Readiness reactor shared by the readiness based backends
+*
+* epoll, poll() and select() only differ in how they learn that a descriptor
+* became ready. Everything else lives here: each registered stream keeps
+* per-direction readiness bits and queues of pending operations, and a ready
+* side is drained with non-blocking syscalls until EAGAIN clears its bit again.
+* Entries with queued work on a ready side sit on a dirty list that is drained
+* by sio_context_reactor_flush.
+*
+* Every context also watches a wakeup descriptor (an eventfd on Linux, a pipe
+* elsewhere) that other threads signal to end a wait early: the helper threads
+* of blocking operations, and posting threads of SIO_CTX_THREAD_SAFE contexts.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#ifndef SIO_CONTEXT_REACTOR_H
+#define SIO_CONTEXT_REACTOR_H
+
+#include <src/context/backend.h>
+
+#if defined(SIO_OS_POSIX)
+
+/**
+* @brief Reactor state, embedded first in readiness based backend contexts
+*/
+typedef struct sio_context_reactor {
+  sio_context_t base;            /**< Generic context (must be first) */
+  sio_context_entry_t *dirty;    /**< Entries with queued operations on a ready side */
+  int wake_fd[2];                /**< Wakeup read and write ends */
+  int zerocopy;                  /**< Backend wakes on error queue readiness, which MSG_ZEROCOPY sends need */
+} sio_context_reactor_t;
+
+/**
+* @brief Convert a sio_context_wait timeout to a poll style millisecond timeout
+*
+* @param timeout_ms Timeout in milliseconds or SIO_WAIT_FOREVER
+* @return int Timeout for epoll_wait / poll, -1 for no timeout
+*/
+int sio_context_reactor_timeout(uint64_t timeout_ms);
+
+/**
+* @brief Whether an operation waits on the input side of its stream
+*
+* @param op Operation
+* @return int Non-zero for input side operations
+*/
+int sio_context_reactor_op_is_input(const sio_op_t *op);
+
+/**
+* @brief Switch a registered descriptor to non-blocking mode
+*
+* @param fd Descriptor
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+sio_error_t sio_context_reactor_set_nonblock(int fd);
+
+/**
+* @brief Put an entry on the dirty list so the next flush drains it
+*
+* @param ctx Context
+* @param entry Entry with runnable operations
+*/
+void sio_context_reactor_mark_dirty(sio_context_t *ctx, sio_context_entry_t *entry);
+
+/**
+* @brief Take an entry off the dirty list before it is removed
+*
+* Zero-copy sends still waiting for their buffer release complete right away.
+*
+* @param ctx Context
+* @param entry Entry being removed
+*/
+void sio_context_reactor_forget(sio_context_t *ctx, sio_context_entry_t *entry);
+
+/**
+* @brief Create the wakeup descriptor
+*
+* @param ctx Context
+* @return sio_error_t SIO_SUCCESS or error code
+*/
+sio_error_t sio_context_reactor_wake_open(sio_context_t *ctx);
+
+/**
+* @brief Close the wakeup descriptor
+*
+* @param ctx Context
+*/
+void sio_context_reactor_wake_close(sio_context_t *ctx);
+
+/**
+* @brief Consume pending wakeups after the descriptor polled readable
+*
+* @param ctx Context
+*/
+void sio_context_reactor_wake_drain(sio_context_t *ctx);
+
+/**
+* @brief Backend wakeup hook: signal the wakeup descriptor
+*/
+sio_error_t sio_context_reactor_wakeup(sio_context_t *ctx);
+
+/**
+* @brief Backend submit hook: queue an operation on its stream
+*/
+sio_error_t sio_context_reactor_submit(sio_context_t *ctx, sio_op_state_t *st);
+
+/**
+* @brief Backend cancel hook: drop a queued operation
+*
+* Blocking operations go to sio_context_offload_cancel.
+*/
+sio_error_t sio_context_reactor_cancel(sio_context_t *ctx, sio_op_state_t *st);
+
+/**
+* @brief Backend flush hook: drain every dirty entry
+*/
+void sio_context_reactor_flush(sio_context_t *ctx);
+
+#endif /* SIO_OS_POSIX */
+
+#endif /* SIO_CONTEXT_REACTOR_H */
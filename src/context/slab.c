@@ -0,0 +1,92 @@
+/**
+* @file src/context/slab.c
+* @brief Fixed-size object cache for operation state
+*
+* A block starts with one cache line holding the link to the next block,
+* followed by per_block objects of stride bytes each. Objects of a new block
+* are pushed in reverse so the free list hands them out in address order.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <src/context/slab.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(SIO_OS_WINDOWS)
+  #include <malloc.h>
+#endif
+
+/**
+* @brief Allocate a cache line aligned block and put its objects on the free list
+*/
+static sio_error_t slab_add_block(sio_slab_t *slab) {
+  size_t size = SIO_SLAB_CACHE_LINE + slab->per_block * slab->stride;
+  char *block;
+
+#if defined(SIO_OS_WINDOWS)
+  block = (char*)_aligned_malloc(size, SIO_SLAB_CACHE_LINE);
+  if (!block) {
+    return SIO_ERROR_MEM;
+  }
+#else
+  void *ptr;
+  if (posix_memalign(&ptr, SIO_SLAB_CACHE_LINE, size) != 0) {
+    return SIO_ERROR_MEM;
+  }
+  block = (char*)ptr;
+#endif
+
+  *(void**)block = slab->blocks;
+  slab->blocks = block;
+
+  for (size_t i = slab->per_block; i > 0; i--) {
+    sio_slab_free(slab, block + SIO_SLAB_CACHE_LINE + (i - 1) * slab->stride);
+  }
+  slab->capacity += slab->per_block;
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_slab_init(sio_slab_t *slab, size_t size, size_t count) {
+  memset(slab, 0, sizeof(*slab));
+
+  if (size < sizeof(void*)) {
+    size = sizeof(void*);
+  }
+  slab->stride = (size + SIO_SLAB_CACHE_LINE - 1) & ~(size_t)(SIO_SLAB_CACHE_LINE - 1);
+  slab->per_block = count ? count : 1;
+
+  return slab_add_block(slab);
+}
+
+void sio_slab_destroy(sio_slab_t *slab) {
+  void *block = slab->blocks;
+
+  while (block) {
+    void *next = *(void**)block;
+#if defined(SIO_OS_WINDOWS)
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+    block = next;
+  }
+
+  slab->blocks = NULL;
+  slab->free = NULL;
+  slab->capacity = 0;
+}
+
+void *sio_slab_grow(sio_slab_t *slab) {
+  if (slab_add_block(slab) != SIO_SUCCESS) {
+    return NULL;
+  }
+
+  slab->misses++;
+
+  void *obj = slab->free;
+  slab->free = *(void**)obj;
+  return obj;
+}
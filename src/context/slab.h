@@ -0,0 +1,90 @@
+/**
+* @file src/context/slab.h
+* @brief Fixed-size object cache for operation state
+*
+* Objects are carved from cache line aligned blocks and kept on an intrusive
+* free list, so once the cache has grown to the working set, allocating and
+* freeing are a pointer pop and push with no call into the global allocator.
+* An empty free list adds another block of the initial size.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#ifndef SIO_CONTEXT_SLAB_H
+#define SIO_CONTEXT_SLAB_H
+
+#include <sio/platform.h>
+#include <sio/err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIO_SLAB_CACHE_LINE 64
+
+/**
+* @brief Object cache
+*/
+typedef struct sio_slab {
+  size_t stride;                 /**< Object size rounded up to whole cache lines */
+  size_t per_block;              /**< Objects added by every block */
+  void *free;                    /**< Free objects, linked through their first word */
+  void *blocks;                  /**< Allocated blocks, linked through their first word */
+  size_t capacity;               /**< Objects in all blocks */
+  uint64_t hits;                 /**< Allocations served from the free list */
+  uint64_t misses;               /**< Allocations that had to add a block */
+} sio_slab_t;
+
+/**
+* @brief Initialize a cache and allocate its first block
+*
+* @param slab Cache to initialize
+* @param size Object size
+* @param count Objects per block
+* @return sio_error_t SIO_SUCCESS or SIO_ERROR_MEM
+*/
+sio_error_t sio_slab_init(sio_slab_t *slab, size_t size, size_t count);
+
+/**
+* @brief Release every block, objects still in use included
+*
+* @param slab Cache to destroy
+*/
+void sio_slab_destroy(sio_slab_t *slab);
+
+/**
+* @brief Add a block and take an object from it
+*
+* @param slab Cache
+* @return void* Object or NULL on allocation failure
+*/
+void *sio_slab_grow(sio_slab_t *slab);
+
+/**
+* @brief Take an object, uninitialized and cache line aligned
+*
+* @param slab Cache
+* @return void* Object or NULL on allocation failure
+*/
+static SIO_INLINE void *sio_slab_alloc(sio_slab_t *slab) {
+  void *obj = slab->free;
+  if (!obj) {
+    return sio_slab_grow(slab);
+  }
+
+  slab->free = *(void**)obj;
+  slab->hits++;
+  return obj;
+}
+
+/**
+* @brief Return an object to the cache
+*
+* @param slab Cache
+* @param obj Object taken from this cache
+*/
+static SIO_INLINE void sio_slab_free(sio_slab_t *slab, void *obj) {
+  *(void**)obj = slab->free;
+  slab->free = obj;
+}
+
+#endif /* SIO_CONTEXT_SLAB_H */
@@ -0,0 +1,179 @@
+/**
+* @file src/context/wheel.c
+* @brief Hierarchical timer wheel for operation deadlines
+*
+* A timer at level L sits in the slot of its expiration at that level's
+* granularity (64^L ticks). Level L covers expirations less than 64^(L+1) ticks
+* after the current tick. When the wheel reaches the start of a level L slot,
+* the slot is re-filed into the lower levels, and level 0 slots expire as they
+* are reached.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <src/context/wheel.h>
+#include <string.h>
+
+#if defined(SIO_COMPILER_MSVC)
+  #include <intrin.h>
+#endif
+
+#define SIO_WHEEL_MASK (SIO_WHEEL_SLOTS - 1)
+#define SIO_WHEEL_RANGE ((uint64_t)1 << (SIO_WHEEL_BITS * SIO_WHEEL_LEVELS))
+
+/**
+* @brief Index of the lowest set bit of a non-zero mask
+*/
+static unsigned wheel_ctz(uint64_t mask) {
+#if defined(SIO_COMPILER_MSVC)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return (unsigned)index;
+#else
+  return (unsigned)__builtin_ctzll(mask);
+#endif
+}
+
+/**
+* @brief Link a timer into the slot for its expiration relative to the current tick
+*/
+static void wheel_insert(sio_wheel_t *wheel, sio_wheel_timer_t *timer) {
+  uint64_t expires = timer->expires < wheel->tick ? wheel->tick : timer->expires;
+  uint64_t delta = expires - wheel->tick;
+
+  /* Beyond the range: park at the far end, the real expiration is re-filed later */
+  if (delta >= SIO_WHEEL_RANGE) {
+    delta = SIO_WHEEL_RANGE - 1;
+    expires = wheel->tick + delta;
+  }
+
+  unsigned level = 0;
+  while (delta >= ((uint64_t)1 << (SIO_WHEEL_BITS * (level + 1)))) {
+    level++;
+  }
+
+  unsigned index = (unsigned)(expires >> (SIO_WHEEL_BITS * level)) & SIO_WHEEL_MASK;
+  uint32_t slot = level * SIO_WHEEL_SLOTS + index;
+  sio_wheel_timer_t **head = &wheel->slots[slot];
+
+  timer->slot = slot;
+  timer->next = *head;
+  if (*head) {
+    (*head)->pprev = &timer->next;
+  }
+  timer->pprev = head;
+  *head = timer;
+  wheel->occupied[level] |= (uint64_t)1 << index;
+}
+
+/**
+* @brief Unlink every timer of a slot
+*
+* @return sio_wheel_timer_t* Former slot list
+*/
+static sio_wheel_timer_t *wheel_take(sio_wheel_t *wheel, unsigned level, unsigned index) {
+  uint32_t slot = level * SIO_WHEEL_SLOTS + index;
+  sio_wheel_timer_t *list = wheel->slots[slot];
+
+  wheel->slots[slot] = NULL;
+  wheel->occupied[level] &= ~((uint64_t)1 << index);
+  return list;
+}
+
+void sio_wheel_init(sio_wheel_t *wheel, uint64_t now) {
+  memset(wheel, 0, sizeof(*wheel));
+  wheel->tick = now;
+}
+
+void sio_wheel_add(sio_wheel_t *wheel, sio_wheel_timer_t *timer, uint64_t expires) {
+  timer->expires = expires;
+  wheel_insert(wheel, timer);
+  wheel->count++;
+}
+
+void sio_wheel_remove(sio_wheel_t *wheel, sio_wheel_timer_t *timer) {
+  *timer->pprev = timer->next;
+  if (timer->next) {
+    timer->next->pprev = timer->pprev;
+  }
+
+  if (!wheel->slots[timer->slot]) {
+    wheel->occupied[timer->slot / SIO_WHEEL_SLOTS] &= ~((uint64_t)1 << (timer->slot & SIO_WHEEL_MASK));
+  }
+
+  timer->next = NULL;
+  timer->pprev = NULL;
+  wheel->count--;
+}
+
+uint64_t sio_wheel_next(const sio_wheel_t *wheel) {
+  uint64_t next = UINT64_MAX;
+
+  for (unsigned level = 0; level < SIO_WHEEL_LEVELS; level++) {
+    uint64_t mask = wheel->occupied[level];
+    if (!mask) {
+      continue;
+    }
+
+    /* Slot starts at this level from the current tick on, in the order they are reached */
+    unsigned shift = SIO_WHEEL_BITS * level;
+    uint64_t first = (wheel->tick + ((uint64_t)1 << shift) - 1) >> shift;
+    unsigned rot = (unsigned)first & SIO_WHEEL_MASK;
+    mask = (mask >> rot) | (mask << ((SIO_WHEEL_SLOTS - rot) & SIO_WHEEL_MASK));
+
+    uint64_t tick = (first + wheel_ctz(mask)) << shift;
+    if (tick < next) {
+      next = tick;
+    }
+  }
+
+  return next;
+}
+
+sio_wheel_timer_t *sio_wheel_advance(sio_wheel_t *wheel, uint64_t now) {
+  sio_wheel_timer_t *expired = NULL;
+
+  while (wheel->count) {
+    uint64_t tick = sio_wheel_next(wheel);
+    if (tick > now) {
+      break;
+    }
+
+    /* Ticks skipped on the way have empty slots at every level */
+    wheel->tick = tick;
+
+    /* Re-file higher levels first, their timers may land in a lower slot starting now */
+    for (unsigned level = SIO_WHEEL_LEVELS - 1; level > 0; level--) {
+      unsigned shift = SIO_WHEEL_BITS * level;
+      if (tick & (((uint64_t)1 << shift) - 1)) {
+        continue;
+      }
+
+      sio_wheel_timer_t *timer = wheel_take(wheel, level, (unsigned)(tick >> shift) & SIO_WHEEL_MASK);
+      while (timer) {
+        sio_wheel_timer_t *next = timer->next;
+        wheel_insert(wheel, timer);
+        timer = next;
+      }
+    }
+
+    sio_wheel_timer_t *timer = wheel_take(wheel, 0, (unsigned)tick & SIO_WHEEL_MASK);
+    while (timer) {
+      sio_wheel_timer_t *next = timer->next;
+      timer->pprev = NULL;
+      timer->next = expired;
+      expired = timer;
+      wheel->count--;
+      timer = next;
+    }
+
+    wheel->tick = tick + 1;
+  }
+
+  if (wheel->tick <= now) {
+    wheel->tick = now + 1;
+  }
+
+  return expired;
+}
@@ -0,0 +1,101 @@
+/**
+* @file src/context/wheel.h
+* @brief Hierarchical timer wheel for operation deadlines
+*
+* Four levels of 64 slots with a 1 ms tick cover 2^24 ms (about 4.6 hours);
+* later expirations are parked in the last slot of the top level and re-filed
+* when it is reached. Timers are intrusive and doubly linked into their slot,
+* so arming and disarming are O(1). A per-level occupancy mask lets the wheel
+* find the next tick that has work without walking empty slots, which both
+* bounds the context's sleep and lets advancing skip idle stretches.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#ifndef SIO_CONTEXT_WHEEL_H
+#define SIO_CONTEXT_WHEEL_H
+
+#include <sio/platform.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIO_WHEEL_BITS 6
+#define SIO_WHEEL_SLOTS (1 << SIO_WHEEL_BITS)
+#define SIO_WHEEL_LEVELS 4
+
+typedef struct sio_wheel_timer sio_wheel_timer_t;
+
+/**
+* @brief Timer embedded in the object it belongs to
+*/
+struct sio_wheel_timer {
+  sio_wheel_timer_t *next;       /**< Slot linkage, expired list linkage after sio_wheel_advance */
+  sio_wheel_timer_t **pprev;     /**< Link pointing at this timer, NULL when not armed */
+  uint64_t expires;              /**< Expiration tick */
+  uint32_t slot;                 /**< Slot index (level * SIO_WHEEL_SLOTS + index) */
+};
+
+/**
+* @brief Timer wheel
+*/
+typedef struct sio_wheel {
+  uint64_t tick;                 /**< Next tick to process, every earlier timer has fired */
+  size_t count;                  /**< Number of armed timers */
+  uint64_t occupied[SIO_WHEEL_LEVELS]; /**< Per level: bit set for every non-empty slot */
+  sio_wheel_timer_t *slots[SIO_WHEEL_LEVELS * SIO_WHEEL_SLOTS]; /**< Slot lists */
+} sio_wheel_t;
+
+/**
+* @brief Initialize an empty wheel
+*
+* @param wheel Wheel to initialize
+* @param now Current tick
+*/
+void sio_wheel_init(sio_wheel_t *wheel, uint64_t now);
+
+/**
+* @brief Arm a timer
+*
+* @param wheel Wheel
+* @param timer Timer that is not armed
+* @param expires Expiration tick, a tick already processed counts as the next one
+*/
+void sio_wheel_add(sio_wheel_t *wheel, sio_wheel_timer_t *timer, uint64_t expires);
+
+/**
+* @brief Disarm a timer
+*
+* @param wheel Wheel
+* @param timer Armed timer
+*/
+void sio_wheel_remove(sio_wheel_t *wheel, sio_wheel_timer_t *timer);
+
+/**
+* @brief Earliest tick at which sio_wheel_advance has work
+*
+* This is either an expiration or the point where a higher level slot is
+* re-filed, so it never lies after the nearest expiration.
+*
+* @param wheel Wheel
+* @return uint64_t Tick, UINT64_MAX if no timer is armed
+*/
+uint64_t sio_wheel_next(const sio_wheel_t *wheel);
+
+/**
+* @brief Process every tick up to and including now
+*
+* @param wheel Wheel
+* @param now Current tick
+* @return sio_wheel_timer_t* Expired timers, disarmed and linked through next
+*/
+sio_wheel_timer_t *sio_wheel_advance(sio_wheel_t *wheel, uint64_t now);
+
+/**
+* @brief Whether a timer is armed
+*/
+static SIO_INLINE int sio_wheel_armed(const sio_wheel_timer_t *timer) {
+  return timer->pprev != NULL;
+}
+
+#endif /* SIO_CONTEXT_WHEEL_H */
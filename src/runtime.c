@@ -0,0 +1,383 @@
+/**
+* @file src/runtime.c
+* @brief Implementation of the sharded multi-reactor runtime
+*
+* The runtime only coordinates start and stop. Shards live in cache line sized
+* slots so the loop of one never writes a line another one reads, and nothing
+* but the stop flag and the context's own post queue is touched across threads
+* while they run.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/runtime.h>
+#include <sio/err.h>
+#include <sio/aux/addr.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(SIO_OS_LINUX)
+  #include <sys/socket.h>
+  #include <linux/filter.h>
+#elif defined(SIO_OS_POSIX)
+  #include <sys/socket.h>
+#endif
+
+#define SIO_RUNTIME_CACHE_LINE 64
+
+/**
+* @brief Shard padded to whole cache lines
+*/
+typedef union sio_runtime_slot {
+  sio_runtime_shard_t shard;
+  char pad[(sizeof(sio_runtime_shard_t) + SIO_RUNTIME_CACHE_LINE - 1) & ~(size_t)(SIO_RUNTIME_CACHE_LINE - 1)];
+} sio_runtime_slot_t;
+
+/**
+* @brief Runtime, read-only for the shards once they run
+*/
+struct sio_runtime {
+  sio_runtime_config_t config;   /**< Configuration (listen_addr points at addr) */
+  sio_addr_t addr;               /**< Listen address, with the port picked by the first listener */
+  uint32_t shard_count;          /**< Number of shards */
+  sio_runtime_slot_t *slots;     /**< Shards, cache line aligned */
+  sio_sem_t started;             /**< Posted by every shard once it started or failed to */
+};
+
+/**
+* @brief Allocate zeroed, cache line aligned shard slots
+*/
+static sio_runtime_slot_t *runtime_alloc_slots(uint32_t count) {
+  size_t size = (size_t)count * sizeof(sio_runtime_slot_t);
+  void *ptr;
+
+#if defined(SIO_OS_WINDOWS)
+  ptr = _aligned_malloc(size, SIO_RUNTIME_CACHE_LINE);
+  if (!ptr) {
+    return NULL;
+  }
+#else
+  if (posix_memalign(&ptr, SIO_RUNTIME_CACHE_LINE, size) != 0) {
+    return NULL;
+  }
+#endif
+
+  memset(ptr, 0, size);
+  return (sio_runtime_slot_t*)ptr;
+}
+
+static void runtime_free_slots(sio_runtime_slot_t *slots) {
+#if defined(SIO_OS_WINDOWS)
+  _aligned_free(slots);
+#else
+  free(slots);
+#endif
+}
+
+/**
+* @brief Read back the address a listener was bound to
+*/
+static sio_error_t runtime_bound_addr(sio_stream_t *listener, sio_addr_t *addr) {
+  addr->len = sizeof(addr->addr.ss);
+
+#if defined(SIO_OS_WINDOWS)
+  int len = (int)addr->len;
+  if (getsockname(listener->data.socket.socket, &addr->addr.sa, &len) == SOCKET_ERROR) {
+    return sio_get_last_error();
+  }
+  addr->len = len;
+#else
+  if (getsockname(listener->data.socket.fd, &addr->addr.sa, &addr->len) < 0) {
+    return sio_get_last_error();
+  }
+#endif
+
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Steer every connection to the group member at the index of the receiving CPU
+*
+* Attaching to one listener programs the whole SO_REUSEPORT group. The program
+* returns the CPU modulo the shard count; an index the group does not have makes
+* the kernel fall back to its hash.
+*/
+static sio_error_t runtime_steer(sio_runtime_t *runtime) {
+#if defined(SIO_OS_LINUX) && defined(SO_ATTACH_REUSEPORT_CBPF)
+  struct sock_filter code[] = {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+    { BPF_ALU | BPF_MOD | BPF_K, 0, 0, runtime->shard_count },
+    { BPF_RET | BPF_A, 0, 0, 0 }
+  };
+  struct sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+
+  int fd = runtime->slots[0].shard.listener.data.socket.fd;
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+    return sio_get_last_error();
+  }
+
+  return SIO_SUCCESS;
+#else
+  (void)runtime;
+  return SIO_ERROR_UNSUPPORTED;
+#endif
+}
+
+/**
+* @brief Open the listeners in shard order, which is their order in the reuseport group
+*/
+static sio_error_t runtime_listen(sio_runtime_t *runtime) {
+  sio_stream_flags_t flags = runtime->config.listen_flags | SIO_STREAM_SERVER | SIO_STREAM_REUSEPORT;
+
+  for (uint32_t i = 0; i < runtime->shard_count; i++) {
+    sio_runtime_shard_t *shard = &runtime->slots[i].shard;
+
+    sio_error_t err = sio_stream_open_socket(&shard->listener, &runtime->addr, flags);
+    if (err != SIO_SUCCESS) {
+      return err;
+    }
+    shard->has_listener = 1;
+
+    /* Port 0 lets the first listener pick, the rest have to join it on the same port */
+    if (i == 0) {
+      err = runtime_bound_addr(&shard->listener, &runtime->addr);
+      if (err != SIO_SUCCESS) {
+        return err;
+      }
+    }
+  }
+
+  if (runtime->config.flags & SIO_RUNTIME_STEER) {
+    return runtime_steer(runtime);
+  }
+
+  return SIO_SUCCESS;
+}
+
+/**
+* @brief Shard thread: pin, create the context, start and run until stopped
+*/
+static void *runtime_shard_main(void *arg) {
+  sio_runtime_shard_t *shard = (sio_runtime_shard_t*)arg;
+  sio_runtime_t *runtime = shard->runtime;
+  sio_error_t err = SIO_SUCCESS;
+
+  if (shard->cpu >= 0) {
+    err = sio_thread_set_affinity(NULL, shard->cpu);
+    if (err == SIO_ERROR_UNSUPPORTED) {
+      shard->cpu = -1;
+      err = SIO_SUCCESS;
+    }
+  }
+
+  if (err == SIO_SUCCESS) {
+    sio_context_config_t config = runtime->config.context;
+    config.flags |= SIO_CTX_THREAD_SAFE;
+    config.user_data = shard;
+    err = sio_context_create(&shard->context, &config);
+  }
+
+  if (err == SIO_SUCCESS && runtime->config.start) {
+    err = runtime->config.start(shard);
+  }
+
+  shard->error = err;
+  sio_sem_post(&runtime->started);
+
+  if (err == SIO_SUCCESS) {
+    while (!SIO_ATOMIC_LOAD(&shard->stop)) {
+      if (sio_context_wait(shard->context, SIO_WAIT_FOREVER, runtime->config.max_events) == SIO_WAIT_ERROR) {
+        shard->error = sio_get_last_error();
+        break;
+      }
+    }
+
+    if (runtime->config.stop) {
+      runtime->config.stop(shard);
+    }
+  }
+
+  /* The context itself stays until the runtime is released, sio_runtime_stop may still wake it */
+  if (shard->context && shard->has_listener) {
+    sio_context_unregister(shard->context, &shard->listener);
+  }
+
+  return NULL;
+}
+
+/**
+* @brief Join the shards that were started and free everything
+*
+* Contexts are destroyed here rather than by their threads, which have ended by now.
+*/
+static void runtime_release(sio_runtime_t *runtime, uint32_t started) {
+  for (uint32_t i = 0; i < started; i++) {
+    sio_thread_join(&runtime->slots[i].shard.thread, NULL);
+  }
+
+  for (uint32_t i = 0; i < runtime->shard_count; i++) {
+    sio_runtime_shard_t *shard = &runtime->slots[i].shard;
+    if (shard->context) {
+      sio_context_destroy(shard->context);
+      shard->context = NULL;
+    }
+    if (shard->has_listener) {
+      sio_stream_close(&shard->listener);
+      shard->has_listener = 0;
+    }
+  }
+
+  sio_sem_destroy(&runtime->started);
+  runtime_free_slots(runtime->slots);
+  free(runtime);
+}
+
+void sio_runtime_config_init(sio_runtime_config_t *config) {
+  if (!config) {
+    return;
+  }
+
+  memset(config, 0, sizeof(sio_runtime_config_t));
+  config->flags = SIO_RUNTIME_PIN;
+  config->listen_flags = SIO_STREAM_RDWR | SIO_STREAM_TCP | SIO_STREAM_NONBLOCK;
+  sio_context_config_init(&config->context);
+}
+
+sio_error_t sio_runtime_create(sio_runtime_t **runtime, const sio_runtime_config_t *config) {
+  if (!runtime || !config) {
+    return SIO_ERROR_PARAM;
+  }
+  *runtime = NULL;
+
+  int cpus = sio_thread_get_hardware_threads();
+  if (cpus < 1) {
+    cpus = 1;
+  }
+
+  sio_runtime_t *rt = (sio_runtime_t*)calloc(1, sizeof(sio_runtime_t));
+  if (!rt) {
+    return SIO_ERROR_MEM;
+  }
+
+  rt->config = *config;
+  rt->shard_count = config->shards ? config->shards : (uint32_t)cpus;
+  if (config->listen_addr) {
+    rt->addr = *config->listen_addr;
+    rt->config.listen_addr = &rt->addr;
+  }
+
+  rt->slots = runtime_alloc_slots(rt->shard_count);
+  if (!rt->slots) {
+    free(rt);
+    return SIO_ERROR_MEM;
+  }
+
+  sio_error_t err = sio_sem_init(&rt->started, 0, rt->shard_count);
+  if (err != SIO_SUCCESS) {
+    runtime_free_slots(rt->slots);
+    free(rt);
+    return err;
+  }
+
+  for (uint32_t i = 0; i < rt->shard_count; i++) {
+    sio_runtime_shard_t *shard = &rt->slots[i].shard;
+    shard->runtime = rt;
+    shard->index = i;
+    shard->cpu = (config->flags & SIO_RUNTIME_PIN) ? (int)(i % (uint32_t)cpus) : -1;
+    shard->user_data = config->user_data;
+  }
+
+  if (config->listen_addr) {
+    err = runtime_listen(rt);
+    if (err != SIO_SUCCESS) {
+      runtime_release(rt, 0);
+      return err;
+    }
+  }
+
+  uint32_t started = 0;
+  while (started < rt->shard_count) {
+    sio_runtime_shard_t *shard = &rt->slots[started].shard;
+    err = sio_thread_create(&shard->thread, runtime_shard_main, shard, SIO_THREAD_DEFAULT);
+    if (err != SIO_SUCCESS) {
+      break;
+    }
+    started++;
+  }
+
+  /* Every shard that runs reports back once, check all of them before going on */
+  for (uint32_t i = 0; i < started; i++) {
+    sio_sem_wait(&rt->started);
+  }
+  for (uint32_t i = 0; err == SIO_SUCCESS && i < started; i++) {
+    err = rt->slots[i].shard.error;
+  }
+
+  if (err != SIO_SUCCESS) {
+    sio_runtime_stop(rt);
+    runtime_release(rt, started);
+    return err;
+  }
+
+  *runtime = rt;
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_runtime_stop(sio_runtime_t *runtime) {
+  if (!runtime) {
+    return SIO_ERROR_PARAM;
+  }
+
+  for (uint32_t i = 0; i < runtime->shard_count; i++) {
+    sio_runtime_shard_t *shard = &runtime->slots[i].shard;
+    SIO_ATOMIC_STORE(&shard->stop, 1);
+
+    /* Contexts are created before the shards report back and live as long as the runtime */
+    if (shard->context) {
+      sio_context_wakeup(shard->context);
+    }
+  }
+
+  return SIO_SUCCESS;
+}
+
+sio_error_t sio_runtime_destroy(sio_runtime_t *runtime) {
+  if (!runtime) {
+    return SIO_ERROR_PARAM;
+  }
+
+  sio_runtime_stop(runtime);
+
+  sio_error_t err = SIO_SUCCESS;
+  for (uint32_t i = 0; i < runtime->shard_count; i++) {
+    sio_runtime_shard_t *shard = &runtime->slots[i].shard;
+    sio_thread_join(&shard->thread, NULL);
+    if (err == SIO_SUCCESS) {
+      err = shard->error;
+    }
+  }
+
+  runtime_release(runtime, 0);
+  return err;
+}
+
+uint32_t sio_runtime_shard_count(const sio_runtime_t *runtime) {
+  return runtime ? runtime->shard_count : 0;
+}
+
+sio_runtime_shard_t *sio_runtime_get_shard(sio_runtime_t *runtime, uint32_t index) {
+  if (!runtime || index >= runtime->shard_count) {
+    return NULL;
+  }
+
+  return &runtime->slots[index].shard;
+}
+
+sio_error_t sio_runtime_post(sio_runtime_t *runtime, uint32_t index, sio_op_t *op) {
+  if (!runtime || index >= runtime->shard_count || !op) {
+    return SIO_ERROR_PARAM;
+  }
+
+  return sio_context_post(runtime->slots[index].shard.context, op);
+}
@@ -211,6 +211,12 @@ sio_error_t sio_stream_open_socket(sio_stream_t *stream, sio_addr_t *addr, sio_s
     }
   }
   
+  /* Windows has no load balancing SO_REUSEPORT */
+  if (opt & SIO_STREAM_REUSEPORT) {
+    closesocket(sock);
+    return SIO_ERROR_UNSUPPORTED;
+  }
+  
   /* Bind or connect the socket */
   if (opt & SIO_STREAM_SERVER) {
     /* Bind the socket */
@@ -258,6 +264,20 @@ sio_error_t sio_stream_open_socket(sio_stream_t *stream, sio_addr_t *addr, sio_s
     }
   }
   
+  /* Join the reuseport group before bind, every member needs the option */
+  if (opt & SIO_STREAM_REUSEPORT) {
+#if defined(SO_REUSEPORT)
+    int reuse = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+      close(sock);
+      return sio_get_last_error();
+    }
+#else
+    close(sock);
+    return SIO_ERROR_UNSUPPORTED;
+#endif
+  }
+  
   /* Bind or connect the socket */
   if (opt & SIO_STREAM_SERVER) {
     /* Bind the socket */
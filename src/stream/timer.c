@@ -24,6 +24,7 @@
   #include <time.h>
   #include <errno.h>
   #include <fcntl.h>
+  #include <poll.h>
 #endif
 
 /* Forward declarations of timer stream operations */
@@ -242,18 +243,18 @@ static sio_error_t timer_read(sio_stream_t *stream, void *buffer, size_t size, s
       return sio_get_last_error();
     }
   } else {
-    /* Blocking read - need to poll or select since timerfd might be in non-blocking mode */
-    fd_set readfds;
-    int maxfd = stream->data.timer.fd;
+    /* Blocking read - need to poll since timerfd might be in non-blocking mode (poll has no FD_SETSIZE limit) */
+    struct pollfd pfd;
     
     while (1) {
-      FD_ZERO(&readfds);
-      FD_SET(stream->data.timer.fd, &readfds);
+      pfd.fd = stream->data.timer.fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
       
       /* Wait for the timer fd to become readable */
-      int select_result = select(maxfd + 1, &readfds, NULL, NULL, NULL);
+      int poll_result = poll(&pfd, 1, -1);
       
-      if (select_result < 0) {
+      if (poll_result < 0) {
         if (errno == EINTR) {
           /* Interrupted, try again */
           continue;
@@ -261,7 +262,7 @@ static sio_error_t timer_read(sio_stream_t *stream, void *buffer, size_t size, s
         return sio_get_last_error();
       }
       
-      if (FD_ISSET(stream->data.timer.fd, &readfds)) {
+      if (pfd.revents & (POLLIN | POLLERR | POLLHUP)) {
         /* Timer fd is readable, try to read from it */
         result = read(stream->data.timer.fd, &expirations, sizeof(expirations));
         
@@ -0,0 +1,118 @@
+/**
+* @file tests/aux_hist.c
+* @brief Test program for the log-linear histograms
+*
+* Checks the bucket layout, the precision bound, percentiles and merging.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/aux/hist.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+/**
+* @brief Test that buckets are contiguous and bound their values tightly
+*/
+static void test_buckets(void) {
+  printf("  Testing buckets...\n");
+
+  /* Small values are exact */
+  for (uint64_t v = 0; v < SIO_HIST_SUB_COUNT; v++) {
+    assert(sio_hist_bucket(v) == v);
+    assert(sio_hist_bucket_max((uint32_t)v) == v);
+  }
+
+  /* Every bucket starts right after the previous one ends */
+  for (uint32_t b = 1; b < SIO_HIST_BUCKETS - 1; b++) {
+    uint64_t low = sio_hist_bucket_max(b - 1) + 1;
+    assert(sio_hist_bucket(low) == b);
+    assert(sio_hist_bucket(sio_hist_bucket_max(b)) == b);
+    /* Width within 1/SIO_HIST_SUB_COUNT of the values it holds */
+    assert((sio_hist_bucket_max(b) - low) * SIO_HIST_SUB_COUNT <= low);
+  }
+
+  assert(sio_hist_bucket(((uint64_t)1 << SIO_HIST_MAX_BITS) - 1) == SIO_HIST_BUCKETS - 1);
+  assert(sio_hist_bucket((uint64_t)1 << SIO_HIST_MAX_BITS) == SIO_HIST_BUCKETS - 1);
+  assert(sio_hist_bucket(UINT64_MAX) == SIO_HIST_BUCKETS - 1);
+  assert(sio_hist_bucket_max(SIO_HIST_BUCKETS - 1) == UINT64_MAX);
+}
+
+/**
+* @brief Test percentiles against a known distribution
+*/
+static void test_percentiles(void) {
+  printf("  Testing percentiles...\n");
+
+  static sio_hist_t hist;
+  sio_hist_init(&hist);
+  assert(sio_hist_percentile(&hist, 50.0) == 0);
+  assert(hist.count == 0 && hist.min == UINT64_MAX);
+
+  /* 1..10000 microseconds in nanoseconds */
+  for (uint64_t i = 1; i <= 10000; i++) {
+    sio_hist_record(&hist, i * 1000);
+  }
+  assert(hist.count == 10000);
+  assert(hist.min == 1000 && hist.max == 10000000);
+  assert(hist.sum == 10000ull * 10001 / 2 * 1000);
+
+  uint64_t p50 = sio_hist_percentile(&hist, 50.0);
+  uint64_t p99 = sio_hist_percentile(&hist, 99.0);
+  uint64_t p999 = sio_hist_percentile(&hist, 99.9);
+  assert(p50 >= 5000000 && p50 <= 5000000 + 5000000 / SIO_HIST_SUB_COUNT);
+  assert(p99 >= 9900000 && p99 <= 9900000 + 9900000 / SIO_HIST_SUB_COUNT);
+  assert(p999 >= 9990000 && p999 <= 10000000);
+  assert(sio_hist_percentile(&hist, 100.0) == 10000000);
+  assert(sio_hist_percentile(&hist, 0.0) <= 1000 + 1000 / SIO_HIST_SUB_COUNT);
+
+  /* Values past the last bucket keep the exact maximum */
+  sio_hist_record(&hist, (uint64_t)1 << 40);
+  assert(hist.max == (uint64_t)1 << 40);
+  assert(sio_hist_percentile(&hist, 100.0) == (uint64_t)1 << 40);
+}
+
+/**
+* @brief Test that merging equals recording everything into one histogram
+*/
+static void test_merge(void) {
+  printf("  Testing merge...\n");
+
+  static sio_hist_t a, b, all;
+  sio_hist_init(&a);
+  sio_hist_init(&b);
+  sio_hist_init(&all);
+
+  for (uint64_t i = 0; i < 1000; i++) {
+    uint64_t v = i * i * 37;
+    sio_hist_record(i & 1 ? &a : &b, v);
+    sio_hist_record(&all, v);
+  }
+
+  sio_hist_merge(&a, &b);
+  assert(a.count == all.count && a.sum == all.sum);
+  assert(a.min == all.min && a.max == all.max);
+  for (uint32_t i = 0; i < SIO_HIST_BUCKETS; i++) {
+    assert(a.buckets[i] == all.buckets[i]);
+  }
+  assert(sio_hist_percentile(&a, 99.0) == sio_hist_percentile(&all, 99.0));
+
+  /* Merging an empty histogram changes nothing */
+  sio_hist_init(&b);
+  sio_hist_merge(&a, &b);
+  assert(a.count == all.count && a.min == all.min);
+}
+
+int main(void) {
+  printf("===== SIO Histogram Test =====\n\n");
+
+  test_buckets();
+  test_percentiles();
+  test_merge();
+
+  printf("\nAll tests passed successfully!\n");
+  return EXIT_SUCCESS;
+}
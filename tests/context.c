@@ -0,0 +1,2239 @@
+/**
+* @file tests/context.c
+* @brief Test program for the SIO I/O context
+*
+* Runs the same set of operations against every context backend available on
+* this system, using socket pairs and loopback sockets so no network is needed.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/context.h>
+#include <sio/aux/thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+
+/**
+* @brief Report an error and exit
+*
+* @param error_code The SIO error code
+* @param message Custom error message
+*/
+static void report_error_and_exit(sio_error_t error_code, const char *message) {
+  fprintf(stderr, "Error: %s: %s\n", message, sio_strerr(error_code));
+  exit(EXIT_FAILURE);
+}
+
+static int completions = 0;
+
+/**
+* @brief Completion callback counting dispatched operations
+*/
+static void on_complete(sio_op_t *op, void *user_data) {
+  (void)op;
+  (void)user_data;
+  completions++;
+}
+
+/**
+* @brief Create a context for a backend with the counting callback
+*/
+static sio_context_t *create_context(sio_context_backend_t backend) {
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_complete;
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  assert(sio_context_get_backend(ctx) == backend);
+  return ctx;
+}
+
+/**
+* @brief Wrap both ends of a socket pair in streams
+*/
+static void make_socket_pair(sio_stream_t *a, sio_stream_t *b) {
+  int fds[2];
+  int rc = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  assert(rc == 0);
+  (void)rc;
+
+  sio_error_t err = sio_stream_from_handle(a, (void*)(intptr_t)fds[0], SIO_STREAM_SOCKET, SIO_STREAM_RDWR);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to wrap socket");
+  }
+  err = sio_stream_from_handle(b, (void*)(intptr_t)fds[1], SIO_STREAM_SOCKET, SIO_STREAM_RDWR);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to wrap socket");
+  }
+}
+
+/**
+* @brief Wait until a number of completions have been dispatched
+*/
+static void wait_for(sio_context_t *ctx, int target) {
+  for (int i = 0; i < 100 && completions < target; i++) {
+    sio_wait_result_t res = sio_context_wait(ctx, 100, 0);
+    assert(res != SIO_WAIT_ERROR);
+    (void)res;
+  }
+  assert(completions >= target);
+}
+
+/**
+* @brief Test write and read completions on a socket pair
+*/
+static void test_read_write(sio_context_backend_t backend) {
+  printf("  Testing read/write...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  sio_error_t err = sio_context_register(ctx, &a, NULL);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to register stream");
+  }
+  assert(sio_context_register(ctx, &a, NULL) == SIO_ERROR_EXISTS);
+
+  const char *msg = "Hello, SIO context!";
+  char rbuf[64] = {0};
+  sio_op_t rop, wop;
+
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &a, (void*)msg, strlen(msg), NULL);
+
+  /* Read first so that it has to wait for the data */
+  err = sio_context_submit(ctx, &rop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit read");
+  }
+  assert(sio_context_submit(ctx, &rop) == SIO_ERROR_BUSY);
+
+  err = sio_context_submit(ctx, &wop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit write");
+  }
+  assert(sio_context_pending_count(ctx) == 2);
+
+  wait_for(ctx, 2);
+  assert(!sio_context_has_pending(ctx));
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == strlen(msg));
+  assert(rop.status == SIO_OP_COMPLETE && rop.result == strlen(msg));
+  assert(memcmp(rbuf, msg, strlen(msg)) == 0);
+
+  /* A closed peer reads as end of stream */
+  sio_context_unregister(ctx, &a);
+  sio_stream_close(&a);
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &rop);
+  wait_for(ctx, 3);
+  assert(rop.status == SIO_OP_ERROR && rop.error == SIO_ERROR_EOF);
+
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test positional and vectored reads and writes on a regular file
+*/
+static void test_positional(sio_context_backend_t backend) {
+  printf("  Testing positional file I/O...\n");
+
+  enum { BLOCKS = 64, BLOCK = 4096 };
+  static char wbuf[BLOCKS][BLOCK];
+  static char rbuf[BLOCKS][BLOCK];
+  static sio_op_t ops[BLOCKS];
+  sio_op_t *batch[BLOCKS];
+
+  char path[] = "/tmp/sio_context_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+
+  sio_stream_t file;
+  sio_error_t err = sio_stream_from_handle(&file, (void*)(intptr_t)fd, SIO_STREAM_FILE, SIO_STREAM_RDWR);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to wrap file");
+  }
+
+  sio_context_t *ctx = create_context(backend);
+
+  /* All blocks in flight at once, in reverse order of their offsets */
+  completions = 0;
+  for (int i = 0; i < BLOCKS; i++) {
+    memset(wbuf[i], 'a' + i % 26, BLOCK);
+    sio_op_init(&ops[i], SIO_OP_WRITE_AT, &file, wbuf[i], BLOCK, NULL);
+    ops[i].offset = (uint64_t)(BLOCKS - 1 - i) * BLOCK;
+    batch[i] = &ops[i];
+  }
+  err = sio_context_submit_batch(ctx, batch, BLOCKS);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit positional writes");
+  }
+  wait_for(ctx, BLOCKS);
+  for (int i = 0; i < BLOCKS; i++) {
+    assert(ops[i].status == SIO_OP_COMPLETE && ops[i].result == BLOCK);
+  }
+
+  completions = 0;
+  for (int i = 0; i < BLOCKS; i++) {
+    sio_op_init(&ops[i], SIO_OP_READ_AT, &file, rbuf[i], BLOCK, NULL);
+    ops[i].offset = (uint64_t)i * BLOCK;
+  }
+  err = sio_context_submit_batch(ctx, batch, BLOCKS);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit positional reads");
+  }
+  wait_for(ctx, BLOCKS);
+  for (int i = 0; i < BLOCKS; i++) {
+    assert(ops[i].status == SIO_OP_COMPLETE && ops[i].result == BLOCK);
+    assert(memcmp(rbuf[i], wbuf[BLOCKS - 1 - i], BLOCK) == 0);
+  }
+
+  /* The file position is neither used nor moved */
+  assert(lseek(fd, 0, SEEK_CUR) == 0);
+
+  /* Vectored write gathers three buffers, vectored read scatters them back */
+  char head[3] = "abc", mid[5] = "defgh", tail[2] = "ij";
+  char out[10] = {0};
+  sio_iovec_t wiov[3] = {{head, sizeof(head)}, {mid, sizeof(mid)}, {tail, sizeof(tail)}};
+  sio_iovec_t riov[2] = {{out, 4}, {out + 4, 6}};
+  sio_op_t vop;
+
+  completions = 0;
+  sio_op_init(&vop, SIO_OP_WRITEV_AT, &file, wiov, 3, NULL);
+  vop.offset = 100;
+  assert(sio_context_submit(ctx, &vop) == SIO_SUCCESS);
+  wait_for(ctx, 1);
+  assert(vop.status == SIO_OP_COMPLETE && vop.result == 10);
+
+  sio_op_init(&vop, SIO_OP_READV_AT, &file, riov, 2, NULL);
+  vop.offset = 100;
+  assert(sio_context_submit(ctx, &vop) == SIO_SUCCESS);
+  wait_for(ctx, 2);
+  assert(vop.status == SIO_OP_COMPLETE && vop.result == 10);
+  assert(memcmp(out, "abcdefghij", 10) == 0);
+
+  /* Reading at the end of the file is end of stream */
+  sio_op_init(&vop, SIO_OP_READ_AT, &file, rbuf[0], BLOCK, NULL);
+  vop.offset = (uint64_t)BLOCKS * BLOCK;
+  assert(sio_context_submit(ctx, &vop) == SIO_SUCCESS);
+  wait_for(ctx, 3);
+  assert(vop.status == SIO_OP_ERROR && vop.error == SIO_ERROR_EOF);
+
+  sio_op_init(&vop, SIO_OP_READ_AT, &file, rbuf[0], BLOCK, NULL);
+  vop.offset = (uint64_t)-1;
+  assert(sio_context_submit(ctx, &vop) == SIO_ERROR_PARAM);
+  sio_op_init(&vop, SIO_OP_READV_AT, &file, riov, SIO_OP_IOV_MAX + 1, NULL);
+  assert(sio_context_submit(ctx, &vop) == SIO_ERROR_PARAM);
+
+  sio_context_destroy(ctx);
+  sio_stream_close(&file);
+}
+
+/**
+* @brief Test sync operations linked behind writes, as a group commit issues them
+*/
+static void test_sync(sio_context_backend_t backend) {
+  printf("  Testing sync operations...\n");
+
+  char path[] = "/tmp/sio_context_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+
+  sio_stream_t file;
+  sio_error_t err = sio_stream_from_handle(&file, (void*)(intptr_t)fd, SIO_STREAM_FILE, SIO_STREAM_RDWR);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to wrap file");
+  }
+
+  sio_context_t *ctx = create_context(backend);
+  static char record[8192];
+  memset(record, 'w', sizeof(record));
+
+  sio_op_t wop, fop, dop, rop;
+  sio_op_t *chain[] = {&wop, &dop, &rop, &fop};
+
+  completions = 0;
+  sio_op_init(&wop, SIO_OP_WRITE_AT, &file, record, sizeof(record), NULL);
+  wop.flags = SIO_OP_FLAG_LINK;
+  sio_op_init(&dop, SIO_OP_FDATASYNC, &file, NULL, 0, NULL);
+  dop.flags = SIO_OP_FLAG_LINK;
+  sio_op_init(&rop, SIO_OP_SYNC_RANGE, &file, NULL, 4096, NULL);
+  rop.offset = 4096;
+  rop.flags = SIO_OP_FLAG_LINK;
+  sio_op_init(&fop, SIO_OP_FSYNC, &file, NULL, 0, NULL);
+  err = sio_context_submit_batch(ctx, chain, 4);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit sync chain");
+  }
+  wait_for(ctx, 4);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == sizeof(record));
+  assert(dop.status == SIO_OP_COMPLETE && dop.error == SIO_SUCCESS);
+  assert(rop.status == SIO_OP_COMPLETE && rop.error == SIO_SUCCESS);
+  assert(fop.status == SIO_OP_COMPLETE && fop.error == SIO_SUCCESS);
+
+  /* A socket cannot be synced, and the failure cancels the rest of the chain */
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+  completions = 0;
+  sio_op_init(&fop, SIO_OP_FSYNC, &a, NULL, 0, NULL);
+  fop.flags = SIO_OP_FLAG_LINK;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, record, 16, NULL);
+  sio_op_t *failing[] = {&fop, &wop};
+  assert(sio_context_submit_batch(ctx, failing, 2) == SIO_SUCCESS);
+  wait_for(ctx, 2);
+  assert(fop.status == SIO_OP_ERROR);
+  assert(wop.status == SIO_OP_CANCELLED);
+
+  sio_op_init(&rop, SIO_OP_SYNC_RANGE, &file, NULL, 0, NULL);
+  rop.offset = (uint64_t)-1;
+  assert(sio_context_submit(ctx, &rop) == SIO_ERROR_PARAM);
+  sio_op_init(&fop, SIO_OP_FSYNC, NULL, NULL, 0, NULL);
+  assert(sio_context_submit(ctx, &fop) == SIO_ERROR_PARAM);
+
+  sio_context_destroy(ctx);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_stream_close(&file);
+}
+
+/**
+* @brief Test open, stat, rename and unlink operations
+*/
+static void test_file_ops(sio_context_backend_t backend) {
+  printf("  Testing file system operations...\n");
+
+  char path[64], moved[64];
+  snprintf(path, sizeof(path), "/tmp/sio_context_%d_open", (int)getpid());
+  snprintf(moved, sizeof(moved), "/tmp/sio_context_%d_moved", (int)getpid());
+  unlink(path);
+  unlink(moved);
+
+  sio_context_t *ctx = create_context(backend);
+  sio_open_request_t oreq = {0};
+  sio_stat_request_t sreq = {0};
+  sio_rename_request_t rreq = {path, moved};
+  sio_op_t oop, sop, rop, uop, wop;
+  char data[100];
+  memset(data, 'f', sizeof(data));
+
+  /* Open creates the file and hands back a stream ready for I/O */
+  completions = 0;
+  oreq.path = path;
+  oreq.opt = SIO_STREAM_RDWR | SIO_STREAM_CREATE | SIO_STREAM_TRUNC;
+  oreq.mode = 0640;
+  sio_op_init(&oop, SIO_OP_OPEN, NULL, &oreq, sizeof(oreq), NULL);
+  assert(sio_context_submit(ctx, &oop) == SIO_SUCCESS);
+  wait_for(ctx, 1);
+  assert(oop.status == SIO_OP_COMPLETE);
+  assert(oreq.stream.type == SIO_STREAM_FILE);
+
+  sio_op_init(&wop, SIO_OP_WRITE_AT, &oreq.stream, data, sizeof(data), NULL);
+  assert(sio_context_submit(ctx, &wop) == SIO_SUCCESS);
+  wait_for(ctx, 2);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == sizeof(data));
+
+  sreq.path = path;
+  sio_op_init(&sop, SIO_OP_STAT, NULL, &sreq, sizeof(sreq), NULL);
+  assert(sio_context_submit(ctx, &sop) == SIO_SUCCESS);
+  wait_for(ctx, 3);
+  assert(sop.status == SIO_OP_COMPLETE);
+  assert(sreq.info.type == SIO_FILE_TYPE_REGULAR);
+  assert(sreq.info.size == sizeof(data));
+  assert((sreq.info.permissions & 0700) == 0600);
+  assert(strcmp(sreq.info.name, strrchr(path, '/') + 1) == 0);
+  assert(sreq.info.modify_time > 0);
+
+  /* Rename, then stat the old name, linked: the failed stat cancels the unlink */
+  sio_op_init(&rop, SIO_OP_RENAME, NULL, &rreq, sizeof(rreq), NULL);
+  rop.flags = SIO_OP_FLAG_LINK;
+  sio_op_init(&sop, SIO_OP_STAT, NULL, &sreq, sizeof(sreq), NULL);
+  sop.flags = SIO_OP_FLAG_LINK;
+  sio_op_init(&uop, SIO_OP_UNLINK, NULL, moved, 0, NULL);
+  sio_op_t *chain[] = {&rop, &sop, &uop};
+  assert(sio_context_submit_batch(ctx, chain, 3) == SIO_SUCCESS);
+  wait_for(ctx, 6);
+  assert(rop.status == SIO_OP_COMPLETE);
+  assert(sop.status == SIO_OP_ERROR && sop.error == SIO_ERROR_NOTFOUND);
+  assert(uop.status == SIO_OP_CANCELLED);
+  assert(access(moved, F_OK) == 0 && access(path, F_OK) != 0);
+
+  sio_op_init(&uop, SIO_OP_UNLINK, NULL, moved, 0, NULL);
+  assert(sio_context_submit(ctx, &uop) == SIO_SUCCESS);
+  wait_for(ctx, 7);
+  assert(uop.status == SIO_OP_COMPLETE);
+  assert(access(moved, F_OK) != 0);
+
+  /* Opening a missing file without SIO_STREAM_CREATE fails */
+  sio_open_request_t missing = {0};
+  missing.path = moved;
+  missing.opt = SIO_STREAM_READ;
+  sio_op_init(&oop, SIO_OP_OPEN, NULL, &missing, sizeof(missing), NULL);
+  assert(sio_context_submit(ctx, &oop) == SIO_SUCCESS);
+  wait_for(ctx, 8);
+  assert(oop.status == SIO_OP_ERROR && oop.error == SIO_ERROR_NOTFOUND);
+
+  missing.path = NULL;
+  sio_op_init(&oop, SIO_OP_OPEN, NULL, &missing, sizeof(missing), NULL);
+  assert(sio_context_submit(ctx, &oop) == SIO_ERROR_PARAM);
+  sio_op_init(&uop, SIO_OP_UNLINK, &oreq.stream, moved, 0, NULL);
+  assert(sio_context_submit(ctx, &uop) == SIO_ERROR_PARAM);
+
+  /* A file opened by a completion that is never dispatched is closed with the context */
+  int lost_fd = dup(0);
+  close(lost_fd);
+  sio_open_request_t lost = {0};
+  lost.path = moved;
+  lost.opt = SIO_STREAM_RDWR | SIO_STREAM_CREATE;
+  sio_op_t cop;
+  sio_op_init(&cop, SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+  cop.priority = SIO_OP_PRIORITY_HIGH;
+  sio_op_init(&oop, SIO_OP_OPEN, NULL, &lost, sizeof(lost), NULL);
+  assert(sio_context_submit(ctx, &cop) == SIO_SUCCESS);
+  assert(sio_context_submit(ctx, &oop) == SIO_SUCCESS);
+  sio_context_wait(ctx, 0, 1);
+  assert(cop.status == SIO_OP_COMPLETE);
+  for (int i = 0; i < 100 && access(moved, F_OK) != 0; i++) {
+    usleep(1000);
+  }
+  usleep(20000);
+  sio_op_t *none[1];
+  assert(sio_context_peek(ctx, none, 0) == 0);
+  assert(oop.internal != NULL);
+
+  sio_context_destroy(ctx);
+  assert(fcntl(lost_fd, F_GETFD) < 0);
+  unlink(moved);
+  sio_stream_close(&oreq.stream);
+
+  if (backend == SIO_CONTEXT_IO_URING) {
+    return;
+  }
+
+  /* More blocking operations than the helper queue holds do not hold back a ready socket */
+  sio_context_config_t config;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_complete;
+  config.queue_depth = 2;
+  ctx = NULL;
+  assert(sio_context_create(&ctx, &config) == SIO_SUCCESS);
+
+  static sio_stat_request_t burst_req[32];
+  static sio_op_t burst[32];
+  for (int i = 0; i < 32; i++) {
+    burst_req[i].path = "/";
+    sio_op_init(&burst[i], SIO_OP_STAT, NULL, &burst_req[i], sizeof(burst_req[i]), NULL);
+    assert(sio_context_submit(ctx, &burst[i]) == SIO_SUCCESS);
+  }
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+  completions = 0;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, data, sizeof(data), NULL);
+  assert(sio_context_submit(ctx, &wop) == SIO_SUCCESS);
+  sio_context_wait(ctx, 0, 0);
+  assert(wop.status == SIO_OP_COMPLETE);
+
+  wait_for(ctx, 33);
+  for (int i = 0; i < 32; i++) {
+    assert(burst[i].status == SIO_OP_COMPLETE);
+    assert(burst_req[i].info.type == SIO_FILE_TYPE_DIRECTORY);
+  }
+
+  /* Opens of a FIFO block the helpers until a writer shows up; the last one never reaches them */
+  char fifo[64];
+  snprintf(fifo, sizeof(fifo), "/tmp/sio_context_%d_fifo", (int)getpid());
+  unlink(fifo);
+  assert(mkfifo(fifo, 0600) == 0);
+
+  static sio_open_request_t fifo_req[16];
+  static sio_op_t fifo_op[16];
+  completions = 0;
+  for (int i = 0; i < 16; i++) {
+    fifo_req[i].path = fifo;
+    fifo_req[i].opt = SIO_STREAM_READ;
+    sio_op_init(&fifo_op[i], SIO_OP_OPEN, NULL, &fifo_req[i], sizeof(fifo_req[i]), NULL);
+    assert(sio_context_submit(ctx, &fifo_op[i]) == SIO_SUCCESS);
+  }
+  assert(sio_context_cancel(ctx, &fifo_op[0]) == SIO_ERROR_BUSY);
+  assert(sio_context_cancel(ctx, &fifo_op[15]) == SIO_SUCCESS);
+  sio_context_wait(ctx, 0, 0);
+  assert(completions == 1 && fifo_op[15].status == SIO_OP_CANCELLED);
+
+  int fifo_fd = open(fifo, O_WRONLY);
+  assert(fifo_fd >= 0);
+  wait_for(ctx, 16);
+  for (int i = 0; i < 15; i++) {
+    assert(fifo_op[i].status == SIO_OP_COMPLETE);
+    sio_stream_close(&fifo_req[i].stream);
+  }
+  close(fifo_fd);
+  unlink(fifo);
+
+  sio_context_destroy(ctx);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+}
+
+/**
+* @brief Test batched submission and submit-and-wait
+*/
+static void test_batch(sio_context_backend_t backend) {
+  printf("  Testing batched submission...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char wbuf[4][8];
+  sio_op_t wops[4];
+  sio_op_t *batch[4];
+
+  completions = 0;
+  for (int i = 0; i < 4; i++) {
+    memset(wbuf[i], 'a' + i, sizeof(wbuf[i]));
+    sio_op_init(&wops[i], SIO_OP_WRITE, &a, wbuf[i], sizeof(wbuf[i]), NULL);
+    batch[i] = &wops[i];
+  }
+
+  sio_error_t err = sio_context_submit_batch(ctx, batch, 4);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit batch");
+  }
+  assert(sio_context_pending_count(ctx) == 4);
+  wait_for(ctx, 4);
+
+  /* Submission is folded into the wait */
+  char rbuf[64] = {0};
+  sio_op_t rop;
+  sio_op_t *rbatch[] = { &rop };
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+
+  sio_wait_result_t res = sio_context_submit_and_wait(ctx, rbatch, 1, 1000, 0);
+  assert(res == SIO_WAIT_COMPLETED);
+  (void)res;
+  wait_for(ctx, 5);
+  assert(rop.status == SIO_OP_COMPLETE && rop.result > 0 && rbuf[0] == 'a');
+
+  /* An invalid operation stops the batch but keeps the ones before it */
+  sio_op_t bad;
+  sio_op_init(&wops[0], SIO_OP_WRITE, &a, wbuf[0], sizeof(wbuf[0]), NULL);
+  sio_op_init(&bad, SIO_OP_ACCEPT, &a, NULL, 0, NULL);
+  batch[0] = &wops[0];
+  batch[1] = &bad;
+  assert(sio_context_submit_batch(ctx, batch, 2) == SIO_ERROR_PARAM);
+  assert(sio_context_pending_count(ctx) == 1);
+  wait_for(ctx, 6);
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test operations on buffers from a registered pool
+*/
+static void test_fixed_buffers(sio_context_backend_t backend) {
+  printf("  Testing registered buffers...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_buffer_pool_t pool;
+  sio_error_t err = sio_buffer_pool_create(&pool, 4, 4096);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create buffer pool");
+  }
+
+  err = sio_context_register_buffers(ctx, &pool);
+  if (err == SIO_ERROR_MEM || err == SIO_ERROR_PERM) {
+    printf("    Skipping (cannot pin buffers: %s)\n", sio_strerr(err));
+    sio_buffer_pool_destroy(&pool);
+    sio_context_destroy(ctx);
+    return;
+  }
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to register buffers");
+  }
+  assert(sio_context_register_buffers(ctx, &pool) == SIO_ERROR_EXISTS);
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  sio_buffer_t *wbuf, *rbuf;
+  sio_buffer_pool_acquire(&pool, &wbuf);
+  sio_buffer_pool_acquire(&pool, &rbuf);
+  memset(wbuf->data, 'x', 512);
+
+  sio_op_t wop, rop;
+  completions = 0;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, wbuf->data + 16, 512, NULL);
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf->data, rbuf->capacity, NULL);
+  sio_op_t *batch[] = { &wop, &rop };
+  sio_context_submit_batch(ctx, batch, 2);
+
+  assert(sio_context_unregister_buffers(ctx) == SIO_ERROR_BUSY);
+  wait_for(ctx, 2);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == 512);
+  assert(rop.status == SIO_OP_COMPLETE && rop.result > 0 && rbuf->data[0] == 'x');
+
+  /* Files use the fixed write path as well */
+  char path[] = "/tmp/sio_context_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+
+  sio_stream_t file;
+  sio_stream_from_handle(&file, (void*)(intptr_t)fd, SIO_STREAM_FILE, SIO_STREAM_RDWR);
+  sio_op_init(&wop, SIO_OP_WRITE, &file, wbuf->data, 512, NULL);
+  sio_context_submit(ctx, &wop);
+  wait_for(ctx, 3);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == 512);
+
+  sio_context_unregister(ctx, &file);
+  sio_stream_close(&file);
+
+  err = sio_context_unregister_buffers(ctx);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to unregister buffers");
+  }
+  assert(sio_context_unregister_buffers(ctx) == SIO_ERROR_NOTFOUND);
+
+  sio_buffer_pool_release(&pool, wbuf);
+  sio_buffer_pool_release(&pool, rbuf);
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+  sio_buffer_pool_destroy(&pool);
+}
+
+static sio_context_t *ring_ctx = NULL;
+static size_t ring_bytes = 0;
+static int ring_notifications = 0;
+
+/**
+* @brief Completion callback consuming and releasing provided buffers
+*/
+static void on_ring_complete(sio_op_t *op, void *user_data) {
+  (void)user_data;
+  completions++;
+
+  if (op->buffer_id >= 0) {
+    const char *data = (const char*)op->buffer;
+    for (size_t i = 0; i < op->result; i++) {
+      assert(data[i] == 'r');
+    }
+    ring_bytes += op->result;
+    assert(sio_context_release_buffer(ring_ctx, op->buffer_id) == SIO_SUCCESS);
+    assert(sio_context_release_buffer(ring_ctx, op->buffer_id) == SIO_ERROR_PARAM);
+  }
+  if (op->flags & SIO_OP_FLAG_MORE) {
+    assert(op->status == SIO_OP_COMPLETE);
+    ring_notifications++;
+  }
+}
+
+/**
+* @brief Test multishot receive into a provided buffer ring
+*/
+static void test_buffer_ring(sio_context_backend_t backend) {
+  printf("  Testing provided buffer ring...\n");
+
+  sio_context_config_t config;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_ring_complete;
+
+  sio_error_t err = sio_context_create(&ring_ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  sio_buffer_pool_t pool;
+  err = sio_buffer_pool_create(&pool, 4, 64);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create buffer pool");
+  }
+
+  err = sio_context_register_buffer_ring(ring_ctx, &pool);
+  if (err == SIO_ERROR_UNSUPPORTED) {
+    printf("    Skipping (provided buffer rings not supported)\n");
+    sio_buffer_pool_destroy(&pool);
+    sio_context_destroy(ring_ctx);
+    return;
+  }
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to register buffer ring");
+  }
+  assert(sio_context_register_buffer_ring(ring_ctx, &pool) == SIO_ERROR_EXISTS);
+  assert(pool.size == pool.capacity);
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  sio_op_t rop;
+  completions = 0;
+  ring_bytes = 0;
+  ring_notifications = 0;
+  sio_op_init(&rop, SIO_OP_RECV_MULTISHOT, &b, NULL, 0, NULL);
+  err = sio_context_submit(ring_ctx, &rop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit multishot receive");
+  }
+  assert(sio_context_unregister_buffer_ring(ring_ctx) == SIO_ERROR_BUSY);
+
+  /* More data than the ring holds at once, so buffers have to be recycled */
+  char msg[48];
+  memset(msg, 'r', sizeof(msg));
+  size_t total = 0;
+  for (int i = 0; i < 8; i++) {
+    size_t written = 0;
+    err = sio_stream_write(&a, msg, sizeof(msg), &written, 0);
+    assert(err == SIO_SUCCESS && written == sizeof(msg));
+    total += written;
+
+    for (int j = 0; j < 100 && ring_bytes < total; j++) {
+      sio_wait_result_t res = sio_context_wait(ring_ctx, 100, 0);
+      assert(res != SIO_WAIT_ERROR);
+      (void)res;
+    }
+    assert(ring_bytes == total);
+  }
+  assert(ring_notifications >= 8 && rop.status == SIO_OP_PENDING);
+
+  /* Closing the peer ends the multishot receive */
+  sio_context_unregister(ring_ctx, &a);
+  sio_stream_close(&a);
+  wait_for(ring_ctx, ring_notifications + 1);
+  assert(rop.status == SIO_OP_ERROR && rop.error == SIO_ERROR_EOF);
+  assert(!(rop.flags & SIO_OP_FLAG_MORE));
+
+  err = sio_context_unregister_buffer_ring(ring_ctx);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to unregister buffer ring");
+  }
+  assert(sio_context_unregister_buffer_ring(ring_ctx) == SIO_ERROR_NOTFOUND);
+  assert(pool.size == 0);
+
+  sio_context_unregister(ring_ctx, &b);
+  sio_stream_close(&b);
+  sio_buffer_pool_destroy(&pool);
+  sio_context_destroy(ring_ctx);
+  ring_ctx = NULL;
+}
+
+/**
+* @brief Test that streams stay usable after others are unregistered
+*
+* The poll() and select() backends keep a dense descriptor array, so removing a
+* stream moves the last one into its slot.
+*/
+static void test_unregister_reorder(sio_context_backend_t backend) {
+  printf("  Testing unregister with other streams registered...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t s[6];
+  for (int i = 0; i < 6; i += 2) {
+    make_socket_pair(&s[i], &s[i + 1]);
+    sio_context_register(ctx, &s[i], NULL);
+    sio_context_register(ctx, &s[i + 1], NULL);
+  }
+
+  /* Drop the first pair, the last registered streams take their slots */
+  sio_context_unregister(ctx, &s[0]);
+  sio_context_unregister(ctx, &s[1]);
+
+  char rbuf[16];
+  sio_op_t rop, wop;
+  completions = 0;
+  for (int i = 2; i < 6; i += 2) {
+    sio_op_init(&rop, SIO_OP_READ, &s[i + 1], rbuf, sizeof(rbuf), NULL);
+    sio_op_init(&wop, SIO_OP_WRITE, &s[i], "slot", 4, NULL);
+    sio_context_submit(ctx, &rop);
+    sio_context_submit(ctx, &wop);
+    wait_for(ctx, i);
+    assert(rop.status == SIO_OP_COMPLETE && memcmp(rbuf, "slot", 4) == 0);
+  }
+
+  for (int i = 0; i < 6; i++) {
+    sio_context_unregister(ctx, &s[i]);
+    sio_stream_close(&s[i]);
+  }
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test linked operation chains
+*/
+static void test_linked(sio_context_backend_t backend) {
+  printf("  Testing linked operations...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b, c, d;
+  make_socket_pair(&a, &b);
+  make_socket_pair(&c, &d);
+
+  /* Relay: read from b, then forward the same buffer to c */
+  size_t written = 0;
+  sio_error_t err = sio_stream_write(&a, "relay-me", 8, &written, 0);
+  assert(err == SIO_SUCCESS && written == 8);
+
+  char relay[8], out[16];
+  sio_op_t rop, wop, vop;
+  sio_op_t *chain[] = { &rop, &wop };
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, relay, sizeof(relay), NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &c, relay, sizeof(relay), NULL);
+  rop.flags |= SIO_OP_FLAG_LINK;
+  err = sio_context_submit_batch(ctx, chain, 2);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit linked chain");
+  }
+  wait_for(ctx, 2);
+  assert(rop.status == SIO_OP_COMPLETE && rop.result == 8);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == 8);
+
+  sio_op_init(&vop, SIO_OP_READ, &d, out, sizeof(out), NULL);
+  sio_context_submit(ctx, &vop);
+  wait_for(ctx, 3);
+  assert(vop.status == SIO_OP_COMPLETE && vop.result == 8 && memcmp(out, "relay-me", 8) == 0);
+
+  /* Cancelling the head cancels the rest of the chain */
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, relay, sizeof(relay), NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &c, relay, sizeof(relay), NULL);
+  rop.flags |= SIO_OP_FLAG_LINK;
+  sio_context_submit_batch(ctx, chain, 2);
+  sio_context_wait(ctx, 0, 0);
+  sio_context_cancel(ctx, &rop);
+  wait_for(ctx, 2);
+  assert(rop.status == SIO_OP_CANCELLED);
+  assert(wop.status == SIO_OP_CANCELLED);
+
+  /* A failed head (end of stream) never runs its successor */
+  completions = 0;
+  sio_context_unregister(ctx, &a);
+  sio_stream_close(&a);
+  sio_op_init(&rop, SIO_OP_READ, &b, relay, sizeof(relay), NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &c, relay, sizeof(relay), NULL);
+  rop.flags |= SIO_OP_FLAG_LINK;
+  sio_context_submit_batch(ctx, chain, 2);
+  wait_for(ctx, 2);
+  assert(rop.status == SIO_OP_ERROR && rop.error == SIO_ERROR_EOF);
+  assert(wop.status == SIO_OP_CANCELLED);
+
+  /* Close cannot be part of a chain */
+  sio_op_t cop;
+  sio_op_init(&cop, SIO_OP_CLOSE, &c, NULL, 0, NULL);
+  cop.flags |= SIO_OP_FLAG_LINK;
+  sio_op_t *bad[] = { &cop, &wop };
+  assert(sio_context_submit_batch(ctx, bad, 2) == SIO_ERROR_PARAM);
+  assert(!sio_context_has_pending(ctx));
+
+  sio_context_unregister(ctx, &b);
+  sio_context_unregister(ctx, &c);
+  sio_context_unregister(ctx, &d);
+  sio_stream_close(&b);
+  sio_stream_close(&c);
+  sio_stream_close(&d);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test cancelling a pending operation
+*/
+static void test_cancel(sio_context_backend_t backend) {
+  printf("  Testing cancel...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char rbuf[16];
+  sio_op_t rop, cop;
+
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &rop);
+
+  /* Nothing to read, so the wait times out */
+  assert(sio_context_wait(ctx, 10, 0) == SIO_WAIT_TIMEOUT);
+
+  sio_error_t err = sio_context_cancel(ctx, &rop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to cancel read");
+  }
+  wait_for(ctx, 1);
+  assert(rop.status == SIO_OP_CANCELLED);
+  assert(sio_context_cancel(ctx, &rop) == SIO_ERROR_NOTFOUND);
+
+  /* Custom operations complete on the next wait */
+  sio_op_init(&cop, SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+  sio_context_submit(ctx, &cop);
+  wait_for(ctx, 2);
+  assert(cop.status == SIO_OP_COMPLETE);
+
+  /* Close through the context cancels nothing else and closes the stream */
+  sio_op_init(&cop, SIO_OP_CLOSE, &b, NULL, 0, NULL);
+  sio_context_submit(ctx, &cop);
+  wait_for(ctx, 3);
+  assert(cop.status == SIO_OP_COMPLETE);
+
+  sio_stream_close(&a);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test cancelling every operation of one stream, leaving other streams alone
+*/
+static void test_cancel_stream(sio_context_backend_t backend) {
+  printf("  Testing cancel stream...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b, c, d;
+  make_socket_pair(&a, &b);
+  make_socket_pair(&c, &d);
+
+  /* b is registered, d is not (and stays unregistered on io_uring) */
+  sio_error_t err = sio_context_register(ctx, &b, NULL);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to register stream");
+  }
+
+  char rbuf[8][16];
+  sio_op_t rops[8], dop, eop;
+
+  completions = 0;
+  for (int i = 0; i < 8; i++) {
+    sio_op_init(&rops[i], SIO_OP_READ, &b, rbuf[i], sizeof(rbuf[i]), NULL);
+    sio_context_submit(ctx, &rops[i]);
+  }
+  sio_op_init(&dop, SIO_OP_READ, &d, rbuf[0], sizeof(rbuf[0]), NULL);
+  sio_op_init(&eop, SIO_OP_READ, &d, rbuf[1], sizeof(rbuf[1]), NULL);
+  sio_context_submit(ctx, &dop);
+  sio_context_submit(ctx, &eop);
+
+  assert(sio_context_wait(ctx, 10, 0) == SIO_WAIT_TIMEOUT);
+  assert(sio_context_pending_count(ctx) == 10);
+
+  err = sio_context_cancel_stream(ctx, &b);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to cancel stream");
+  }
+  wait_for(ctx, 8);
+  for (int i = 0; i < 8; i++) {
+    assert(rops[i].status == SIO_OP_CANCELLED);
+  }
+  assert(dop.status == SIO_OP_PENDING && eop.status == SIO_OP_PENDING);
+  assert(sio_context_pending_count(ctx) == 2);
+
+  /* Nothing left on b, cancelling again is a no-op */
+  assert(sio_context_cancel_stream(ctx, &b) == SIO_SUCCESS);
+
+  err = sio_context_cancel_stream(ctx, &d);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to cancel stream");
+  }
+  wait_for(ctx, 10);
+  assert(dop.status == SIO_OP_CANCELLED && eop.status == SIO_OP_CANCELLED);
+  assert(!sio_context_has_pending(ctx));
+
+  sio_context_unregister(ctx, &b);
+  sio_context_unregister(ctx, &d);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_stream_close(&c);
+  sio_stream_close(&d);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test that operation states come from the per-context cache
+*/
+static void test_state_cache(sio_context_backend_t backend) {
+  printf("  Testing state cache...\n");
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.queue_depth = 4;
+  config.completion_fn = on_complete;
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  sio_context_stats_t stats;
+  sio_context_get_stats(ctx, &stats);
+  assert(stats.state_capacity == 4);
+  assert(stats.state_hits == 0 && stats.state_misses == 0);
+
+  sio_op_t ops[8];
+
+  /* Within the queue depth every state is a hit */
+  completions = 0;
+  for (int i = 0; i < 4; i++) {
+    sio_op_init(&ops[i], SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+    sio_context_submit(ctx, &ops[i]);
+  }
+  wait_for(ctx, 4);
+  sio_context_get_stats(ctx, &stats);
+  assert(stats.state_hits == 4 && stats.state_misses == 0);
+
+  /* Twice as many in flight grows the cache once, after that it is hits again */
+  for (int round = 0; round < 2; round++) {
+    completions = 0;
+    for (int i = 0; i < 8; i++) {
+      sio_op_init(&ops[i], SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+      sio_context_submit(ctx, &ops[i]);
+    }
+    wait_for(ctx, 8);
+  }
+  sio_context_get_stats(ctx, &stats);
+  assert(stats.state_misses == 1);
+  assert(stats.state_hits == 4 + 15);
+  assert(stats.state_capacity == 8);
+
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test the per-context counters
+*/
+static void test_stats(sio_context_backend_t backend) {
+  printf("  Testing stats...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char wbuf[] = "stats";
+  char rbuf[16];
+  sio_op_t wop, rop;
+
+  completions = 0;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, wbuf, sizeof(wbuf), NULL);
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &wop);
+  sio_context_submit(ctx, &rop);
+  wait_for(ctx, 2);
+
+  /* Nothing pending, so this blocks for the whole timeout */
+  assert(sio_context_wait(ctx, 5, 0) == SIO_WAIT_TIMEOUT);
+
+  sio_context_stats_t stats;
+  sio_error_t err = sio_context_get_stats(ctx, &stats);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to get stats");
+  }
+
+  assert(stats.submitted[SIO_OP_WRITE] == 1 && stats.submitted[SIO_OP_READ] == 1);
+  assert(stats.completed[SIO_OP_WRITE] == 1 && stats.completed[SIO_OP_READ] == 1);
+  assert(stats.submitted[SIO_OP_ACCEPT] == 0 && stats.completed[SIO_OP_ACCEPT] == 0);
+  assert(stats.batch_completions == 2);
+  assert(stats.batches >= 1 && stats.batches <= 2);
+  assert(stats.batch_max >= 1 && stats.batch_max <= 2);
+  assert(stats.syscalls > 0);
+  assert(stats.wait_ns >= 4000000);
+  assert(stats.sq_full == 0 && stats.cq_overflows == 0);
+  assert(sio_context_get_stats(ctx, NULL) == SIO_ERROR_PARAM);
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test the latency histograms
+*/
+static void test_latency(sio_context_backend_t backend) {
+  printf("  Testing latency...\n");
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.flags = SIO_CTX_LATENCY;
+  config.completion_fn = on_complete;
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char wbuf[] = "latency";
+  char rbuf[16];
+  sio_op_t wop, rop;
+
+  /* The read waits at least 5 ms for the write */
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &rop);
+  sio_context_wait(ctx, 0, 0);
+  sio_thread_sleep(5);
+  sio_op_init(&wop, SIO_OP_WRITE, &a, wbuf, sizeof(wbuf), NULL);
+  sio_context_submit(ctx, &wop);
+  wait_for(ctx, 2);
+
+  sio_hist_t reads, writes, merged;
+  assert(sio_context_get_latency(ctx, SIO_OP_READ, &reads) == SIO_SUCCESS);
+  assert(sio_context_get_latency(ctx, SIO_OP_WRITE, &writes) == SIO_SUCCESS);
+  assert(reads.count == 1 && writes.count == 1);
+  assert(reads.min >= 4000000 && reads.max < 5000000000ull);
+  assert(writes.max < reads.min);
+
+  sio_hist_init(&merged);
+  sio_hist_merge(&merged, &reads);
+  sio_hist_merge(&merged, &writes);
+  assert(merged.count == 2 && sio_hist_percentile(&merged, 100.0) == reads.max);
+
+  assert(sio_context_get_latency(ctx, (sio_op_type_t)SIO_OP_TYPE_COUNT, &reads) == SIO_ERROR_PARAM);
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+
+  /* Not recorded unless asked for */
+  ctx = create_context(backend);
+  assert(sio_context_get_latency(ctx, SIO_OP_READ, &reads) == SIO_ERROR_UNSUPPORTED);
+  sio_context_destroy(ctx);
+}
+
+static sio_context_t *timer_ctx = NULL;
+static uint64_t timer_ticks = 0;
+static sio_op_t *timer_pair = NULL;
+static int timer_pair_ticks = 0;
+
+/**
+* @brief Completion callback of the timer test, cancels the periodic timer after 3 ticks
+*
+* The first tick of either timer_pair member cancels both of them.
+*/
+static void on_timer_complete(sio_op_t *op, void *user_data) {
+  (void)user_data;
+  completions++;
+
+  if (op->flags & SIO_OP_FLAG_MORE) {
+    assert(op->status == SIO_OP_COMPLETE && op->result >= 1);
+    if (timer_pair && (op == &timer_pair[0] || op == &timer_pair[1])) {
+      timer_pair_ticks++;
+      assert(timer_pair_ticks == 1);
+      assert(sio_context_cancel(timer_ctx, &timer_pair[0]) == SIO_SUCCESS);
+      assert(sio_context_cancel(timer_ctx, &timer_pair[1]) == SIO_SUCCESS);
+      return;
+    }
+    timer_ticks += op->result;
+    if (timer_ticks >= 3) {
+      assert(sio_context_cancel(timer_ctx, op) == SIO_SUCCESS);
+    }
+  }
+}
+
+/**
+* @brief Test one-shot and periodic timer operations
+*/
+static void test_timer(sio_context_backend_t backend) {
+  printf("  Testing timers...\n");
+
+  sio_context_config_t config;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_timer_complete;
+  sio_error_t err = sio_context_create(&timer_ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  /* One-shot */
+  sio_op_t top;
+  completions = 0;
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  sio_op_init(&top, SIO_OP_TIMER, NULL, NULL, 20, NULL);
+  assert(sio_context_submit(timer_ctx, &top) == SIO_SUCCESS);
+  wait_for(timer_ctx, 1);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  assert(top.status == SIO_OP_COMPLETE && top.result == 1);
+  assert((t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000 >= 19);
+
+  /* Periodic until the callback cancels it */
+  completions = 0;
+  timer_ticks = 0;
+  sio_op_init(&top, SIO_OP_TIMER, NULL, NULL, 5, NULL);
+  top.flags |= SIO_OP_FLAG_REPEAT;
+  assert(sio_context_submit(timer_ctx, &top) == SIO_SUCCESS);
+  while (top.status == SIO_OP_PENDING) {
+    assert(sio_context_wait(timer_ctx, 1000, 0) != SIO_WAIT_ERROR);
+  }
+  assert(timer_ticks >= 3);
+  assert(top.status == SIO_OP_CANCELLED && !(top.flags & SIO_OP_FLAG_MORE));
+
+  /* Cancelled by a callback of the same wait that already holds its expiry */
+  static sio_op_t pair[2];
+  timer_pair = pair;
+  timer_pair_ticks = 0;
+  for (int i = 0; i < 2; i++) {
+    sio_op_init(&pair[i], SIO_OP_TIMER, NULL, NULL, (size_t)(10 + 2 * i), NULL);
+    pair[i].flags |= SIO_OP_FLAG_REPEAT;
+    assert(sio_context_submit(timer_ctx, &pair[i]) == SIO_SUCCESS);
+  }
+  usleep(40000);
+  for (int i = 0; i < 100 && sio_context_has_pending(timer_ctx); i++) {
+    assert(sio_context_wait(timer_ctx, 100, 0) != SIO_WAIT_ERROR);
+  }
+  assert(pair[0].status == SIO_OP_CANCELLED && pair[1].status == SIO_OP_CANCELLED);
+  timer_pair = NULL;
+
+  /* Many timers, cancelling every other one before it fires */
+  static sio_op_t many[1000];
+  static sio_op_t *batch[1000];
+  completions = 0;
+  for (int i = 0; i < 1000; i++) {
+    sio_op_init(&many[i], SIO_OP_TIMER, NULL, NULL, (size_t)(10 + i % 20), NULL);
+    batch[i] = &many[i];
+  }
+  assert(sio_context_submit_batch(timer_ctx, batch, 1000) == SIO_SUCCESS);
+  for (int i = 0; i < 1000; i += 2) {
+    assert(sio_context_cancel(timer_ctx, &many[i]) == SIO_SUCCESS);
+  }
+  for (int i = 0; i < 1000 && completions < 1000; i++) {
+    assert(sio_context_wait(timer_ctx, 100, 0) != SIO_WAIT_ERROR);
+  }
+  assert(completions == 1000);
+  for (int i = 0; i < 1000; i++) {
+    assert(many[i].status == (i % 2 ? SIO_OP_COMPLETE : SIO_OP_CANCELLED));
+  }
+  assert(!sio_context_has_pending(timer_ctx));
+
+  /* Timers take no stream, no deadline and a period */
+  sio_op_init(&top, SIO_OP_TIMER, NULL, NULL, 0, NULL);
+  top.flags |= SIO_OP_FLAG_REPEAT;
+  assert(sio_context_submit(timer_ctx, &top) == SIO_ERROR_PARAM);
+  sio_op_init(&top, SIO_OP_TIMER, NULL, NULL, 10, NULL);
+  top.timeout_ms = 5;
+  assert(sio_context_submit(timer_ctx, &top) == SIO_ERROR_PARAM);
+
+  sio_context_destroy(timer_ctx);
+  timer_ctx = NULL;
+}
+
+/**
+* @brief Find the next trace event of a kind for an operation
+*/
+static size_t find_event(const sio_trace_event_t *events, size_t count, size_t from, sio_trace_kind_t kind, const sio_op_t *op) {
+  for (size_t i = from; i < count; i++) {
+    if (events[i].kind == kind && events[i].op == (uint64_t)(uintptr_t)op) {
+      return i;
+    }
+  }
+  return count;
+}
+
+/**
+* @brief Test the trace ring
+*/
+static void test_trace(sio_context_backend_t backend) {
+  printf("  Testing trace...\n");
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.flags = SIO_CTX_TRACE;
+  config.trace_events = 20;
+  config.completion_fn = on_complete;
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char wbuf[] = "trace";
+  char rbuf[16];
+  sio_op_t wop, rop, top;
+
+  /* A read that times out, then one that completes */
+  completions = 0;
+  sio_op_init(&top, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  top.timeout_ms = 10;
+  sio_context_submit(ctx, &top);
+  wait_for(ctx, 1);
+  assert(top.status == SIO_OP_TIMEOUT);
+
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &a, wbuf, sizeof(wbuf), NULL);
+  sio_context_submit(ctx, &rop);
+  sio_context_submit(ctx, &wop);
+  wait_for(ctx, 2);
+
+  sio_trace_event_t events[32];
+  size_t count = 0;
+  assert(sio_context_trace_copy(ctx, events, 32, &count) == SIO_SUCCESS);
+  assert(count > 0 && count <= 32);
+
+  size_t i = find_event(events, count, 0, SIO_TRACE_SUBMIT, &top);
+  assert(i < count && events[i].result == (int64_t)sizeof(rbuf) && events[i].op_type == SIO_OP_READ);
+  size_t j = find_event(events, count, i, SIO_TRACE_TIMEOUT, &top);
+  assert(j < count);
+  size_t k = find_event(events, count, j, SIO_TRACE_COMPLETE, &top);
+  assert(k < count && events[k].status == SIO_OP_TIMEOUT && events[k].result == SIO_ERROR_TIMEOUT);
+  assert(events[i].time <= events[j].time && events[j].time <= events[k].time);
+
+  /* The deadline was waited for in the kernel */
+  size_t enter = count;
+  for (size_t e = i; e < j; e++) {
+    if (events[e].kind == SIO_TRACE_ENTER) {
+      enter = e;
+      break;
+    }
+  }
+  assert(enter < count && events[enter].op == 0);
+
+  i = find_event(events, count, k, SIO_TRACE_COMPLETE, &rop);
+  assert(i < count && events[i].status == SIO_OP_COMPLETE && events[i].result == (int64_t)sizeof(wbuf));
+  assert(find_event(events, count, k, SIO_TRACE_COMPLETE, &wop) < count);
+
+  /* Cancellation */
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &rop);
+  sio_context_cancel(ctx, &rop);
+  wait_for(ctx, 1);
+  assert(sio_context_trace_copy(ctx, events, 32, &count) == SIO_SUCCESS);
+  i = find_event(events, count, 0, SIO_TRACE_CANCEL, &rop);
+  assert(i < count);
+  i = find_event(events, count, i, SIO_TRACE_COMPLETE, &rop);
+  assert(i < count && events[i].status == SIO_OP_CANCELLED);
+
+  /* The ring keeps the newest 32 events */
+  sio_op_t custom[24];
+  completions = 0;
+  for (int c = 0; c < 24; c++) {
+    sio_op_init(&custom[c], SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+    sio_context_submit(ctx, &custom[c]);
+  }
+  wait_for(ctx, 24);
+  assert(sio_context_trace_copy(ctx, events, 32, &count) == SIO_SUCCESS);
+  assert(count == 32);
+  assert(find_event(events, count, 0, SIO_TRACE_SUBMIT, &top) == count);
+  assert(find_event(events, count, 0, SIO_TRACE_COMPLETE, &custom[23]) < count);
+  for (size_t e = 1; e < count; e++) {
+    assert(events[e - 1].time <= events[e].time);
+  }
+
+  /* Dumped through a file stream */
+  const char *path = "test_context_trace.bin";
+  sio_stream_t file;
+  err = sio_stream_open_file(&file, path, SIO_STREAM_WRITE | SIO_STREAM_CREATE | SIO_STREAM_TRUNC, 0644);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to open trace file");
+  }
+  assert(sio_context_trace_dump(ctx, &file) == SIO_SUCCESS);
+  sio_stream_close(&file);
+
+  err = sio_stream_open_file(&file, path, SIO_STREAM_READ, 0);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to open trace file");
+  }
+  sio_trace_header_t header;
+  sio_trace_event_t dumped[32];
+  size_t got = 0;
+  assert(sio_stream_read(&file, &header, sizeof(header), &got, 0) == SIO_SUCCESS && got == sizeof(header));
+  assert(memcmp(header.magic, SIO_TRACE_MAGIC, sizeof(header.magic)) == 0);
+  assert(header.version == SIO_TRACE_VERSION && header.event_size == sizeof(sio_trace_event_t));
+  assert(header.count == 32 && header.dropped > 0);
+  assert(sio_stream_read(&file, dumped, sizeof(dumped), &got, 0) == SIO_SUCCESS && got == sizeof(dumped));
+  assert(memcmp(dumped, events, sizeof(dumped)) == 0);
+  sio_stream_close(&file);
+  remove(path);
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+
+  /* Nothing is recorded unless asked for */
+  ctx = create_context(backend);
+  assert(sio_context_trace_copy(ctx, events, 32, &count) == SIO_ERROR_UNSUPPORTED);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test accepting and connecting over loopback
+*/
+static void test_accept_connect(sio_context_backend_t backend) {
+  printf("  Testing accept/connect...\n");
+
+  sio_context_t *ctx = create_context(backend);
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sin;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int rc = bind(lfd, (struct sockaddr*)&sin, sizeof(sin));
+  assert(rc == 0);
+  rc = listen(lfd, 16);
+  assert(rc == 0);
+  (void)rc;
+
+  sio_addr_t addr;
+  addr.len = sizeof(addr.addr.ss);
+  getsockname(lfd, &addr.addr.sa, &addr.len);
+
+  sio_stream_t server, client;
+  sio_stream_from_handle(&server, (void*)(intptr_t)lfd, SIO_STREAM_SOCKET, SIO_STREAM_RDWR | SIO_STREAM_SERVER);
+  sio_stream_from_handle(&client, (void*)(intptr_t)socket(AF_INET, SOCK_STREAM, 0), SIO_STREAM_SOCKET, SIO_STREAM_RDWR);
+
+  sio_accept_result_t accepted;
+  sio_op_t aop, cop;
+
+  completions = 0;
+  sio_op_init(&aop, SIO_OP_ACCEPT, &server, &accepted, sizeof(accepted), NULL);
+  sio_op_init(&cop, SIO_OP_CONNECT, &client, &addr, sizeof(addr), NULL);
+  sio_op_t *batch[] = { &aop, &cop };
+
+  sio_error_t err = sio_context_submit_batch(ctx, batch, 2);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit accept/connect");
+  }
+
+  wait_for(ctx, 2);
+  assert(aop.status == SIO_OP_COMPLETE);
+  assert(cop.status == SIO_OP_COMPLETE);
+  assert(accepted.stream.type == SIO_STREAM_SOCKET);
+  assert(accepted.addr.addr.sa.sa_family == AF_INET);
+  sio_stream_close(&accepted.stream);
+
+  /* A client accepted by a completion that is never dispatched is closed with the context */
+  int raw = socket(AF_INET, SOCK_STREAM, 0);
+  rc = connect(raw, &addr.addr.sa, addr.len);
+  assert(rc == 0);
+  int lost_fd = dup(0);
+  close(lost_fd);
+  sio_op_t hop;
+  sio_op_init(&hop, SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+  hop.priority = SIO_OP_PRIORITY_HIGH;
+  sio_op_init(&aop, SIO_OP_ACCEPT, &server, &accepted, sizeof(accepted), NULL);
+  assert(sio_context_submit(ctx, &hop) == SIO_SUCCESS);
+  assert(sio_context_submit(ctx, &aop) == SIO_SUCCESS);
+  sio_context_wait(ctx, 0, 1);
+  assert(hop.status == SIO_OP_COMPLETE);
+  usleep(20000);
+
+  sio_context_destroy(ctx);
+  assert(fcntl(lost_fd, F_GETFD) < 0);
+  close(raw);
+  sio_stream_close(&client);
+  sio_stream_close(&server);
+}
+
+static int accepted_clients = 0;
+
+/**
+* @brief Completion callback taking ownership of multishot accepted clients
+*/
+static void on_accept_complete(sio_op_t *op, void *user_data) {
+  (void)user_data;
+  completions++;
+
+  if (op->flags & SIO_OP_FLAG_MORE) {
+    sio_accept_result_t *res = (sio_accept_result_t*)op->buffer;
+    assert(res->stream.type == SIO_STREAM_SOCKET);
+    if (op->size >= sizeof(*res)) {
+      assert(res->addr.addr.sa.sa_family == AF_INET);
+    } else {
+      assert(res->addr.len == 0);
+    }
+    sio_stream_close(&res->stream);
+    accepted_clients++;
+  }
+}
+
+/**
+* @brief Run a multishot accept serving several clients until cancelled
+*
+* @param size Result size, offsetof(sio_accept_result_t, addr) to skip the address
+*/
+static void run_accept_multishot(sio_context_backend_t backend, size_t size) {
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_accept_complete;
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sin;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int rc = bind(lfd, (struct sockaddr*)&sin, sizeof(sin));
+  assert(rc == 0);
+  rc = listen(lfd, 16);
+  assert(rc == 0);
+
+  socklen_t len = sizeof(sin);
+  getsockname(lfd, (struct sockaddr*)&sin, &len);
+
+  sio_stream_t server;
+  sio_stream_from_handle(&server, (void*)(intptr_t)lfd, SIO_STREAM_SOCKET, SIO_STREAM_RDWR | SIO_STREAM_SERVER);
+
+  sio_accept_result_t accepted;
+  sio_op_t aop;
+  completions = 0;
+  accepted_clients = 0;
+  memset(&accepted, 0, sizeof(accepted));
+  sio_op_init(&aop, SIO_OP_ACCEPT_MULTISHOT, &server, &accepted, size, NULL);
+  err = sio_context_submit(ctx, &aop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit multishot accept");
+  }
+
+  /* A burst of clients, some already queued before the next wait */
+  int clients[4];
+  for (int i = 0; i < 4; i++) {
+    clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+    rc = connect(clients[i], (struct sockaddr*)&sin, sizeof(sin));
+    assert(rc == 0);
+    if (i == 1) {
+      sio_context_wait(ctx, 0, 0);
+    }
+  }
+  (void)rc;
+
+  for (int i = 0; i < 100 && accepted_clients < 4; i++) {
+    sio_wait_result_t res = sio_context_wait(ctx, 100, 0);
+    assert(res != SIO_WAIT_ERROR);
+    (void)res;
+  }
+  assert(accepted_clients == 4);
+  assert(aop.status == SIO_OP_PENDING);
+
+  err = sio_context_cancel(ctx, &aop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to cancel multishot accept");
+  }
+  wait_for(ctx, accepted_clients + 1);
+  assert(aop.status == SIO_OP_CANCELLED);
+  assert(!(aop.flags & SIO_OP_FLAG_MORE));
+
+  for (int i = 0; i < 4; i++) {
+    close(clients[i]);
+  }
+  sio_context_unregister(ctx, &server);
+  sio_stream_close(&server);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test a multishot accept with and without client addresses
+*/
+static void test_accept_multishot(sio_context_backend_t backend) {
+  printf("  Testing multishot accept...\n");
+
+  run_accept_multishot(backend, sizeof(sio_accept_result_t));
+  run_accept_multishot(backend, offsetof(sio_accept_result_t, addr));
+}
+
+static int zerocopy_more = 0;
+static size_t zerocopy_sent = 0;
+
+/**
+* @brief Completion callback recording the first completion of zero-copy writes
+*/
+static void on_zerocopy_complete(sio_op_t *op, void *user_data) {
+  (void)user_data;
+
+  if (op->flags & SIO_OP_FLAG_MORE) {
+    assert(op->status == SIO_OP_COMPLETE);
+    zerocopy_more++;
+    zerocopy_sent = op->result;
+    return;
+  }
+  completions++;
+}
+
+/**
+* @brief Wait for completions while draining the receiving end of a socket
+*
+* @return size_t Bytes drained
+*/
+static size_t zerocopy_pump(sio_context_t *ctx, int fd, int target) {
+  static char sink[65536];
+  size_t received = 0;
+
+  for (int i = 0; i < 200 && completions < target; i++) {
+    sio_wait_result_t res = sio_context_wait(ctx, 10, 0);
+    assert(res != SIO_WAIT_ERROR);
+    (void)res;
+
+    ssize_t n;
+    while ((n = recv(fd, sink, sizeof(sink), MSG_DONTWAIT)) > 0) {
+      received += (size_t)n;
+    }
+  }
+  assert(completions >= target);
+  return received;
+}
+
+/**
+* @brief Test zero-copy writes, their release completion and the copying fallbacks
+*/
+static void test_zerocopy(sio_context_backend_t backend) {
+  printf("  Testing zero-copy writes...\n");
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_zerocopy_complete;
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  /* Loopback TCP connection, zero-copy needs a TCP or UDP socket */
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sin;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(sin);
+  int rc = bind(lfd, (struct sockaddr*)&sin, sizeof(sin));
+  assert(rc == 0);
+  rc = listen(lfd, 1);
+  assert(rc == 0);
+  getsockname(lfd, (struct sockaddr*)&sin, &len);
+
+  int cfd = socket(AF_INET, SOCK_STREAM, 0);
+  rc = connect(cfd, (struct sockaddr*)&sin, sizeof(sin));
+  assert(rc == 0);
+  int pfd = accept(lfd, NULL, NULL);
+  assert(pfd >= 0);
+  close(lfd);
+  (void)rc;
+
+  sio_stream_t client;
+  sio_stream_from_handle(&client, (void*)(intptr_t)cfd, SIO_STREAM_SOCKET, SIO_STREAM_RDWR);
+  err = sio_context_register(ctx, &client, NULL);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to register socket");
+  }
+
+  static char payload[4 * SIO_OP_ZEROCOPY_MIN];
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (char)(i * 7);
+  }
+
+  /* Large write: data queued first, then the buffer comes back */
+  sio_op_t wop;
+  sio_op_init(&wop, SIO_OP_WRITE, &client, payload, sizeof(payload), NULL);
+  wop.flags = SIO_OP_FLAG_ZEROCOPY;
+  completions = 0;
+  zerocopy_more = 0;
+  err = sio_context_submit(ctx, &wop);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit zero-copy write");
+  }
+
+  size_t received = zerocopy_pump(ctx, pfd, 1);
+  assert(wop.status == SIO_OP_COMPLETE);
+  assert(!(wop.flags & SIO_OP_FLAG_MORE));
+  assert(wop.result > 0 && wop.result <= sizeof(payload));
+  if (backend == SIO_CONTEXT_SELECT) {
+    assert(zerocopy_more == 0);
+  } else {
+    assert(zerocopy_more == 1);
+    assert(zerocopy_sent == wop.result);
+  }
+  while (received < wop.result) {
+    ssize_t n = recv(pfd, payload, sizeof(payload), 0);
+    assert(n > 0);
+    received += (size_t)n;
+  }
+  assert(received == wop.result);
+
+  /* Below the threshold the write is copied and completes once */
+  sio_op_init(&wop, SIO_OP_WRITE, &client, payload, SIO_OP_ZEROCOPY_MIN - 1, NULL);
+  wop.flags = SIO_OP_FLAG_ZEROCOPY;
+  completions = 0;
+  zerocopy_more = 0;
+  err = sio_context_submit(ctx, &wop);
+  assert(err == SIO_SUCCESS);
+  zerocopy_pump(ctx, pfd, 1);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == SIO_OP_ZEROCOPY_MIN - 1);
+  assert(zerocopy_more == 0);
+
+  /* Zero-copy writes cannot be linked */
+  sio_op_t sync;
+  sio_op_init(&wop, SIO_OP_WRITE, &client, payload, sizeof(payload), NULL);
+  sio_op_init(&sync, SIO_OP_WRITE, &client, payload, 1, NULL);
+  wop.flags = SIO_OP_FLAG_ZEROCOPY | SIO_OP_FLAG_LINK;
+  sio_op_t *batch[] = { &wop, &sync };
+  assert(sio_context_submit_batch(ctx, batch, 2) == SIO_ERROR_PARAM);
+  assert(wop.internal == NULL);
+
+  sio_context_unregister(ctx, &client);
+  sio_stream_close(&client);
+  close(pfd);
+
+  /* Unix domain sockets do not support it and copy */
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+  sio_context_register(ctx, &a, NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &a, payload, 2 * SIO_OP_ZEROCOPY_MIN, NULL);
+  wop.flags = SIO_OP_FLAG_ZEROCOPY;
+  completions = 0;
+  zerocopy_more = 0;
+  err = sio_context_submit(ctx, &wop);
+  assert(err == SIO_SUCCESS);
+  wait_for(ctx, 1);
+  assert(wop.status == SIO_OP_COMPLETE && wop.result == 2 * SIO_OP_ZEROCOPY_MIN);
+  assert(zerocopy_more == 0);
+
+  sio_context_unregister(ctx, &a);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test io_uring specific configuration
+*/
+static void test_uring_config(void) {
+  printf("  Testing io_uring configuration...\n");
+
+  sio_io_uring_config_t uconfig = { 0, 8, 64, 2, 0, 0 };
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+
+  sio_context_config_init(&config);
+  config.backend = SIO_CONTEXT_IO_URING;
+  config.completion_fn = on_complete;
+  config.backend_config = &uconfig;
+  config.backend_config_size = sizeof(uconfig);
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create io_uring context");
+  }
+
+  /* Two fixed file slots: the third registration falls back to the plain descriptor */
+  sio_stream_t a, b, c, d;
+  char rbuf[16];
+  sio_op_t rop, wop;
+  make_socket_pair(&a, &b);
+  make_socket_pair(&c, &d);
+  sio_context_register(ctx, &a, NULL);
+  sio_context_register(ctx, &b, NULL);
+  err = sio_context_register(ctx, &c, NULL);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to register stream beyond the fixed file table");
+  }
+
+  /* The ring can only be rebuilt while idle */
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &rop);
+
+  uconfig.sq_entries = 16;
+  assert(sio_context_backend_config(ctx, SIO_CONTEXT_IO_URING, &uconfig, sizeof(uconfig)) == SIO_ERROR_BUSY);
+  assert(sio_context_backend_config(ctx, SIO_CONTEXT_EPOLL, &uconfig, sizeof(uconfig)) == SIO_ERROR_PARAM);
+
+  sio_context_cancel(ctx, &rop);
+  while (sio_context_has_pending(ctx)) {
+    sio_context_wait(ctx, 100, 0);
+  }
+  assert(rop.status == SIO_OP_CANCELLED);
+
+  err = sio_context_backend_config(ctx, SIO_CONTEXT_IO_URING, &uconfig, sizeof(uconfig));
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to reconfigure io_uring");
+  }
+
+  /* Registered streams carry over to the rebuilt ring */
+  completions = 0;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, "ping", 4, NULL);
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_op_t *batch[] = { &wop, &rop };
+  sio_context_submit_batch(ctx, batch, 2);
+  wait_for(ctx, 2);
+  assert(rop.status == SIO_OP_COMPLETE && rop.result == 4);
+
+  /* A recycled slot is handed to the next registration */
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &c);
+  sio_context_register(ctx, &d, NULL);
+  sio_op_init(&wop, SIO_OP_WRITE, &d, "pong", 4, NULL);
+  sio_op_init(&rop, SIO_OP_READ, &c, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit_batch(ctx, batch, 2);
+  wait_for(ctx, 4);
+  assert(rop.status == SIO_OP_COMPLETE && memcmp(rbuf, "pong", 4) == 0);
+
+  sio_context_unregister(ctx, &b);
+  sio_context_unregister(ctx, &d);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_stream_close(&c);
+  sio_stream_close(&d);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test a kernel polled submission queue, including wakeups after it idles
+*/
+static void test_uring_sqpoll(void) {
+  printf("  Testing io_uring SQPOLL...\n");
+
+  sio_io_uring_config_t uconfig;
+  memset(&uconfig, 0, sizeof(uconfig));
+  uconfig.flags = IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF;
+  uconfig.sq_thread_cpu = 0;
+  uconfig.sq_thread_idle = 1;
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = SIO_CONTEXT_IO_URING;
+  config.completion_fn = on_complete;
+  config.backend_config = &uconfig;
+  config.backend_config_size = sizeof(uconfig);
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err == SIO_ERROR_PERM || err == SIO_ERROR_UNSUPPORTED) {
+    printf("    Skipping (SQPOLL not permitted: %s)\n", sio_strerr(err));
+    return;
+  }
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create SQPOLL context");
+  }
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char rbuf[16];
+  sio_op_t wop, rop;
+  sio_op_t *batch[] = { &wop, &rop };
+  completions = 0;
+
+  for (int i = 0; i < 3; i++) {
+    sio_op_init(&wop, SIO_OP_WRITE, &a, "sqpoll", 6, NULL);
+    sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+    err = sio_context_submit_batch(ctx, batch, 2);
+    if (err != SIO_SUCCESS) {
+      report_error_and_exit(err, "Failed to submit to SQPOLL ring");
+    }
+    wait_for(ctx, (i + 1) * 2);
+    assert(rop.status == SIO_OP_COMPLETE && rop.result == 6);
+
+    /* Let the poller thread go idle so the next submission has to wake it */
+    usleep(20000);
+  }
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test waits that busy-poll before sleeping
+*/
+static void test_spin_wait(sio_context_backend_t backend) {
+  printf("  Testing busy-poll wait...\n");
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_complete;
+  config.spin_us = 2000;
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  /* Nothing to find: the spin is cut short by the timeout, then the wait times out */
+  assert(sio_context_wait(ctx, 1, 0) == SIO_WAIT_TIMEOUT);
+  assert(sio_context_wait(ctx, 0, 0) == SIO_WAIT_TIMEOUT);
+
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char rbuf[16];
+  sio_op_t wop, rop;
+  completions = 0;
+  for (int i = 0; i < 4; i++) {
+    sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+    sio_op_init(&wop, SIO_OP_WRITE, &a, "spin", 4, NULL);
+    sio_context_submit(ctx, &rop);
+    sio_context_submit(ctx, &wop);
+    wait_for(ctx, (i + 1) * 2);
+    assert(rop.status == SIO_OP_COMPLETE && memcmp(rbuf, "spin", 4) == 0);
+  }
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test operation deadlines
+*/
+static void test_deadline(sio_context_backend_t backend) {
+  printf("  Testing deadlines...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char rbuf[16], lbuf[16];
+  sio_op_t rop, lop, wop;
+
+  /* Nothing to read: the wait wakes for the deadline instead of its own timeout */
+  completions = 0;
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  rop.timeout_ms = 20;
+  sio_context_submit(ctx, &rop);
+  while (completions < 1) {
+    sio_wait_result_t res = sio_context_wait(ctx, 5000, 0);
+    assert(res == SIO_WAIT_COMPLETED || res == SIO_WAIT_INTERRUPTED);
+    (void)res;
+  }
+  assert(completions == 1);
+  assert(rop.status == SIO_OP_TIMEOUT && rop.error == SIO_ERROR_TIMEOUT);
+
+  /* A deadline that is not reached leaves the result alone */
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  rop.timeout_ms = 5000;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, "late", 4, NULL);
+  sio_context_submit(ctx, &rop);
+  sio_context_submit(ctx, &wop);
+  wait_for(ctx, 3);
+  assert(rop.status == SIO_OP_COMPLETE && rop.result == 4);
+
+  /* An expired chain head cancels the rest of the chain */
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  rop.timeout_ms = 10;
+  rop.flags |= SIO_OP_FLAG_LINK;
+  sio_op_init(&lop, SIO_OP_READ, &b, lbuf, sizeof(lbuf), NULL);
+  sio_op_t *chain[] = { &rop, &lop };
+  sio_error_t err = sio_context_submit_batch(ctx, chain, 2);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to submit chain");
+  }
+  wait_for(ctx, 5);
+  assert(rop.status == SIO_OP_TIMEOUT);
+  assert(lop.status == SIO_OP_CANCELLED);
+  assert(!sio_context_has_pending(ctx));
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+/**
+* @brief Test collecting completions into an array instead of the callback
+*/
+static void test_reap(sio_context_backend_t backend) {
+  printf("  Testing reap/peek...\n");
+
+  sio_context_t *ctx = create_context(backend);
+  sio_stream_t a, b;
+  make_socket_pair(&a, &b);
+
+  char rbuf[16];
+  sio_op_t wop, rop, cop;
+  sio_op_t *done[4];
+  uint32_t total = 0;
+
+  completions = 0;
+  sio_op_init(&wop, SIO_OP_WRITE, &a, "reap", 4, NULL);
+  sio_op_init(&rop, SIO_OP_READ, &b, rbuf, sizeof(rbuf), NULL);
+  sio_context_submit(ctx, &wop);
+  sio_context_submit(ctx, &rop);
+
+  for (int i = 0; i < 100 && total < 2; i++) {
+    uint32_t reaped;
+    sio_wait_result_t res = sio_context_reap(ctx, done + total, 4 - total, &reaped, 100);
+    assert(res != SIO_WAIT_ERROR);
+    (void)res;
+    total += reaped;
+  }
+  assert(total == 2 && completions == 0);
+  assert((done[0] == &wop && done[1] == &rop) || (done[0] == &rop && done[1] == &wop));
+  assert(rop.status == SIO_OP_COMPLETE && memcmp(rbuf, "reap", 4) == 0);
+
+  /* Peeking never blocks: nothing is there, then a finished operation is */
+  assert(sio_context_peek(ctx, done, 4) == 0);
+  sio_op_init(&cop, SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+  sio_context_submit(ctx, &cop);
+  assert(sio_context_peek(ctx, done, 4) == 1 && done[0] == &cop);
+
+  /* A write completes without a wait on every backend once the kernel has it */
+  sio_op_init(&wop, SIO_OP_WRITE, &a, "peek", 4, NULL);
+  sio_context_submit(ctx, &wop);
+  total = 0;
+  for (int i = 0; i < 1000 && total == 0; i++) {
+    total = sio_context_peek(ctx, done, 4);
+    if (total == 0) {
+      usleep(1000);
+    }
+  }
+  assert(total == 1 && done[0] == &wop && wop.status == SIO_OP_COMPLETE);
+  assert(completions == 0);
+
+  sio_context_unregister(ctx, &a);
+  sio_context_unregister(ctx, &b);
+  sio_stream_close(&a);
+  sio_stream_close(&b);
+  sio_context_destroy(ctx);
+}
+
+#define POST_THREADS 4
+#define POST_PER_THREAD 250
+
+static sio_context_t *post_ctx = NULL;
+static sio_op_t post_ops[POST_THREADS][POST_PER_THREAD];
+
+/**
+* @brief Worker posting finished results into the loop of another thread
+*/
+static void *post_worker(void *arg) {
+  sio_op_t *ops = (sio_op_t*)arg;
+
+  for (int i = 0; i < POST_PER_THREAD; i++) {
+    sio_op_init(&ops[i], SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+    ops[i].result = (size_t)i;
+    sio_error_t err = sio_context_post(post_ctx, &ops[i]);
+    assert(err == SIO_SUCCESS);
+    (void)err;
+  }
+  return NULL;
+}
+
+/**
+* @brief Test cross-thread posting and wakeups
+*/
+static void test_post(sio_context_backend_t backend) {
+  printf("  Testing cross-thread post...\n");
+
+  /* Only thread safe contexts accept posts */
+  sio_context_t *ctx = create_context(backend);
+  sio_op_t op;
+  sio_op_init(&op, SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+  assert(sio_context_post(ctx, &op) == SIO_ERROR_UNSUPPORTED);
+  assert(sio_context_wakeup(ctx) == SIO_ERROR_UNSUPPORTED);
+  sio_context_destroy(ctx);
+
+  sio_context_config_t config;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.flags = SIO_CTX_THREAD_SAFE;
+  config.completion_fn = on_complete;
+
+  sio_error_t err = sio_context_create(&post_ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create thread safe context");
+  }
+
+  /* A bare wakeup ends the wait early */
+  assert(sio_context_wakeup(post_ctx) == SIO_SUCCESS);
+  assert(sio_context_wait(post_ctx, 5000, 0) == SIO_WAIT_INTERRUPTED);
+
+  completions = 0;
+  sio_thread_t threads[POST_THREADS];
+  for (int t = 0; t < POST_THREADS; t++) {
+    err = sio_thread_create(&threads[t], post_worker, post_ops[t], SIO_THREAD_DEFAULT);
+    if (err != SIO_SUCCESS) {
+      report_error_and_exit(err, "Failed to create thread");
+    }
+  }
+
+  for (int i = 0; i < 1000 && completions < POST_THREADS * POST_PER_THREAD; i++) {
+    sio_wait_result_t res = sio_context_wait(post_ctx, 1000, 0);
+    assert(res == SIO_WAIT_COMPLETED || res == SIO_WAIT_INTERRUPTED);
+    (void)res;
+  }
+  assert(completions == POST_THREADS * POST_PER_THREAD);
+
+  for (int t = 0; t < POST_THREADS; t++) {
+    sio_thread_join(&threads[t], NULL);
+    for (int i = 0; i < POST_PER_THREAD; i++) {
+      assert(post_ops[t][i].status == SIO_OP_COMPLETE && post_ops[t][i].result == (size_t)i);
+    }
+  }
+  assert(!sio_context_has_pending(post_ctx));
+
+  /* An operation in flight cannot be posted as well */
+  completions = 0;
+  sio_op_init(&op, SIO_OP_TIMER, NULL, NULL, 10000, NULL);
+  assert(sio_context_submit(post_ctx, &op) == SIO_SUCCESS);
+  assert(sio_context_post(post_ctx, &op) == SIO_ERROR_BUSY);
+  assert(sio_context_cancel(post_ctx, &op) == SIO_SUCCESS);
+  wait_for(post_ctx, 1);
+  assert(op.status == SIO_OP_CANCELLED);
+
+  sio_context_destroy(post_ctx);
+  post_ctx = NULL;
+}
+
+static char priority_order[64];
+static int priority_count = 0;
+
+/**
+* @brief Completion callback recording the class of each dispatched operation
+*/
+static void on_priority_complete(sio_op_t *op, void *user_data) {
+  (void)user_data;
+  priority_order[priority_count++] = op->priority > 0 ? 'H' : op->priority == 0 ? 'N' : 'L';
+}
+
+/**
+* @brief Test dispatch order of priority classes and the starvation guard
+*/
+static void test_priority(sio_context_backend_t backend) {
+  printf("  Testing priority dispatch...\n");
+
+  sio_context_config_t config;
+  sio_context_t *ctx = NULL;
+  sio_context_config_init(&config);
+  config.backend = backend;
+  config.completion_fn = on_priority_complete;
+
+  sio_error_t err = sio_context_create(&ctx, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context");
+  }
+
+  /* Custom operations complete on submission, so all of them wait for one dispatch */
+  sio_op_t ops[34];
+  for (int i = 0; i < 34; i++) {
+    sio_op_init(&ops[i], SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+    ops[i].priority = i < 12 ? SIO_OP_PRIORITY_LOW : i < 14 ? SIO_OP_PRIORITY_NORMAL : SIO_OP_PRIORITY_HIGH;
+    sio_context_submit(ctx, &ops[i]);
+  }
+
+  priority_count = 0;
+  while (priority_count < 34) {
+    assert(sio_context_wait(ctx, 100, 64) == SIO_WAIT_COMPLETED);
+  }
+  priority_order[priority_count] = '\0';
+
+  /* High goes first, but a class passed over 8 times in a row is served next */
+  assert(strcmp(priority_order, "HHHHHHHHNLHHHHHHHNLHHHHHLLLLLLLLLL") == 0);
+
+  sio_context_destroy(ctx);
+}
+
+int main(void) {
+  printf("===== SIO Context Test =====\n\n");
+
+  static const sio_context_backend_t backends[] = {
+    SIO_CONTEXT_IO_URING,
+    SIO_CONTEXT_EPOLL,
+    SIO_CONTEXT_POLL,
+    SIO_CONTEXT_SELECT
+  };
+
+  /* Automatic selection always finds one of the fallbacks */
+  sio_context_t *auto_ctx = NULL;
+  sio_error_t err = sio_context_create(&auto_ctx, NULL);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create context with automatic backend");
+  }
+  printf("Automatic backend: %s\n\n", sio_context_backend_name(sio_context_get_backend(auto_ctx)));
+  sio_context_destroy(auto_ctx);
+
+  for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+    if (!sio_context_backend_available(backends[i])) {
+      printf("Skipping %s backend (not available)\n", sio_context_backend_name(backends[i]));
+      continue;
+    }
+
+    printf("Testing %s backend...\n", sio_context_backend_name(backends[i]));
+    test_read_write(backends[i]);
+    test_batch(backends[i]);
+    test_positional(backends[i]);
+    test_sync(backends[i]);
+    test_file_ops(backends[i]);
+    test_fixed_buffers(backends[i]);
+    test_buffer_ring(backends[i]);
+    test_cancel(backends[i]);
+    test_cancel_stream(backends[i]);
+    test_unregister_reorder(backends[i]);
+    test_linked(backends[i]);
+    test_accept_connect(backends[i]);
+    test_accept_multishot(backends[i]);
+    test_zerocopy(backends[i]);
+    test_spin_wait(backends[i]);
+    test_deadline(backends[i]);
+    test_priority(backends[i]);
+    test_reap(backends[i]);
+    test_state_cache(backends[i]);
+    test_stats(backends[i]);
+    test_latency(backends[i]);
+    test_trace(backends[i]);
+    test_timer(backends[i]);
+    test_post(backends[i]);
+
+    if (backends[i] == SIO_CONTEXT_IO_URING) {
+      test_uring_config();
+      test_uring_sqpoll();
+    }
+  }
+
+  printf("\nAll tests passed successfully!\n");
+  return EXIT_SUCCESS;
+}
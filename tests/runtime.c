@@ -0,0 +1,181 @@
+/**
+* @file tests/runtime.c
+* @brief Test program for the sharded runtime
+*
+* Starts shards with SO_REUSEPORT listeners on a loopback port, connects clients
+* and checks every connection is accepted by exactly one shard, then posts work
+* to each shard and checks it runs on that shard.
+*
+* @author zczxy
+* @version 0.1.0
+*/
+
+#include <sio/runtime.h>
+#include <sio/aux/addr.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define TEST_SHARDS 4
+#define TEST_CLIENTS 64
+
+/**
+* @brief Per-shard state, only touched by its own shard thread
+*/
+typedef struct test_shard {
+  sio_op_t accept_op;
+  sio_accept_result_t accepted;
+  int32_t accepts;
+  sio_op_t post_op;
+  int32_t posted_on;
+} test_shard_t;
+
+static test_shard_t shard_state[TEST_SHARDS];
+
+/**
+* @brief Report an error and exit
+*
+* @param error_code The SIO error code
+* @param message Custom error message
+*/
+static void report_error_and_exit(sio_error_t error_code, const char *message) {
+  fprintf(stderr, "Error: %s: %s\n", message, sio_strerr(error_code));
+  exit(EXIT_FAILURE);
+}
+
+/**
+* @brief Completion callback of every shard, user_data is the shard
+*/
+static void on_complete(sio_op_t *op, void *user_data) {
+  sio_runtime_shard_t *shard = (sio_runtime_shard_t*)user_data;
+  test_shard_t *state = (test_shard_t*)shard->user_data;
+
+  if (op == &state->post_op) {
+    SIO_ATOMIC_STORE(&state->posted_on, (int32_t)shard->index);
+    return;
+  }
+
+  if (op->status == SIO_OP_COMPLETE) {
+    sio_stream_close(&state->accepted.stream);
+    SIO_ATOMIC_INC(&state->accepts);
+    sio_context_submit(shard->context, op);
+  }
+}
+
+/**
+* @brief Start callback: keep an accept pending on the shard's listener
+*/
+static sio_error_t on_start(sio_runtime_shard_t *shard) {
+  test_shard_t *state = &shard_state[shard->index];
+  shard->user_data = state;
+
+  assert(shard->has_listener);
+  sio_op_init(&state->accept_op, SIO_OP_ACCEPT, &shard->listener, &state->accepted, sizeof(state->accepted), NULL);
+  return sio_context_submit(shard->context, &state->accept_op);
+}
+
+static int32_t total_accepts(void) {
+  int32_t total = 0;
+  for (int i = 0; i < TEST_SHARDS; i++) {
+    total += SIO_ATOMIC_LOAD(&shard_state[i].accepts);
+  }
+  return total;
+}
+
+/**
+* @brief Test accept distribution and posting across shards
+*/
+static void test_runtime(uint32_t flags) {
+  printf("  Testing runtime (flags %u)...\n", flags);
+
+  memset(shard_state, 0, sizeof(shard_state));
+
+  sio_addr_t addr;
+  sio_addr_loopback(&addr, AF_INET, 0);
+
+  sio_runtime_config_t config;
+  sio_runtime_config_init(&config);
+  config.shards = TEST_SHARDS;
+  config.flags = flags;
+  config.context.completion_fn = on_complete;
+  config.listen_addr = &addr;
+  config.start = on_start;
+
+  sio_runtime_t *runtime = NULL;
+  sio_error_t err = sio_runtime_create(&runtime, &config);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to create runtime");
+  }
+  assert(sio_runtime_shard_count(runtime) == TEST_SHARDS);
+  assert(sio_runtime_get_shard(runtime, TEST_SHARDS) == NULL);
+
+  /* Every shard listens on the port the first one picked */
+  sio_addr_t bound;
+  bound.len = sizeof(bound.addr.ss);
+  getsockname(sio_runtime_get_shard(runtime, 0)->listener.data.socket.fd, &bound.addr.sa, &bound.len);
+  assert(bound.addr.sin.sin_port != 0);
+  for (uint32_t i = 1; i < TEST_SHARDS; i++) {
+    sio_addr_t other;
+    other.len = sizeof(other.addr.ss);
+    getsockname(sio_runtime_get_shard(runtime, i)->listener.data.socket.fd, &other.addr.sa, &other.len);
+    assert(other.addr.sin.sin_port == bound.addr.sin.sin_port);
+  }
+
+  int clients[TEST_CLIENTS];
+  for (int i = 0; i < TEST_CLIENTS; i++) {
+    clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+    int rc = connect(clients[i], &bound.addr.sa, bound.len);
+    assert(rc == 0);
+    (void)rc;
+  }
+
+  for (int spins = 0; total_accepts() < TEST_CLIENTS && spins < 5000; spins++) {
+    sio_thread_sleep(1);
+  }
+  assert(total_accepts() == TEST_CLIENTS);
+
+  for (int i = 0; i < TEST_SHARDS; i++) {
+    printf("    shard %d accepted %d\n", i, SIO_ATOMIC_LOAD(&shard_state[i].accepts));
+  }
+
+  for (int i = 0; i < TEST_CLIENTS; i++) {
+    close(clients[i]);
+  }
+
+  /* Posted work runs on the shard it was posted to */
+  for (uint32_t i = 0; i < TEST_SHARDS; i++) {
+    shard_state[i].posted_on = -1;
+    sio_op_init(&shard_state[i].post_op, SIO_OP_CUSTOM, NULL, NULL, 0, NULL);
+    err = sio_runtime_post(runtime, i, &shard_state[i].post_op);
+    if (err != SIO_SUCCESS) {
+      report_error_and_exit(err, "Failed to post to shard");
+    }
+  }
+  for (uint32_t i = 0; i < TEST_SHARDS; i++) {
+    for (int spins = 0; SIO_ATOMIC_LOAD(&shard_state[i].posted_on) < 0 && spins < 5000; spins++) {
+      sio_thread_sleep(1);
+    }
+    assert(SIO_ATOMIC_LOAD(&shard_state[i].posted_on) == (int32_t)i);
+  }
+
+  err = sio_runtime_destroy(runtime);
+  if (err != SIO_SUCCESS) {
+    report_error_and_exit(err, "Failed to destroy runtime");
+  }
+}
+
+int main(void) {
+  printf("===== SIO Runtime Test =====\n\n");
+
+  test_runtime(SIO_RUNTIME_PIN);
+  test_runtime(SIO_RUNTIME_PIN | SIO_RUNTIME_STEER);
+
+  printf("\nAll tests passed successfully!\n");
+  return EXIT_SUCCESS;
+}